@@ -0,0 +1,1656 @@
+/**
+ * @file meshBenchmarks.cpp
+ * @author Stephen Schlueter, github: stevesch
+ * @brief Timing benchmarks for the mesh library implementation file
+ * @version 0.1
+ * @date 2021-05-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include "meshBenchmarks.h"
+#include "simpleRenderer.h"
+
+#include <stevesch-Mesh.h>
+
+#include <SPIFFS.h>
+
+using namespace stevesch;
+
+namespace
+{
+  // per-sample output is "<label>: <count> in <us> us (<rate>/s)"
+  void printRate(const char *label, uint count, long us)
+  {
+    float rate = (us > 0) ? (1.0e6f * (float)count / (float)us) : 0.0f;
+    Serial.printf("  %-28s %6u in %7ld us (%10.1f/s)\n", label, count, us, rate);
+  }
+
+  // per-sample output is "<label>: <count> in <cycles> cycles (<cycles per item>/item)"
+  void printCycles(const char *label, uint count, uint32_t cycles)
+  {
+    float per = (count > 0) ? ((float)cycles / (float)count) : 0.0f;
+    Serial.printf("  %-28s %6u in %9u cycles (%6.1f/vertex)\n", label, count, cycles, per);
+  }
+
+  // "<label>: <lines>/s, <pixels>/s"
+  void printLineRate(const char *label, uint lines, uint pixels, long us)
+  {
+    float seconds = (us > 0) ? (1.0e-6f * (float)us) : 1.0f;
+    Serial.printf("  %-28s %10.0f lines/s %12.0f px/s\n", label, (float)lines / seconds, (float)pixels / seconds);
+  }
+
+  // random lines within width x height (every eighth one horizontal or vertical); returns pixel count
+  uint makeLines(std::vector<ScreenLine> &lines, uint count, int16_t width, int16_t height)
+  {
+    lines.resize(count);
+    uint pixels = 0;
+    for (uint i = 0; i < count; ++i)
+    {
+      ScreenLine &l = lines[i];
+      l.x0 = (int16_t)S_RandGen.getFloatAB(0.0f, (float)width - 0.5f);
+      l.y0 = (int16_t)S_RandGen.getFloatAB(0.0f, (float)height - 0.5f);
+      l.x1 = (int16_t)S_RandGen.getFloatAB(0.0f, (float)width - 0.5f);
+      l.y1 = (int16_t)S_RandGen.getFloatAB(0.0f, (float)height - 0.5f);
+      if ((i & 7) == 0)
+      {
+        l.y1 = l.y0;
+      }
+      else if ((i & 7) == 4)
+      {
+        l.x1 = l.x0;
+      }
+      l.color = (uint16_t)(i * 0x0841);
+      pixels += std::max(abs(l.x1 - l.x0), abs(l.y1 - l.y0)) + 1;
+    }
+    return pixels;
+  }
+
+  // hashes bands as they arrive, the same way FrameBuffer565::checksum hashes a whole frame
+  class ChecksumBandSink : public BandSink
+  {
+  public:
+    ChecksumBandSink() : mHash(2166136261u) {}
+
+    void pushBand(int16_t /*y*/, int16_t width, int16_t height, const uint16_t *pixels) override
+    {
+      const uint32_t count = (uint32_t)width * height;
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        mHash = (mHash ^ (pixels[i] & 0xff)) * 16777619u;
+        mHash = (mHash ^ (pixels[i] >> 8)) * 16777619u;
+      }
+    }
+
+    uint32_t checksum() const { return mHash; }
+    void reset() { mHash = 2166136261u; }
+
+  protected:
+    uint32_t mHash;
+  };
+
+  // stands in for a display: takes as long as an SPI transfer of the frame would
+  class SimulatedSpiSink : public FrameSink
+  {
+  public:
+    explicit SimulatedSpiSink(uint32_t spiHz) : mSpiHz(spiHz) {}
+
+    void presentFrame(const FrameBuffer565 &frame) override
+    {
+      const uint64_t bits = (uint64_t)frame.width() * frame.height() * 16;
+      delayMicroseconds((uint32_t)((bits * 1000000) / mSpiHz));
+    }
+
+  protected:
+    uint32_t mSpiHz;
+  };
+
+  // takes bands and drops them (for timing what produces them)
+  class NullBandSink : public BandSink
+  {
+  public:
+    void pushBand(int16_t, int16_t, int16_t, const uint16_t *) override {}
+  };
+
+  // random placements: spun about y and scattered around vCenter
+  void makePlacements(std::vector<matrix4> &ltow, uint count, const vector3 &vCenter, float fSpread)
+  {
+    ltow.resize(count);
+    for (uint i = 0; i < count; ++i)
+    {
+      matrix4 &m = ltow[i];
+      m.yMatrix(S_RandGen.getFloatAB(0.0f, c_f2pi));
+      vector3 offset;
+      offset.randSpherical();
+      offset *= S_RandGen.getFloatAB(0.0f, fSpread);
+      m.m03 = vCenter.x + offset.x;
+      m.m13 = vCenter.y + offset.y;
+      m.m23 = vCenter.z + offset.z;
+    }
+  }
+
+  constexpr size_t kHeapMargin = 32 * 1024; // (left free for everything else)
+
+  // true if bytes (and the margin) fit in the heap
+  bool heapFits(size_t bytes)
+  {
+    return ESP.getFreeHeap() >= (bytes + kHeapMargin);
+  }
+
+  // true if frameCount width x height RGB565 frames (plus extraBytes) fit; otherwise says so
+  bool framesFit(const char *benchmark, uint frameCount, int16_t width, int16_t height, size_t extraBytes = 0)
+  {
+    const size_t frameBytes = (size_t)width * height * sizeof(uint16_t);
+    if (heapFits(frameCount * frameBytes + extraBytes))
+    {
+      return true;
+    }
+    Serial.printf("%s: not enough memory for %u %dx%d frame%s (%u bytes)\n", benchmark, frameCount, width, height,
+                  (frameCount == 1) ? "" : "s", (uint)(frameCount * frameBytes + extraBytes));
+    return false;
+  }
+
+  // what the drawing benchmarks draw: count placements (as makePlacements) and a color for each
+  struct BenchScene
+  {
+    BenchScene(uint count, const vector3 &vCenter, float fSpread) : colors(count)
+    {
+      makePlacements(ltow, count, vCenter, fSpread);
+      for (uint i = 0; i < count; ++i)
+      {
+        colors[i] = (uint16_t)(0x8410 | (i * 0x0841));
+      }
+    }
+
+    std::vector<matrix4> ltow;
+    std::vector<uint16_t> colors;
+  };
+
+  // puts the renderer's frameStats back as they were when it goes out of scope
+  class FrameStatsSaver
+  {
+  public:
+    FrameStatsSaver() : mSaved(frameStats) {}
+    ~FrameStatsSaver() { frameStats = mSaved; }
+
+  protected:
+    FrameStats mSaved;
+  };
+
+  // The unoptimized reference for benchmarkHeadless, sharing none of the instanced path: each
+  // face on its own, back faces rejected by the view-space normal, every vertex through the full
+  // 4x4 local-to-screen transform and a divide, and every edge drawn with its own drawLine.
+  // Faces reaching behind the camera are skipped rather than clipped.
+  void drawReferenceMesh(RenderTarget &target, const FaceMesh &mesh, const matrix4 &mtxLtoW, uint16_t color)
+  {
+    matrix4 mtxWtoV, mtxVtoS, mtxLtoV, mtxLtoS;
+    getViewTransforms(mtxWtoV, mtxVtoS);
+    matrix4::mul(mtxLtoV, mtxWtoV, mtxLtoW);
+    matrix4::mul(mtxLtoS, mtxVtoS, mtxLtoV);
+
+    constexpr float kMinW = 1.0e-3f;
+    const indexBuffer_t &indices = mesh.getPositionIndices();
+    std::vector<vector3> screen;
+    for (uint iface = 0; iface < mesh.faceCount(); ++iface)
+    {
+      const IndexedFace &face = mesh.getFace(iface);
+#if USE_FACE_NORMALS
+      vector4 normal(mesh.getNormal(face.iNormal));
+      vector4 v0(mesh.getPosition(indices[face.iFirst]));
+      v0.w = 1.0f;
+      v0.transform(mtxLtoV);
+      vector4::transformSub(normal, mtxLtoV, normal);
+      if (normal.dot3(v0) >= 0.0f)
+      {
+        continue;
+      }
+#endif
+      screen.resize(face.iCount);
+      bool bInFront = true;
+      for (uint j = 0; (j < face.iCount) && bInFront; ++j)
+      {
+        vector4 v(mesh.getPosition(indices[face.iFirst + j]));
+        v.w = 1.0f;
+        v.transform(mtxLtoS);
+        bInFront = (v.w > kMinW);
+        const float invw = stevesch::recipf(v.w);
+        screen[j].set(v.x * invw, v.y * invw, v.z * invw);
+      }
+      if (!bInFront || (face.iCount < 3))
+      {
+        continue;
+      }
+#if !USE_FACE_NORMALS
+      const float cw = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                       (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+      if (cw <= 0.0f)
+      {
+        continue;
+      }
+#endif
+      for (uint j = 0, k = face.iCount - 1; j < face.iCount; k = j++)
+      {
+        target.drawLine((int16_t)screen[k].x, (int16_t)screen[k].y, (int16_t)screen[j].x, (int16_t)screen[j].y,
+                        color);
+      }
+    }
+  }
+
+  // random rays that start outside the model and aim at points near its center
+  void makeRays(std::vector<vector3> &origins, std::vector<vector3> &dirs, uint count, float radius)
+  {
+    origins.resize(count);
+    dirs.resize(count);
+    for (uint i = 0; i < count; ++i)
+    {
+      vector3 &o = origins[i];
+      o.randSpherical();
+      o *= 2.0f * radius;
+
+      vector3 target;
+      target.randSpherical();
+      target *= 0.5f * radius;
+
+      vector3::sub(dirs[i], target, o);
+    }
+  }
+}
+
+void benchmarkModel(const char *name, const FaceMesh &mesh)
+{
+  Serial.printf("Benchmarks for <%s> (%u verts, %u faces)\n", name, mesh.positionCount(), mesh.faceCount());
+  benchmarkBVH(mesh);
+  benchmarkCulling(mesh);
+  benchmarkTransform(mesh);
+  benchmarkVertexKernel(mesh);
+  benchmarkFixedPoint(mesh);
+}
+
+void benchmarkBVH(const FaceMesh &mesh)
+{
+  const uint fc = mesh.faceCount();
+  if (fc == 0)
+  {
+    return;
+  }
+
+  vector3 vmin, vmax, vdif;
+  mesh.computeExtents(vmin, vmax);
+  vector3::sub(vdif, vmax, vmin);
+  const float radius = 0.5f * vdif.abs();
+
+  Serial.printf("BVH (%u faces):\n", fc);
+
+  FaceMeshBVH bvh;
+  long t0 = micros();
+  bvh.build(mesh);
+  long tBuild = micros() - t0;
+  Serial.printf("  build: %ld us, %u nodes, %u bytes (%5.1f bytes/face)\n",
+                tBuild, bvh.nodeCount(), (uint)bvh.memoryBytes(), (float)bvh.memoryBytes() / (float)fc);
+
+  constexpr uint kRayCount = 256;
+  std::vector<vector3> origins, dirs;
+  makeRays(origins, dirs, kRayCount, radius);
+
+  FaceMeshHit hit;
+  uint hits = 0;
+  t0 = micros();
+  for (uint i = 0; i < kRayCount; ++i)
+  {
+    hits += bvh.raycast(hit, origins[i], dirs[i]) ? 1 : 0;
+  }
+  long tBvh = micros() - t0;
+
+  // brute force for comparison (and as a correctness check on the hit count)
+  uint bruteHits = 0;
+  t0 = micros();
+  for (uint i = 0; i < kRayCount; ++i)
+  {
+    float tBest = 3.0e38f;
+    bool bHit = false;
+    for (uint iface = 0; iface < fc; ++iface)
+    {
+      if (FaceMeshBVH::intersectFace(hit, mesh, iface, origins[i], dirs[i], tBest))
+      {
+        tBest = hit.distance;
+        bHit = true;
+      }
+    }
+    bruteHits += bHit ? 1 : 0;
+  }
+  long tBrute = micros() - t0;
+
+  printRate("raycast (bvh)", kRayCount, tBvh);
+  printRate("raycast (brute force)", kRayCount, tBrute);
+  Serial.printf("  hits: bvh=%u brute=%u\n", hits, bruteHits);
+
+  t0 = micros();
+  for (uint i = 0; i < kRayCount; ++i)
+  {
+    bvh.nearest(hit, origins[i]);
+  }
+  printRate("nearest point (bvh)", kRayCount, micros() - t0);
+  yield();
+}
+
+void benchmarkCulling(const FaceMesh &mesh)
+{
+#if USE_FACE_NORMALS
+  const uint fc = mesh.faceCount();
+  const uint nc = mesh.normalCount();
+  if ((fc == 0) || (nc == 0))
+  {
+    return;
+  }
+
+  // local-to-view matrices for a number of viewpoints in front of the model
+  constexpr uint kViews = 64;
+  std::vector<matrix4> ltov;
+  makePlacements(ltov, kViews, vector3(0.0f, 0.0f, -4.0f), 1.0f);
+
+  const positionBuffer_t &positions = mesh.positions();
+  const indexBuffer_t &posIndices = mesh.getPositionIndices();
+  const faceBuffer_t &faces = mesh.faces();
+  const uint tests = kViews * fc;
+
+  Serial.printf("Backface culling (%u faces, %u unique normals):\n", fc, nc);
+
+  // view space: transform normal and vertex 0 of every face
+  uint frontView = 0;
+  long t0 = micros();
+  for (const matrix4 &m : ltov)
+  {
+    for (const IndexedFace &face : faces)
+    {
+      vector4 v0, n;
+      v0.set(positions[posIndices[face.iFirst]]);
+      v0.transform(m);
+      n.set(mesh.getNormal(face.iNormal));
+      vector4::transformSub(n, m, n);
+      frontView += (n.dot3(v0) < 0.0f) ? 1 : 0;
+    }
+  }
+  printRate("view space, per face", tests, micros() - t0);
+
+  // object space: eye into local space once, then one dot product per face
+  uint frontFace = 0;
+  t0 = micros();
+  for (const matrix4 &m : ltov)
+  {
+    matrix4 mtxVtoL;
+    matrix4::invert(mtxVtoL, m);
+    vector3 eye;
+    mtxVtoL.getTranslation(eye);
+    for (const IndexedFace &face : faces)
+    {
+      frontFace += mesh.facesEye(face, eye) ? 1 : 0;
+    }
+  }
+  printRate("object space, per face", tests, micros() - t0);
+
+  // object space: one dot product per unique normal, one compare per face
+  std::vector<float> dots(nc);
+  uint frontNormal = 0;
+  t0 = micros();
+  for (const matrix4 &m : ltov)
+  {
+    matrix4 mtxVtoL;
+    matrix4::invert(mtxVtoL, m);
+    vector3 eye;
+    mtxVtoL.getTranslation(eye);
+    mesh.computeNormalDots(&dots[0], eye);
+    for (const IndexedFace &face : faces)
+    {
+      frontNormal += FaceMesh::facesEye(face, &dots[0]) ? 1 : 0;
+    }
+  }
+  printRate("object space, per normal", tests, micros() - t0);
+
+  Serial.printf("  front faces: view=%u face=%u normal=%u\n", frontView, frontFace, frontNormal);
+  yield();
+#endif
+}
+
+void benchmarkTransform(const FaceMesh &mesh)
+{
+  const uint vc = mesh.positionCount();
+  if (vc == 0)
+  {
+    return;
+  }
+
+  // a typical screen and projection, with the model in front of the camera
+  constexpr float kWidth = 240.0f;
+  constexpr float kHeight = 135.0f;
+  matrix4 mtxVtoC;
+  mtxVtoC.perspectiveRH(degToRad(90.0f), degToRad(60.0f), 0.1f, 8.0f);
+  matrix4 mtxNDCtoS;
+  viewportMatrix(mtxNDCtoS, kWidth, kHeight);
+  matrix4 mtxVtoS;
+  foldViewport(mtxVtoS, mtxVtoC, kWidth, kHeight);
+
+  std::vector<matrix4> ltov;
+  makePlacements(ltov, 1, vector3(0.0f, 0.0f, -4.0f), 0.5f);
+  matrix4 mtxLtoC, mtxLtoS;
+  matrix4::mul(mtxLtoC, mtxVtoC, ltov[0]);
+  matrix4::mul(mtxLtoS, mtxVtoS, ltov[0]);
+  const affine4x3 affLtoV(ltov[0]);
+
+  const positionBuffer_t &positions = mesh.positions();
+  positionBuffer_t screen(vc);
+  std::vector<vector4> homogeneous(vc);
+
+  Serial.printf("Vertex transform (%u verts):\n", vc);
+
+  // separate viewport: 4x4 to clip space, divide, then a second 4x4 to the screen
+  uint32_t c0 = ESP.getCycleCount();
+  for (uint i = 0; i < vc; ++i)
+  {
+    vector4 v;
+    v.set(positions[i]);
+    vector4::transform(v, mtxLtoC, v);
+    const float invw = stevesch::recipf(v.w);
+    v.x *= invw;
+    v.y *= invw;
+    v.z *= invw;
+    v.w = 1.0f;
+    vector4::transform(v, mtxNDCtoS, v);
+    screen[i].set(v.x, v.y, v.z);
+  }
+  printCycles("clip, divide, viewport", vc, ESP.getCycleCount() - c0);
+  const vector3 check = screen[vc - 1];
+
+  // viewport folded into the projection
+  c0 = ESP.getCycleCount();
+  projectPoints(&screen[0], &positions[0], vc, mtxLtoS);
+  printCycles("folded (projectPoints)", vc, ESP.getCycleCount() - c0);
+
+  // homogeneous output (kept for clipping), then the divide
+  c0 = ESP.getCycleCount();
+  transformPoints(&homogeneous[0], &positions[0], vc, mtxLtoS);
+  perspectiveDivide(&screen[0], &homogeneous[0], vc);
+  printCycles("folded, kept for clipping", vc, ESP.getCycleCount() - c0);
+
+  // model-view only: full 4x4 vs affine 4x3
+  c0 = ESP.getCycleCount();
+  transformPoints(&homogeneous[0], &positions[0], vc, ltov[0]);
+  printCycles("model-view, 4x4", vc, ESP.getCycleCount() - c0);
+
+  c0 = ESP.getCycleCount();
+  transformPoints(&screen[0], &positions[0], vc, affLtoV);
+  printCycles("model-view, affine 4x3", vc, ESP.getCycleCount() - c0);
+
+  // (the folded path should land on the same pixels)
+  projectPoints(&screen[0], &positions[vc - 1], 1, mtxLtoS);
+  Serial.printf("  last vertex: <%6.2f, %6.2f> vs <%6.2f, %6.2f>\n", check.x, check.y, screen[0].x, screen[0].y);
+  yield();
+}
+
+void benchmarkVertexKernel(const FaceMesh &mesh)
+{
+  const uint vc = mesh.positionCount();
+  if (vc == 0)
+  {
+    return;
+  }
+
+  matrix4 mtxVtoC;
+  mtxVtoC.perspectiveRH(degToRad(90.0f), degToRad(60.0f), 0.1f, 8.0f);
+  matrix4 mtxVtoS;
+  foldViewport(mtxVtoS, mtxVtoC, 240.0f, 135.0f);
+  std::vector<matrix4> ltov;
+  makePlacements(ltov, 1, vector3(0.0f, 0.0f, -4.0f), 0.5f);
+  matrix4 mtxLtoS;
+  matrix4::mul(mtxLtoS, mtxVtoS, ltov[0]);
+  ClipRegion region;
+  region.set(0.0f, 239.0f, 0.0f, 134.0f);
+
+  const positionBuffer_t &positions = mesh.positions();
+  positionBuffer_t screen(vc);
+  std::vector<vector4> homogeneous(vc);
+  std::vector<uint8_t> outcodes(vc);
+  std::vector<vector4> points(vc);
+  for (uint i = 0; i < vc; ++i)
+  {
+    points[i].set(positions[i].x, positions[i].y, positions[i].z, 1.0f);
+  }
+
+  // repeat small meshes so each sample is long enough to time
+  constexpr uint kMinVertices = 16384;
+  const uint reps = std::max(1u, kMinVertices / vc);
+  const uint total = reps * vc;
+
+  Serial.printf("Vertex kernel <%s> (%u verts x %u):\n", vertexKernelName(), vc, reps);
+
+  long t0 = micros();
+  for (uint r = 0; r < reps; ++r)
+  {
+    transformVertices(&homogeneous[0], &points[0], vc, mtxLtoS);
+  }
+  printRate("transform", total, micros() - t0);
+
+  t0 = micros();
+  for (uint r = 0; r < reps; ++r)
+  {
+    transformVerticesScalar(&homogeneous[0], &points[0], vc, mtxLtoS);
+  }
+  printRate("transform (scalar)", total, micros() - t0);
+
+  ClipCodes codes = {0, 0};
+  t0 = micros();
+  for (uint r = 0; r < reps; ++r)
+  {
+    codes = projectVertices(&screen[0], &homogeneous[0], &outcodes[0], &positions[0], vc, mtxLtoS, region);
+  }
+  printRate("project + outcodes", total, micros() - t0);
+
+  t0 = micros();
+  for (uint r = 0; r < reps; ++r)
+  {
+    codes = projectVerticesScalar(&screen[0], &homogeneous[0], &outcodes[0], &positions[0], vc, mtxLtoS, region);
+  }
+  printRate("project + outcodes (scalar)", total, micros() - t0);
+
+  Serial.printf("  outcodes: any=0x%02x all=0x%02x\n", codes.any, codes.all);
+  yield();
+}
+
+void benchmarkFixedPoint(const FaceMesh &mesh)
+{
+  const uint vc = mesh.positionCount();
+  if (vc == 0)
+  {
+    return;
+  }
+
+  constexpr float kWidth = 240.0f;
+  constexpr float kHeight = 135.0f;
+  matrix4 mtxVtoC;
+  mtxVtoC.perspectiveRH(degToRad(90.0f), degToRad(60.0f), 0.1f, 8.0f);
+  matrix4 mtxVtoS;
+  foldViewport(mtxVtoS, mtxVtoC, kWidth, kHeight);
+  std::vector<matrix4> ltov;
+  makePlacements(ltov, 1, vector3(0.0f, 0.0f, -4.0f), 0.5f);
+  matrix4 mtxLtoS;
+  matrix4::mul(mtxLtoS, mtxVtoS, ltov[0]);
+  const fixedMatrix4 mtxFixed(mtxLtoS);
+
+  const positionBuffer_t &positions = mesh.positions();
+  positionBuffer_t screen(vc);
+  std::vector<fixedVector3> positionsFixed(vc);
+  std::vector<fixedPoint2> screenFixed(vc);
+
+  Serial.printf("Fixed-point projection (%u verts):\n", vc);
+
+  uint32_t c0 = ESP.getCycleCount();
+  projectPoints(&screen[0], &positions[0], vc, mtxLtoS);
+  printCycles("float", vc, ESP.getCycleCount() - c0);
+
+  c0 = ESP.getCycleCount();
+  toFixed(&positionsFixed[0], &positions[0], vc);
+  printCycles("to 16.16 (once per mesh)", vc, ESP.getCycleCount() - c0);
+
+  c0 = ESP.getCycleCount();
+  projectPointsFixed(&screenFixed[0], &positionsFixed[0], vc, mtxFixed);
+  printCycles("fixed 16.16", vc, ESP.getCycleCount() - c0);
+
+  // error against the float path, over the vertices that land on screen
+  float maxError = 0.0f;
+  uint onScreen = 0;
+  uint pixelMismatches = 0;
+  for (uint i = 0; i < vc; ++i)
+  {
+    const vector3 &s = screen[i];
+    if ((s.x < 0.0f) || (s.x >= kWidth) || (s.y < 0.0f) || (s.y >= kHeight))
+    {
+      continue;
+    }
+    ++onScreen;
+    const float ex = fabsf((float)screenFixed[i].x * (1.0f / kSubpixelOne) - s.x);
+    const float ey = fabsf((float)screenFixed[i].y * (1.0f / kSubpixelOne) - s.y);
+    maxError = stevesch::maxf(maxError, stevesch::maxf(ex, ey));
+    if ((subpixelToPixel(screenFixed[i].x) != (int16_t)s.x) || (subpixelToPixel(screenFixed[i].y) != (int16_t)s.y))
+    {
+      ++pixelMismatches;
+    }
+  }
+  Serial.printf("  on screen: %u, max error %5.3f px, %u differ by a pixel\n", onScreen, maxError, pixelMismatches);
+  yield();
+}
+
+void benchmarkInstancing(RenderTarget *renderTarget, const FaceMesh &mesh, const vector3 &vCenter)
+{
+  const uint fc = mesh.faceCount();
+  if (fc == 0)
+  {
+    return;
+  }
+
+  constexpr uint kMaxInstances = 4096;
+  constexpr uint kMaxFaceDraws = 1u << 20; // stop the sweep before it takes too long
+
+  // placements only for the counts the sweep reaches, and that fit in memory
+  uint maxCount = 1;
+  while (((maxCount * 4) <= kMaxInstances) && ((maxCount * 4 * fc) <= kMaxFaceDraws))
+  {
+    maxCount *= 4;
+  }
+  constexpr size_t kInstanceBytes = sizeof(matrix4) + sizeof(uint16_t);
+  while ((maxCount > 1) && !heapFits(maxCount * kInstanceBytes))
+  {
+    maxCount /= 4;
+  }
+
+  BenchScene scene(maxCount, vCenter, 1.5f);
+
+  Serial.printf("Instanced draw (%u faces), per-instance cost:\n", fc);
+  Serial.printf("  %6s %12s %12s\n", "count", "single (us)", "batched (us)");
+  for (uint count = 1; count <= maxCount; count *= 4)
+  {
+    long t0 = micros();
+    for (uint i = 0; i < count; ++i)
+    {
+      drawFaceMesh(renderTarget, mesh, scene.ltow[i], scene.colors[i]);
+    }
+    long tSingle = micros() - t0;
+    yield();
+
+    t0 = micros();
+    drawFaceMeshInstanced(renderTarget, mesh, &scene.ltow[0], count, &scene.colors[0]);
+    long tBatched = micros() - t0;
+    yield();
+
+    Serial.printf("  %6u %12.2f %12.2f\n", count, (float)tSingle / (float)count, (float)tBatched / (float)count);
+  }
+}
+
+void benchmarkStaticBatch(RenderTarget *renderTarget, const FaceMesh &mesh, const vector3 &vCenter)
+{
+  const uint fc = mesh.faceCount();
+  if (fc == 0)
+  {
+    return;
+  }
+
+  // as many copies as fit in the batch's 16-bit indices (up to 64)
+  constexpr uint kMaxParts = 64;
+  const uint perPart = std::max(mesh.positionCount(), (uint)mesh.getPositionIndices().size());
+  const uint partCount = std::min(kMaxParts, 0xffffu / std::max(perPart, 1u));
+  if (partCount < 2)
+  {
+    Serial.printf("Static batch: model too large to batch\n");
+    return;
+  }
+
+  std::vector<matrix4> ltow;
+  makePlacements(ltow, partCount, vCenter, 2.5f);
+
+  FaceMeshBatch batch;
+  long t0 = micros();
+  for (uint i = 0; i < partCount; ++i)
+  {
+    batch.add(mesh, ltow[i]);
+  }
+  batch.compactMemory();
+  long tBuild = micros() - t0;
+
+  MeshMemoryReport report;
+  batch.mesh().memoryReport(report);
+  Serial.printf("Static batch (%u parts, %u faces): build %ld us, %u bytes\n",
+                partCount, batch.mesh().faceCount(), tBuild, (uint)report.bytesReserved);
+
+  constexpr uint16_t kColor = 0xffff;
+  t0 = micros();
+  for (uint i = 0; i < partCount; ++i)
+  {
+    drawFaceMesh(renderTarget, mesh, ltow[i], kColor);
+  }
+  long tSeparate = micros() - t0;
+  yield();
+
+  t0 = micros();
+  drawFaceMeshBatch(renderTarget, batch, kColor);
+  long tBatch = micros() - t0;
+  yield();
+
+  // hide every other part
+  for (uint i = 0; i < partCount; i += 2)
+  {
+    batch.setPartVisible(i, false);
+  }
+  t0 = micros();
+  drawFaceMeshBatch(renderTarget, batch, kColor);
+  long tHalf = micros() - t0;
+  yield();
+
+  Serial.printf("  separate draws: %7ld us\n", tSeparate);
+  Serial.printf("  batched draw:   %7ld us\n", tBatch);
+  Serial.printf("  half hidden:    %7ld us\n", tHalf);
+}
+
+void benchmarkLineRaster(RenderTarget *displayTarget)
+{
+  constexpr uint kLines = 2048;
+  std::vector<ScreenLine> lines;
+
+  Serial.printf("Line drawing (%u lines):\n", kLines);
+
+  // display's drawLine path, at the display's resolution
+  if (displayTarget)
+  {
+    const uint pixels = makeLines(lines, kLines, displayTarget->width(), displayTarget->height());
+    long t0 = micros();
+    for (const ScreenLine &l : lines)
+    {
+      displayTarget->drawLine(l.x0, l.y0, l.x1, l.y1, l.color);
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "drawLine %dx%d", displayTarget->width(), displayTarget->height());
+    printLineRate(label, kLines, pixels, micros() - t0);
+    yield();
+  }
+
+  // direct rasterizer at each of the boardSetups resolutions
+  static const int16_t kResolutions[][2] = {{80, 160}, {128, 160}, {135, 240}, {240, 320}};
+  for (const auto &res : kResolutions)
+  {
+    const int16_t width = res[0];
+    const int16_t height = res[1];
+    const size_t frameBytes = (size_t)width * height * sizeof(uint16_t);
+    if (!heapFits(frameBytes))
+    {
+      Serial.printf("  %dx%d: not enough memory for a frame\n", width, height);
+      continue;
+    }
+
+    const uint pixels = makeLines(lines, kLines, width, height);
+    FrameBuffer565 frame(width, height);
+    const PixelBuffer16 buffer = frame.buffer();
+    char label[32];
+
+    long t0 = micros();
+    for (const ScreenLine &l : lines)
+    {
+      rasterLine(buffer, l.x0, l.y0, l.x1, l.y1, l.color);
+    }
+    snprintf(label, sizeof(label), "rasterLine %dx%d", width, height);
+    printLineRate(label, kLines, pixels, micros() - t0);
+
+    t0 = micros();
+    rasterLines(buffer, &lines[0], kLines);
+    snprintf(label, sizeof(label), "rasterLines %dx%d", width, height);
+    printLineRate(label, kLines, pixels, micros() - t0);
+    yield();
+  }
+}
+
+void benchmarkHeadless(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  // (kept near the center, so few edges need clipping, which the reference doesn't do; one
+  // color, so the comparison doesn't depend on the order overlapping instances are drawn in)
+  constexpr uint kInstances = 16;
+  BenchScene scene(kInstances, vCenter, 0.5f);
+  scene.colors.assign(kInstances, 0xffff);
+
+  // keep both frames for an exact comparison if there's room; otherwise compare checksums
+  const size_t frameBytes = (size_t)width * height * sizeof(uint16_t);
+  const bool bBothFrames = heapFits(2 * frameBytes);
+  if (!bBothFrames && !framesFit("Headless draw", 1, width, height))
+  {
+    return;
+  }
+
+  Serial.printf("Headless draw (%u faces x %u instances, %dx%d):\n", fc, kInstances, width, height);
+
+  FrameBuffer565 reference(width, height);
+  long t0 = micros();
+  reference.clear(0);
+  for (uint i = 0; i < kInstances; ++i)
+  {
+    drawReferenceMesh(reference, mesh, scene.ltow[i], scene.colors[i]);
+  }
+  reference.present();
+  printRate("reference", kInstances, micros() - t0);
+  const uint32_t referenceSum = reference.checksum();
+  yield();
+
+  if (bBothFrames)
+  {
+    FrameBuffer565 optimized(width, height);
+    t0 = micros();
+    optimized.clear(0);
+    drawFaceMeshInstanced(&optimized, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+    optimized.present();
+    printRate("instanced", kInstances, micros() - t0);
+    Serial.printf("  pixels differing: %u\n", optimized.diffCount(reference));
+  }
+  else
+  {
+    t0 = micros();
+    reference.clear(0);
+    drawFaceMeshInstanced(&reference, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+    reference.present();
+    printRate("instanced", kInstances, micros() - t0);
+    Serial.printf("  frames %s (checksums %08x %08x)\n", (reference.checksum() == referenceSum) ? "match" : "differ",
+                  referenceSum, reference.checksum());
+  }
+  yield();
+}
+
+void benchmarkFlatFill(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+#if USE_FACE_NORMALS
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  if (!framesFit("Flat fill", 1, width, height))
+  {
+    return;
+  }
+
+  constexpr uint kInstances = 4;
+  constexpr uint kFrames = 4;
+  BenchScene scene(kInstances, vCenter, 1.5f);
+
+  Serial.printf("Flat fill (%u faces x %u instances x %u frames, %dx%d):\n", fc, kInstances, kFrames, width, height);
+
+  FrameBuffer565 frame(width, height);
+  const RenderMode previousMode = getRenderMode();
+  const FrameStatsSaver savedStats;
+
+  // flat first: its count of front faces is also the wireframe's
+  setRenderMode(kRenderFlat);
+  frameStats = FrameStats();
+  long t0 = micros();
+  for (uint f = 0; f < kFrames; ++f)
+  {
+    frame.clear(0);
+    drawFaceMeshInstanced(&frame, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+  }
+  const long tFlat = micros() - t0;
+  const uint faces = frameStats.facesFilled;
+  const uint pixels = frameStats.pixelsFilled;
+  yield();
+
+  setRenderMode(kRenderWireframe);
+  t0 = micros();
+  for (uint f = 0; f < kFrames; ++f)
+  {
+    frame.clear(0);
+    drawFaceMeshInstanced(&frame, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+  }
+  const long tWire = micros() - t0;
+
+  printRate("faces, flat", faces, tFlat);
+  printRate("faces, wireframe", faces, tWire);
+  Serial.printf("  pixels filled per frame: %u\n", pixels / kFrames);
+
+  setRenderMode(previousMode);
+  yield();
+#endif
+}
+
+void benchmarkTileRaster(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+#if USE_FACE_NORMALS
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  const size_t frameBytes = (size_t)width * height * sizeof(uint16_t);
+  if (!framesFit("Tile raster", 1, width, height))
+  {
+    return;
+  }
+
+  // closely packed, so instances overlap and depth testing matters
+  constexpr uint kInstances = 6;
+  constexpr uint kFrames = 4;
+  BenchScene scene(kInstances, vCenter, 0.5f);
+
+  Serial.printf("Tile raster (%u faces x %u instances x %u frames, %dx%d):\n", fc, kInstances, kFrames, width, height);
+
+  FrameBuffer565 frame(width, height);
+  const RenderMode previousMode = getRenderMode();
+  const uint previousTileSize = getDepthTileSize();
+  const FrameStatsSaver savedStats;
+
+  setRenderMode(kRenderDepth);
+  constexpr uint kTileSizes[] = {8, 16, 32, 64};
+  for (uint tileSize : kTileSizes)
+  {
+    setDepthTileSize(tileSize);
+    frameStats = FrameStats();
+    long t0 = micros();
+    for (uint f = 0; f < kFrames; ++f)
+    {
+      frame.clear(0);
+      drawFaceMeshInstanced(&frame, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+    }
+    const long us = micros() - t0;
+
+    char label[32];
+    snprintf(label, sizeof(label), "triangles, %2ux%-2u tiles", tileSize, tileSize);
+    printRate(label, frameStats.trianglesBinned, us);
+    Serial.printf("  (tile buffers %u bytes, frame buffer %u bytes)\n", (uint)(4 * tileSize * tileSize),
+                  (uint)frameBytes);
+    yield();
+  }
+
+  setRenderMode(previousMode);
+  setDepthTileSize(previousTileSize);
+#endif
+}
+
+void benchmarkStripRender(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  constexpr uint kInstances = 8;
+  constexpr uint kFrames = 4;
+  BenchScene scene(kInstances, vCenter, 1.5f);
+
+  Serial.printf("Strip render (%u faces x %u instances x %u frames, %dx%d):\n", fc, kInstances, kFrames, width, height);
+
+  // peaks include the Display's buffers, which this build holds alongside whatever a frame uses
+  const size_t displayBytes = displayBufferBytes();
+  Serial.printf("  (display buffers %u bytes)\n", (uint)displayBytes);
+
+  // full-frame reference, if it fits
+  const size_t frameBytes = (size_t)width * height * sizeof(uint16_t);
+  long tFull = 0;
+  uint32_t fullSum = 0;
+  const bool bFull = heapFits(frameBytes);
+  if (bFull)
+  {
+    FrameBuffer565 frame(width, height);
+    long t0 = micros();
+    for (uint f = 0; f < kFrames; ++f)
+    {
+      frame.clear(0);
+      drawFaceMeshInstanced(&frame, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+      frame.present();
+    }
+    tFull = micros() - t0;
+    fullSum = frame.checksum();
+    Serial.printf("  %-28s %7ld us/frame %7u bytes peak\n", "full frame", tFull / kFrames,
+                  (uint)(frameBytes + displayBytes));
+    yield();
+  }
+  else
+  {
+    Serial.printf("  (no room for a full %u byte frame)\n", (uint)frameBytes);
+  }
+
+  const FrameStatsSaver savedStats;
+  constexpr int16_t kBandHeights[] = {8, 16, 32};
+  for (int16_t bandHeight : kBandHeights)
+  {
+    ChecksumBandSink sink;
+    StripRenderTarget strips(width, height, bandHeight, &sink);
+    long t0 = micros();
+    size_t commandBytes = 0;
+    for (uint f = 0; f < kFrames; ++f)
+    {
+      sink.reset();
+      strips.clear(0);
+      drawFaceMeshInstanced(&strips, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+      commandBytes = std::max(commandBytes, strips.commandBytes());
+      strips.present();
+    }
+    const long tStrips = micros() - t0;
+
+    char label[32];
+    snprintf(label, sizeof(label), "%d-row bands", bandHeight);
+    Serial.printf("  %-28s %7ld us/frame %7u bytes peak (band %u + commands %u)", label, tStrips / kFrames,
+                  (uint)(strips.bandBytes() + commandBytes + displayBytes), (uint)strips.bandBytes(),
+                  (uint)commandBytes);
+    if (bFull)
+    {
+      const float overhead = (tFull > 0) ? (100.0f * (float)(tStrips - tFull) / (float)tFull) : 0.0f;
+      Serial.printf(" %+5.1f%%, frames %s", overhead, (sink.checksum() == fullSum) ? "match" : "differ");
+    }
+    Serial.printf("\n");
+    yield();
+  }
+}
+
+void benchmarkDirtyRects(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  if (!framesFit("Dirty rects", 2, width, height))
+  {
+    return;
+  }
+
+  // a few small instances, drifting across the screen
+  constexpr uint kInstances = 3;
+  constexpr uint kFrames = 32;
+  constexpr float kScale = 0.3f;
+  constexpr float kDriftPerFrame = 0.03f;
+  BenchScene scene(kInstances, vCenter, 1.0f);
+  for (matrix4 &m : scene.ltow)
+  {
+    m.col[0].mul3(kScale);
+    m.col[1].mul3(kScale);
+    m.col[2].mul3(kScale);
+  }
+
+  vector3 vmin, vmax, vcen, vdif;
+  mesh.computeExtents(vmin, vmax);
+  vector3::add(vcen, vmin, vmax);
+  vcen *= 0.5f;
+  vector3::sub(vdif, vmax, vmin);
+  const Sphere localBounds(vcen, 0.5f * vdif.abs());
+
+  Serial.printf("Dirty rects (%u faces x %u instances, %u frames, %dx%d):\n", fc, kInstances, kFrames, width, height);
+
+  FrameBuffer565 frame(width, height);
+  FrameBuffer565 reference(width, height);
+  DirtyRectTracker tracker;
+  tracker.setScreen(width, height);
+  tracker.setBufferAge(1);
+
+  const FrameStatsSaver savedStats;
+  long tDirty = 0;
+  long tFull = 0;
+  uint32_t pixelsDirty = 0;
+  uint fullFrames = 0;
+  uint32_t mismatches = 0;
+  for (uint f = 0; f < kFrames; ++f)
+  {
+    for (uint i = 0; i < kInstances; ++i)
+    {
+      scene.ltow[i].m03 += (i & 1) ? kDriftPerFrame : -kDriftPerFrame;
+      scene.ltow[i].m13 += (i & 2) ? kDriftPerFrame : -kDriftPerFrame;
+    }
+
+    long t0 = micros();
+    tracker.beginFrame();
+    for (uint i = 0; i < kInstances; ++i)
+    {
+      ScreenRect rect;
+      if (instanceScreenRect(rect, localBounds, scene.ltow[i]))
+      {
+        tracker.add(rect);
+      }
+      else
+      {
+        tracker.addFullScreen();
+      }
+    }
+    tracker.endFrame();
+    for (const ScreenRect &r : tracker.regions())
+    {
+      frame.fillRect(r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0, 0);
+    }
+    drawFaceMeshInstanced(&frame, mesh, &scene.ltow[0], kInstances, &scene.colors[0], &localBounds);
+    tDirty += micros() - t0;
+    pixelsDirty += tracker.regionPixels();
+    fullFrames += tracker.isFullFrame() ? 1 : 0;
+
+    t0 = micros();
+    reference.clear(0);
+    drawFaceMeshInstanced(&reference, mesh, &scene.ltow[0], kInstances, &scene.colors[0], &localBounds);
+    tFull += micros() - t0;
+
+    mismatches += frame.diffCount(reference);
+    yield();
+  }
+
+  const uint32_t pixelsFull = (uint32_t)width * height;
+  Serial.printf("  %-28s %7ld us/frame %7u px cleared\n", "full frame", tFull / kFrames, pixelsFull);
+  Serial.printf("  %-28s %7ld us/frame %7u px cleared (%.1f%%, %u full-frame fallbacks)\n", "dirty rects",
+                tDirty / kFrames, pixelsDirty / kFrames, 100.0f * (float)pixelsDirty / (float)(pixelsFull * kFrames),
+                fullFrames);
+  Serial.printf("  pixels differing from a full redraw: %u\n", mismatches);
+}
+
+void benchmarkAsyncPresent(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  if (!framesFit("Async present", 2, width, height))
+  {
+    return;
+  }
+
+  constexpr uint kInstances = 4;
+  constexpr uint kFrames = 32;
+  constexpr uint32_t kSpiHz = 40000000;
+  BenchScene scene(kInstances, vCenter, 1.5f);
+
+  Serial.printf("Async present (%u faces x %u instances, %u frames, %dx%d):\n", fc, kInstances, kFrames, width, height);
+
+  const FrameStatsSaver savedStats;
+  SimulatedSpiSink sink(kSpiHz);
+  AsyncPresenter presenter(width, height, &sink);
+  for (uint pass = 0; pass < 2; ++pass)
+  {
+    const bool bAsync = (pass == 1);
+    if (bAsync && !presenter.start(0))
+    {
+      Serial.printf("  (couldn't start the present worker)\n");
+      break;
+    }
+    presenter.resetStats();
+
+    long t0 = micros();
+    for (uint f = 0; f < kFrames; ++f)
+    {
+      FrameBuffer565 &frame = presenter.beginFrame();
+      frame.clear(0);
+      drawFaceMeshInstanced(&frame, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+      presenter.submit();
+    }
+    presenter.waitIdle();
+    const long us = micros() - t0;
+    presenter.stop();
+
+    const float fps = (us > 0) ? (1.0e6f * (float)kFrames / (float)us) : 0.0f;
+    Serial.printf("  %-28s %6.1f fps, latency %6u us (present %u us)\n", bAsync ? "pipelined" : "serial", fps,
+                  presenter.averageLatencyMicros(), presenter.averagePresentMicros());
+    yield();
+  }
+}
+
+void benchmarkParallelRaster(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  constexpr uint kInstances = 8;
+  constexpr uint kFrames = 4;
+  constexpr uint kMaxWorkers = 4; // (the ESP32 has two cores; more workers only show the queue's overhead there)
+  constexpr int16_t kBandRows = 8;
+  BenchScene scene(kInstances, vCenter, 1.5f);
+
+  Serial.printf("Parallel raster (%u faces x %u instances x %u frames, %d-row bands):\n", fc, kInstances, kFrames,
+                kBandRows);
+
+  const FrameStatsSaver savedStats;
+  const int16_t sizes[][2] = {
+      {(int16_t)(width / 2), (int16_t)(height / 2)}, {width, height}, {(int16_t)(width * 2), (int16_t)(height * 2)}};
+  for (const int16_t *size : sizes)
+  {
+    const int16_t w = size[0];
+    const int16_t h = size[1];
+    const size_t frameBytes = (size_t)w * h * sizeof(uint16_t);
+    if (!heapFits(frameBytes))
+    {
+      Serial.printf("  %dx%d: not enough memory for a %u byte frame\n", w, h, (uint)frameBytes);
+      continue;
+    }
+    SetScreenMatrix(w, h);
+
+    ParallelRenderTarget target(w, h, kBandRows, 1);
+    long tOne = 0;
+    uint32_t oneSum = 0;
+    for (uint workers = 1; workers <= kMaxWorkers; ++workers)
+    {
+      if (target.setWorkerCount(workers) != workers)
+      {
+        Serial.printf("  (couldn't start %u workers)\n", workers);
+        break;
+      }
+      long tRaster = 0;
+      for (uint f = 0; f < kFrames; ++f)
+      {
+        target.clear(0);
+        drawFaceMeshInstanced(&target, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+        long t0 = micros(); // (recording is serial: only the banded rasterization is timed)
+        target.present();
+        tRaster += micros() - t0;
+      }
+      if (workers == 1)
+      {
+        tOne = tRaster;
+        oneSum = target.frame().checksum();
+      }
+
+      char label[32];
+      snprintf(label, sizeof(label), "%dx%d, %u worker%s", w, h, workers, (workers == 1) ? "" : "s");
+      const float speedup = (tRaster > 0) ? ((float)tOne / (float)tRaster) : 0.0f;
+      Serial.printf("  %-28s %7ld us/frame x%4.2f bands", label, tRaster / kFrames, speedup);
+      for (uint i = 0; i < workers; ++i)
+      {
+        Serial.printf("%s%u", (i == 0) ? " " : "/", target.bandsDrawn(i));
+      }
+      Serial.printf(", frames %s\n", (target.frame().checksum() == oneSum) ? "match" : "differ");
+      yield();
+    }
+  }
+  SetScreenMatrix(width, height);
+}
+
+void benchmarkCommandList(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  if (!framesFit("Command list", 1, width, height))
+  {
+    return;
+  }
+
+  constexpr uint kInstances = 4;
+  constexpr uint kFrames = 4;
+  constexpr int16_t kRegionRows = 16;
+  const char *kCapturePath = "/spiffs/capture.mcl";
+  BenchScene scene(kInstances, vCenter, 1.5f);
+
+  Serial.printf("Command list (%u faces x %u instances x %u frames, %dx%d):\n", fc, kInstances, kFrames, width, height);
+
+  FrameBuffer565 frame(width, height);
+  CommandList list(width, height);
+  CommandList captured(width, height);
+  const RenderMode previousMode = getRenderMode();
+  const FrameStatsSaver savedStats;
+  SPIFFS.begin();
+
+  const RenderMode modes[] = {
+    kRenderWireframe,
+#if USE_FACE_NORMALS
+    kRenderFlat,
+#endif
+  };
+  for (RenderMode mode : modes)
+  {
+    setRenderMode(mode);
+    Serial.printf(" %s:\n", (mode == kRenderFlat) ? "flat" : "wireframe");
+
+    // geometry and raster interleaved, as the renderer draws normally
+    long t0 = micros();
+    for (uint f = 0; f < kFrames; ++f)
+    {
+      frame.clear(0);
+      drawFaceMeshInstanced(&frame, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+    }
+    const long tDirect = micros() - t0;
+    const uint32_t directSum = frame.checksum();
+
+    // geometry only, into the list
+    t0 = micros();
+    for (uint f = 0; f < kFrames; ++f)
+    {
+      list.clear(0);
+      drawFaceMeshInstanced(&list, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+    }
+    const long tGeometry = micros() - t0;
+
+    // raster only, from a capture read back from flash
+    const bool bCaptured = list.write(kCapturePath) && captured.read(kCapturePath);
+    CommandList &replayed = bCaptured ? captured : list;
+    t0 = micros();
+    for (uint f = 0; f < kFrames; ++f)
+    {
+      frame.clear(replayed.clearColor());
+      replayed.replay(frame);
+    }
+    const long tRaster = micros() - t0;
+
+    Serial.printf("  %-28s %7ld us/frame\n", "geometry + raster", tDirect / kFrames);
+    Serial.printf("  %-28s %7ld us/frame %6u commands %7u bytes\n", "geometry into list", tGeometry / kFrames,
+                  list.commandCount(), (uint)list.bytes());
+    Serial.printf("  %-28s %7ld us/frame (%s), frames %s\n", "replay", tRaster / kFrames,
+                  bCaptured ? "from file" : "couldn't save capture", (frame.checksum() == directSum) ? "match" : "differ");
+
+    // (reordering changes which primitive wins where they overlap, so these frames may differ)
+    for (uint sort = 0; sort < 2; ++sort)
+    {
+      if (sort == 0)
+      {
+        replayed.sortByRegion(kRegionRows);
+      }
+      else
+      {
+        replayed.sortByColor();
+      }
+      t0 = micros();
+      for (uint f = 0; f < kFrames; ++f)
+      {
+        frame.clear(replayed.clearColor());
+        replayed.replay(frame);
+      }
+      Serial.printf("  %-28s %7ld us/frame\n", (sort == 0) ? "replay, sorted by region" : "replay, sorted by color",
+                    (micros() - t0) / kFrames);
+    }
+    yield();
+  }
+
+  remove(kCapturePath);
+  SPIFFS.end();
+  setRenderMode(previousMode);
+}
+
+void benchmarkIndexedFrame(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  const size_t frameBytes = (size_t)width * height * sizeof(uint16_t);
+  if (!framesFit("Indexed frame", 1, width, height, frameBytes / 2))
+  {
+    return;
+  }
+
+  constexpr uint kInstances = 8;
+  constexpr uint kFrames = 4;
+  constexpr int16_t kStripRows = 16;
+  BenchScene scene(kInstances, vCenter, 1.5f);
+
+  Serial.printf("Indexed frame (%u faces x %u instances x %u frames, %dx%d):\n", fc, kInstances, kFrames, width, height);
+
+  FrameBuffer565 frame(width, height);
+  IndexedFrameBuffer indexed(width, height, kStripRows);
+  indexed.setPalette(&scene.colors[0], kInstances);
+  const FrameStatsSaver savedStats;
+
+  long t0 = micros();
+  for (uint f = 0; f < kFrames; ++f)
+  {
+    frame.clear(0);
+    drawFaceMeshInstanced(&frame, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+  }
+  const long tFrame = micros() - t0;
+  yield();
+
+  t0 = micros();
+  for (uint f = 0; f < kFrames; ++f)
+  {
+    indexed.clear(0);
+    drawFaceMeshInstanced(&indexed, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+  }
+  const long tIndexed = micros() - t0;
+  yield();
+
+  // present-time conversion alone, a strip at a time (as present() does)
+  std::vector<uint16_t> strip((size_t)width * kStripRows);
+  t0 = micros();
+  for (uint f = 0; f < kFrames; ++f)
+  {
+    for (int16_t y = 0; y < height; y += kStripRows)
+    {
+      indexed.convertRows(&strip[0], y, std::min(kStripRows, (int16_t)(height - y)));
+    }
+  }
+  const long tConvert = micros() - t0;
+
+  // the converted frame should be the RGB565 one, as long as the palette held every color
+  uint32_t differ = 0;
+  for (int16_t y = 0; y < height; ++y)
+  {
+    indexed.convertRows(&strip[0], y, 1);
+    for (int16_t x = 0; x < width; ++x)
+    {
+      differ += (strip[x] != frame.getPixel(x, y)) ? 1 : 0;
+    }
+  }
+
+  Serial.printf("  %-28s %7ld us/frame %7u bytes\n", "RGB565 raster", tFrame / kFrames, (uint)frameBytes);
+  Serial.printf("  %-28s %7ld us/frame %7u bytes (+ %u of strips)\n", "8-bit raster", tIndexed / kFrames,
+                (uint)indexed.frameBytes(), (uint)indexed.stripBytes());
+  Serial.printf("  %-28s %7ld us/frame (%u colors), %u pixels differ\n", "8-bit to RGB565 conversion",
+                tConvert / kFrames, indexed.paletteSize(), differ);
+}
+
+void benchmarkDynamicResolution(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  if (!framesFit("Dynamic resolution", 1, width, height))
+  {
+    return;
+  }
+
+  constexpr uint kInstances = 8;
+  constexpr uint kFrames = 4;
+  constexpr uint kControlledFrames = 48;
+  constexpr int16_t kStripRows = 16;
+  BenchScene scene(kInstances, vCenter, 1.5f);
+
+  Serial.printf("Dynamic resolution (%u faces x %u instances x %u frames, %dx%d):\n", fc, kInstances, kFrames, width,
+                height);
+
+  NullBandSink sink;
+  ScaledRenderTarget target(width, height, kStripRows, &sink);
+  const FrameStatsSaver savedStats;
+
+  long tFull = 0;
+  constexpr float kScales[] = {1.0f, 0.75f, 0.5f};
+  for (float scale : kScales)
+  {
+    target.setScale(scale);
+    SetScreenMatrix(target.width(), target.height());
+    long tRaster = 0;
+    long tUpscale = 0;
+    for (uint f = 0; f < kFrames; ++f)
+    {
+      long t0 = micros();
+      target.clear(0);
+      drawFaceMeshInstanced(&target, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+      long t1 = micros();
+      target.present();
+      tRaster += t1 - t0;
+      tUpscale += micros() - t1;
+    }
+    if (scale == 1.0f)
+    {
+      tFull = tRaster + tUpscale;
+    }
+
+    char label[32];
+    snprintf(label, sizeof(label), "scale %4.2f (%dx%d)", scale, target.width(), target.height());
+    Serial.printf("  %-28s %7ld us/frame render, %6ld us/frame upscale\n", label, tRaster / kFrames,
+                  tUpscale / kFrames);
+    yield();
+  }
+
+  // closed loop: a target of 60% of the full-size frame time
+  ResolutionController controller;
+  controller.setTargetFrameMicros((uint32_t)(0.6f * (float)tFull / (float)kFrames));
+  controller.setScaleRange(0.25f, 1.0f);
+  target.setScale(controller.scale());
+  SetScreenMatrix(target.width(), target.height());
+  uint changes = 0;
+  for (uint f = 0; f < kControlledFrames; ++f)
+  {
+    long t0 = micros();
+    target.clear(0);
+    drawFaceMeshInstanced(&target, mesh, &scene.ltow[0], kInstances, &scene.colors[0]);
+    target.present();
+    if (controller.update((uint32_t)(micros() - t0)))
+    {
+      target.setScale(controller.scale());
+      SetScreenMatrix(target.width(), target.height());
+      ++changes;
+    }
+  }
+  Serial.printf("  target %7ld us: settled at scale %4.2f (%dx%d), %u us/frame after %u changes\n",
+                (long)(0.6f * (float)tFull / (float)kFrames), controller.scale(), target.width(), target.height(),
+                controller.averageFrameMicros(), changes);
+
+  SetScreenMatrix(width, height);
+}
+
+void benchmarkQualityGovernor(const FaceMesh &mesh, const vector3 &vCenter, int16_t width, int16_t height)
+{
+  const uint fc = mesh.faceCount();
+  if ((fc == 0) || (width <= 0) || (height <= 0))
+  {
+    return;
+  }
+
+  if (!framesFit("Quality governor", 1, width, height))
+  {
+    return;
+  }
+
+  constexpr uint kInstances = 8;
+  constexpr uint kFrames = 4;
+  constexpr uint kLodLevels = 3;
+  constexpr uint32_t kUpdateMicros = 2000; // (modeled: there's no simulation here to time)
+  constexpr uint kSimulatedFrames = 600;
+  constexpr uint kSpikeStart = 150;
+  constexpr uint kSpikeEnd = 350;
+  constexpr float kSpikeLoad = 3.0f; // (scene cost multiple during the spike)
+  BenchScene scene(kInstances, vCenter, 3.0f);
+
+  vector3 vmin, vmax, vcen;
+  mesh.computeExtents(vmin, vmax);
+  vector3::add(vcen, vmin, vmax);
+  vcen *= 0.5f;
+  const Sphere bounds(vcen, mesh.computeExtentsFrom(vcen));
+
+  FaceMeshLod lod;
+  lod.build(mesh, kLodLevels);
+  Serial.printf("Quality governor (%u faces x %u instances, %dx%d), levels of detail:", fc, kInstances, width, height);
+  for (uint i = 0; i < lod.levelCount(); ++i)
+  {
+    Serial.printf(" %u", lod.level(i).faceCount());
+  }
+  Serial.printf(" faces\n");
+
+  QualityGovernor governor;
+  governor.setLodLevels(lod.levelCount());
+  governor.setSkipRadius(4.0f, 3);
+  governor.setInstanceRange(1, kInstances);
+  governor.setSimulationSteps(1);
+
+  // the real cost of each phase at each level (present: a 40 MHz SPI transfer of the frame)
+  FrameBuffer565 frame(width, height);
+  CommandList commands(width, height);
+  const FrameStatsSaver savedStats;
+  SetScreenMatrix(width, height);
+  const uint levelCount = governor.levelCount();
+  std::vector<uint32_t> phaseCost(levelCount * kPhaseCount, 0);
+  const uint32_t presentMicros = (uint32_t)(((uint64_t)width * height * 16 * 1000000) / 40000000);
+  std::vector<matrix4> groupLtoW[kLodLevels];
+  std::vector<uint16_t> groupColors[kLodLevels];
+  const uint lodCount = std::min(lod.levelCount(), kLodLevels);
+  for (uint level = 0; level < levelCount; ++level)
+  {
+    const QualitySettings &quality = governor.levelSettings(level);
+    uint32_t *cost = &phaseCost[level * kPhaseCount];
+    uint drawn = 0;
+    for (uint f = 0; f < kFrames; ++f)
+    {
+      long t0 = micros();
+      for (uint i = 0; i < kLodLevels; ++i)
+      {
+        groupLtoW[i].clear();
+        groupColors[i].clear();
+      }
+      drawn = 0;
+      for (uint i = 0; i < std::min(kInstances, quality.instanceLimit); ++i)
+      {
+        if (addInstanceByLod(groupLtoW, groupColors, lodCount, bounds, scene.ltow[i], scene.colors[i], quality))
+        {
+          ++drawn;
+        }
+      }
+      long t1 = micros();
+      commands.clear(0);
+      for (uint i = 0; i < kLodLevels; ++i)
+      {
+        if (!groupLtoW[i].empty())
+        {
+          drawFaceMeshInstanced(&commands, lod.level(i), groupLtoW[i].data(), groupLtoW[i].size(),
+                                groupColors[i].data(), &bounds);
+        }
+      }
+      long t2 = micros();
+      frame.clear(0);
+      commands.replay(frame);
+      long t3 = micros();
+      cost[kPhaseCull] += t1 - t0;
+      cost[kPhaseTransform] += t2 - t1;
+      cost[kPhaseRaster] += t3 - t2;
+    }
+    cost[kPhaseUpdate] = kUpdateMicros / quality.simulationInterval;
+    cost[kPhaseCull] /= kFrames;
+    cost[kPhaseTransform] /= kFrames;
+    cost[kPhaseRaster] /= kFrames;
+    cost[kPhasePresent] = presentMicros;
+
+    Serial.printf("  level %2u (lod+%u skip<%2.0fpx instances<=%u simulation 1/%u): %u drawn, %6u us/frame\n", level,
+                  quality.lodBias, quality.minScreenRadius, quality.instanceLimit, quality.simulationInterval, drawn,
+                  cost[kPhaseUpdate] + cost[kPhaseCull] + cost[kPhaseTransform] + cost[kPhaseRaster] +
+                      cost[kPhasePresent]);
+    yield();
+  }
+
+  // simulated run: each frame advances the clock by its level's costs (the scene's phases scaled
+  // by the load), with a budget the full-quality frame fits with room to spare, until a spike
+  uint32_t fullMicros = 0;
+  for (uint i = 0; i < kPhaseCount; ++i)
+  {
+    fullMicros += phaseCost[i];
+  }
+  SimulatedFrameClock clock;
+  governor.setClock(&clock);
+  governor.setBudgetMicros((uint32_t)((float)fullMicros / 0.75f));
+  Serial.printf("  budget %u us, load x%3.1f for frames %u-%u of %u:\n", governor.budgetMicros(), kSpikeLoad,
+                kSpikeStart, kSpikeEnd - 1, kSimulatedFrames);
+  for (uint f = 0; f < kSimulatedFrames; ++f)
+  {
+    const float load = ((f >= kSpikeStart) && (f < kSpikeEnd)) ? kSpikeLoad : 1.0f;
+    const uint32_t *cost = &phaseCost[governor.level() * kPhaseCount];
+    governor.beginFrame();
+    clock.advance(cost[kPhaseUpdate]);
+    governor.beginPhase(kPhaseCull);
+    clock.advance((uint32_t)(load * (float)cost[kPhaseCull]));
+    governor.beginPhase(kPhaseTransform);
+    clock.advance((uint32_t)(load * (float)cost[kPhaseTransform]));
+    governor.beginPhase(kPhaseRaster);
+    clock.advance((uint32_t)(load * (float)cost[kPhaseRaster]));
+    governor.beginPhase(kPhasePresent);
+    clock.advance(cost[kPhasePresent]);
+    if (governor.endFrame())
+    {
+      const GovernorStats &stats = governor.stats();
+      Serial.printf("    frame %3u: %s to level %u (average %u us)\n", f,
+                    (stats.lastDecision == kDecisionDegrade) ? "down" : "up", stats.level, stats.averageMicros);
+    }
+  }
+  const GovernorStats &stats = governor.stats();
+  Serial.printf("  %u of %u frames over budget, %u degradations, %u restorations, final level %u\n",
+                stats.framesOverBudget, stats.frames, stats.degradations, stats.restorations, stats.level);
+}
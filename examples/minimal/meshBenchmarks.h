@@ -0,0 +1,69 @@
+/**
+ * @file meshBenchmarks.h
+ * @author Stephen Schlueter, github: stevesch
+ * @brief Timing benchmarks for the mesh library, run against the loaded model
+ * @version 0.1
+ * @date 2021-05-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <Arduino.h>
+
+// build with -DMESH_BENCHMARKS=1 to run benchmarks (printed to Serial) each time a model is loaded
+#ifndef MESH_BENCHMARKS
+#define MESH_BENCHMARKS 0
+#endif
+
+namespace stevesch
+{
+  class FaceMesh;
+  class RenderTarget;
+  class vector3;
+}
+
+void benchmarkModel(const char *name, const stevesch::FaceMesh &mesh);
+
+void benchmarkBVH(const stevesch::FaceMesh &mesh);
+// backface classification: view-space per face vs object-space per face vs per unique normal
+void benchmarkCulling(const stevesch::FaceMesh &mesh);
+// per-vertex cycles: separate viewport transform vs folded into the projection, 4x4 vs affine model-view
+void benchmarkTransform(const stevesch::FaceMesh &mesh);
+// vertices per second through the compiled vertex kernel backend vs the scalar kernel
+void benchmarkVertexKernel(const stevesch::FaceMesh &mesh);
+// per-vertex cycles and pixel error of the fixed-point projection against the float path
+void benchmarkFixedPoint(const stevesch::FaceMesh &mesh);
+// per-instance draw cost, one call per instance vs one instanced call, for a range of instance counts
+void benchmarkInstancing(stevesch::RenderTarget *renderTarget, const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter);
+// separate draws of static props vs one pre-transformed batch
+void benchmarkStaticBatch(stevesch::RenderTarget *renderTarget, const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter);
+// lines and pixels per second: the display's drawLine vs the direct rasterizer at each boardSetups resolution
+void benchmarkLineRaster(stevesch::RenderTarget *displayTarget);
+// the instancing comparison drawn into RAM framebuffers instead of the display: timing without
+// display transfers, and an exact pixel comparison of instanced drawing against an unoptimized
+// per-face reference (differences are rounding at edge endpoints, and edges the reference skips
+// rather than clips)
+void benchmarkHeadless(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
+// faces per second, filled flat-shaded vs drawn as wireframe, into a RAM framebuffer
+void benchmarkFlatFill(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
+// triangles per second through the tiled depth-buffered rasterizer, for a range of tile sizes
+void benchmarkTileRaster(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
+// frame time and peak memory (with the Display's buffers) drawing through a band buffer (several band
+// heights) vs a full framebuffer
+void benchmarkStripRender(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
+// pixels cleared and presented per frame, redrawing only dirty rectangles vs the full frame, for a
+// few small moving instances (and a check that the frames match a full redraw)
+void benchmarkDirtyRects(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
+// frame throughput and latency presenting serially vs from a worker while the next frame is drawn
+// (present time simulated as a 40 MHz SPI transfer)
+void benchmarkAsyncPresent(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
+// banded rasterization time with 1..N workers, at half, full and double the display's size (as memory allows)
+void benchmarkParallelRaster(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
+// geometry and raster stages timed apart through a CommandList, the raster stage replaying a capture saved to flash
+void benchmarkCommandList(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
+// rasterization into RGB565 vs 8-bit palettized frames, and the palettized frame's conversion at present time
+void benchmarkIndexedFrame(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
+// raster and upscale time at reduced render scales, and the scale the resolution controller settles on for a target
+void benchmarkDynamicResolution(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
+// each quality governor level's phase costs, then the governor on a simulated clock through a load spike
+void benchmarkQualityGovernor(const stevesch::FaceMesh &mesh, const stevesch::vector3 &vCenter, int16_t width, int16_t height);
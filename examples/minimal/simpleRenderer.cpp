@@ -9,6 +9,8 @@
  * 
  */
 #include "simpleRenderer.h"
+#include "meshBenchmarks.h"
+#include "tftRenderTarget.h"
 
 #include <StreamString.h>
 
@@ -20,6 +22,8 @@
 #include <SPIFFS.h>
 #include <esp_vfs.h>
 
+#include <algorithm>
+
 using namespace stevesch;
 
 ///
@@ -32,19 +36,27 @@ Button2 button2(BUTTON_2);
 ///
 
 Display display(TFT_WIDTH, TFT_HEIGHT);
+TftRenderTarget displayTarget; // the display's current render target, for the renderer
 
 float sFOV_Vertical = degToRad(60.0f);
+float sFOV_Horizontal = 0.0f; // set by SetScreenMatrix
 constexpr float kZNear = 0.1f;  // near clip plane distance
 constexpr float kZFar = 8.0f;   // far clip plane distance
-// Note: we're not doing strict clipping-- just discarding edges that go behind the camera,
-// so kZNear and kZFar are primarily just determining the mapping and precision of the clip space.
+// Note: edges are clipped to the near plane and the screen (not the far plane),
+// so kZFar is primarily just determining the mapping and precision of the clip space.
+
+// Edges are clipped in clip space to this many times the viewport in x and y (a guard band).
+// 1 clips exactly to the screen; larger values leave slightly off-screen pixels to the display
+// driver's own bounds check in exchange for less clipping work.
+constexpr float kGuardBand = 1.0f;
+ClipRegion clipRegion; // set by SetScreenMatrix
 
 vector4 vCameraFocus(0.0f, 0.0f, -4.0f);
 vector4 limita, limitb; // cheap xyz limits for objects
 
 matrix4 mtxWtoV(1.0f);   // world-to-view [camera] transform (inverse of the world space transform of the camera object)
 matrix4 mtxVtoC(1.0f);   // view-to-clip transform (projection)
-matrix4 mtxNDCtoS(1.0f); // normalized-device-coords-to-screen transform
+matrix4 mtxVtoS(1.0f);   // view-to-screen: the projection with the viewport folded in (x/w, y/w are pixels)
 
 // vertDst is a temporary buffer for transformed vertices.  It's length will grow if a face
 // with more vertices is encountered.  Typically a face has a small number of verts (a triangle has 3,
@@ -52,17 +64,47 @@ matrix4 mtxNDCtoS(1.0f); // normalized-device-coords-to-screen transform
 // reduce fragmentation, but the length will grow if necessary.
 std::vector<vector3> vertDst;
 
+// scratch for instanced drawing (grown as needed, like vertDst)
+std::vector<vector3> vertSrc;  // local-space positions of the face being drawn
+std::vector<vector4> vertClip; // homogeneous screen-space positions of the face being drawn
+std::vector<uint8_t> vertOutcode; // clip outcode of each of vertClip
+#if MESH_FIXED_POINT
+std::vector<fixedVector3> vertSrcFixed; // vertSrc in 16.16
+std::vector<fixedPoint2> vertFixed;     // subpixel screen positions (unclipped instances)
+#endif
+std::vector<affine4x3> instLtoV; // per-instance local-to-view
+std::vector<matrix4> instLtoS;   // per-instance local-to-screen (homogeneous)
+#if MESH_FIXED_POINT
+std::vector<fixedMatrix4> instLtoSFixed; // 16.16 copy of instLtoS (unclipped instances only)
+#endif
+std::vector<uint16_t> instColor;
+std::vector<int8_t> instClass; // frustum classification (SINTERSECTION) per instance
+#if USE_FACE_NORMALS
+std::vector<vector3> instEye;  // per-instance eye position in local space
+std::vector<float> normalDots; // per chunk instance, (normal . eye) for each unique normal
+std::vector<vector3> instLight;    // per-instance direction toward the light in local space (flat mode)
+std::vector<uint16_t> normalShade; // per chunk instance, shaded color for each unique normal (flat mode)
+#endif
+std::vector<matrix4> sceneLtoW;
+std::vector<uint16_t> sceneColor;
+std::vector<FaceRange> batchRanges;
+
 // updated in updateFrustum:
 matrix4 mtxVtoW;
 Frustum frustum;
 
 FaceMesh mesh1;
+Sphere mesh1Bounds(0.0f, 0.0f, 0.0f, 0.0f); // local-space bounding sphere of mesh1
+
+FrameStats frameStats;
 
 std::vector<String> models;
 
 int currentModel = -1;
 
 bool usingPlaceholder = false;
+const char *const kPlaceholderHint =
+    "No .obj found in data folder.  Rendering placeholder model.  Use 'Upload Filesystem Image' to upload .obj files";
 
 struct Inst : public SceneObj
 {
@@ -73,135 +115,1102 @@ std::vector<Inst> instances;
 const int maxInstCount = 8;
 int activeInstCount = 1;
 
-inline void perspectiveTransform(vector3 &vOut, const vector4 &vLocal, const matrix4 &mtxLToC)
+// build with -DMORPH_DEMO=1 to animate the model with a "breathing" morph target
+#ifndef MORPH_DEMO
+#define MORPH_DEMO 0
+#endif
+
+// build with -DSTRIP_RENDERING=<rows> to draw the scene into a band buffer of that many rows,
+// pushed straight to the panel one band at a time (the Display isn't set up, so the frame's
+// memory is one band plus the recorded drawing commands; the overlay is drawn on the panel)
+#ifndef STRIP_RENDERING
+#define STRIP_RENDERING 0
+#endif
+
+// build with -DPARALLEL_RASTER=<workers> to draw the scene into a RAM framebuffer on that many
+// cores (in bands taken from a shared queue), then push the frame to the display
+#ifndef PARALLEL_RASTER
+#define PARALLEL_RASTER 0
+#endif
+
+// build with -DCOMMAND_LIST=1 to run the geometry stage into a command list, then replay the
+// list into the display as a separate raster stage
+#ifndef COMMAND_LIST
+#define COMMAND_LIST 0
+#endif
+
+// build with -DINDEXED_FRAMEBUFFER=<rows> to draw the scene into an 8-bit palettized frame,
+// converted to RGB565 in strips of that many rows and sent straight to the panel by DMA (each
+// strip's transfer overlaps converting the next; the Display isn't set up)
+#ifndef INDEXED_FRAMEBUFFER
+#define INDEXED_FRAMEBUFFER 0
+#endif
+
+// build with -DDYNAMIC_RESOLUTION=<target fps> to render the scene at a reduced size when
+// frames run long (scaled up as it's pushed to the display), to hold that frame rate
+#ifndef DYNAMIC_RESOLUTION
+#define DYNAMIC_RESOLUTION 0
+#endif
+
+// build with -DDIRTY_RECTS=1 to clear, redraw and push to the panel only the screen regions
+// covered by instances in this frame or the last one, rather than the whole frame (the frame is
+// kept in a RAM framebuffer of its own, and the Display isn't set up)
+#ifndef DIRTY_RECTS
+#define DIRTY_RECTS 0
+#endif
+
+// build with -DASYNC_PRESENT=1 to draw each frame into one of two RAM framebuffers while a
+// worker on the other core pushes the previous one straight to the panel.  The two frames
+// (4 * width * height bytes) take the place of the Display's two sprites, which are never
+// allocated since the Display isn't set up.  Stats go to Serial, since the overlay text can't
+// be drawn into a framebuffer.
+#ifndef ASYNC_PRESENT
+#define ASYNC_PRESENT 0
+#endif
+
+// build with -DQUALITY_GOVERNOR=<target fps> to time each phase of the frame and, while frames
+// run over that budget, step quality down: coarser levels of detail (generated from the model),
+// skipping small instances, drawing fewer instances, then simulating every other frame
+#ifndef QUALITY_GOVERNOR
+#define QUALITY_GOVERNOR 0
+#endif
+
+// modes that assemble the frame themselves push it straight to the panel rather than through the
+// Display, which is then never set up (so its two full-frame sprites are never allocated)
+#define DIRECT_PANEL (STRIP_RENDERING || INDEXED_FRAMEBUFFER || DIRTY_RECTS || ASYNC_PRESENT)
+
+#if STRIP_RENDERING
+StripRenderTarget *stripTarget = nullptr; // created in setup, once the display size is known
+TftBandSink bandSink;
+#endif
+
+#if PARALLEL_RASTER
+#if STRIP_RENDERING
+#error "PARALLEL_RASTER can't be combined with STRIP_RENDERING"
+#endif
+ParallelRenderTarget *parallelTarget = nullptr; // created in setup, once the display size is known
+TftBandSink frameSink;                          // (the frame arrives as a single band)
+constexpr int16_t kParallelBandRows = 8;
+#endif
+
+#if COMMAND_LIST
+#if STRIP_RENDERING || PARALLEL_RASTER
+#error "COMMAND_LIST can't be combined with STRIP_RENDERING or PARALLEL_RASTER"
+#endif
+CommandList *commandList = nullptr; // created in setup, once the display size is known
+#endif
+
+#if INDEXED_FRAMEBUFFER
+#if STRIP_RENDERING || PARALLEL_RASTER || COMMAND_LIST
+#error "INDEXED_FRAMEBUFFER can't be combined with STRIP_RENDERING, PARALLEL_RASTER or COMMAND_LIST"
+#endif
+IndexedFrameBuffer *indexedTarget = nullptr; // created in setup, once the display size is known
+TftDmaBandSink stripSink;
+#endif
+
+#if DYNAMIC_RESOLUTION
+#if STRIP_RENDERING || PARALLEL_RASTER || COMMAND_LIST || INDEXED_FRAMEBUFFER || DIRTY_RECTS
+#error "DYNAMIC_RESOLUTION can only be combined with the default full-frame rendering"
+#endif
+ScaledRenderTarget *scaledTarget = nullptr; // created in setup, once the display size is known
+TftBandSink scaledSink;
+ResolutionController resolutionController;
+constexpr float kMinRenderScale = 0.5f;
+constexpr float kResolutionHysteresis = 0.15f; // (of the target frame time)
+constexpr int16_t kUpscaleStripRows = 16;
+
+// resizes the scene's render target and projection to the controller's scale
+void applyRenderScale()
+{
+  scaledTarget->setScale(resolutionController.scale());
+  SetScreenMatrix(scaledTarget->width(), scaledTarget->height());
+}
+#endif
+
+#if DIRTY_RECTS
+#if STRIP_RENDERING || PARALLEL_RASTER || COMMAND_LIST || INDEXED_FRAMEBUFFER
+#error "DIRTY_RECTS can only be combined with the default full-frame rendering"
+#endif
+DirtyRectTracker dirtyRects;
+FrameBuffer565 *dirtyFrame = nullptr; // created in setup, once the display size is known
+constexpr uint kDirtyBufferAge = 1;   // (one buffer: it last held the previous frame)
+#endif
+
+#if ASYNC_PRESENT
+#if STRIP_RENDERING || DIRTY_RECTS || PARALLEL_RASTER || COMMAND_LIST || INDEXED_FRAMEBUFFER || DYNAMIC_RESOLUTION
+#error "ASYNC_PRESENT can only be combined with the default full-frame rendering"
+#endif
+
+// runs on the present worker, which is the panel's only user while it's running
+class PanelFrameSink : public FrameSink
+{
+public:
+  void setTarget(TFT_eSPI *tft) { mBands.setTarget(tft); }
+
+  void presentFrame(const FrameBuffer565 &frame) override
+  {
+    mBands.pushBand(0, frame.width(), frame.height(), frame.pixels());
+  }
+
+protected:
+  TftBandSink mBands; // (the whole frame as one band)
+};
+
+PanelFrameSink panelSink;
+AsyncPresenter *asyncPresenter = nullptr; // created in setup, once the display size is known
+constexpr int kPresentCore = 0;            // (the Arduino loop runs on core 1)
+long tPresentStats = 0;
+
+// prints present throughput and latency every few seconds
+void reportAsyncPresent()
+{
+  constexpr long kReportMicros = 5000000;
+  const long tNow = micros();
+  if ((tNow - tPresentStats) < kReportMicros)
+  {
+    return;
+  }
+  const float seconds = 1.0e-6f * (float)(tNow - tPresentStats);
+  Serial.printf("present: %5.1f fps, latency %u us (present %u us)\n",
+                (float)asyncPresenter->framesPresented() / seconds, asyncPresenter->averageLatencyMicros(),
+                asyncPresenter->averagePresentMicros());
+  asyncPresenter->resetStats();
+  tPresentStats = tNow;
+}
+#endif
+
+#if QUALITY_GOVERNOR
+#if STRIP_RENDERING || DIRTY_RECTS || PARALLEL_RASTER || COMMAND_LIST || INDEXED_FRAMEBUFFER || DYNAMIC_RESOLUTION || ASYNC_PRESENT
+#error "QUALITY_GOVERNOR can only be combined with the default full-frame rendering"
+#endif
+QualityGovernor qualityGovernor;
+CommandList *governedList = nullptr; // (geometry is recorded, then replayed as the raster phase)
+constexpr uint kLodLevels = 3;
+constexpr float kSkipRadius = 4.0f; // (pixels) the governor's first skip size, doubled at each step
+constexpr uint kSkipSteps = 3;
+FaceMeshLod mesh1Lod; // built as each model loads
+
+// the instances to draw at each level of detail
+std::vector<matrix4> lodLtoW[kLodLevels];
+std::vector<uint16_t> lodColors[kLodLevels];
+uint governedSkipped = 0;
+
+float simulationDt = 0.0f; // (time not yet simulated)
+uint simulationFrames = 0;
+#endif
+
+#if DIRECT_PANEL
+// build with -DPANEL_ROTATION=<0..3> to turn the panel (TFT_WIDTH x TFT_HEIGHT is rotation 0)
+#ifndef PANEL_ROTATION
+#define PANEL_ROTATION 0
+#endif
+TFT_eSPI panel = TFT_eSPI(TFT_WIDTH, TFT_HEIGHT);
+#endif
+
+// what the frame's overlay (and anything else drawn directly) goes to: the panel, or the Display's
+// current buffer
+TFT_eSPI *displaySurface()
+{
+#if DIRECT_PANEL
+  return &panel;
+#else
+  return display.currentRenderTarget();
+#endif
+}
+
+void displayMessage(const char *message)
+{
+#if DIRECT_PANEL
+  panel.fillScreen(TFT_BLACK);
+  panel.setTextColor(TFT_WHITE);
+  panel.setCursor(0, 0);
+  panel.print(message);
+#else
+  display.fullScreenMessage(message);
+#endif
+}
+
+// (the panel holds the bus only while a call is writing to it, so there's nothing to yield)
+void yieldDisplaySPI()
+{
+#if !DIRECT_PANEL
+  display.yieldSPI();
+#endif
+}
+
+void claimDisplaySPI()
+{
+#if !DIRECT_PANEL
+  display.claimSPI();
+#endif
+}
+
+size_t displayBufferBytes()
+{
+#if DIRECT_PANEL
+  return 0;
+#else
+  // (it double-buffers: two full-frame RGB565 sprites)
+  TFT_eSPI *surface = display.currentRenderTarget();
+  return 2 * (size_t)surface->width() * surface->height() * sizeof(uint16_t);
+#endif
+}
+
+#if MORPH_DEMO
+FaceMeshDeformer meshDeformer;
+FaceMeshMorpher meshMorpher;
+float morphPhase = 0.0f;
+
+void ICACHE_FLASH_ATTR setupMorphDemo()
+{
+  meshDeformer.attach(mesh1);
+  meshMorpher.attach(meshDeformer);
+
+  constexpr float kBreathScale = 1.15f;
+  positionBuffer_t target(mesh1.positions());
+  for (auto &v : target)
+  {
+    v *= kBreathScale;
+  }
+  meshMorpher.addTargetFromPositions(target);
+}
+
+void updateMorphDemo(float dt)
+{
+  constexpr float kBreathsPerSecond = 0.5f;
+  morphPhase += dt * kBreathsPerSecond * c_f2pi;
+  if (morphPhase > c_f2pi)
+  {
+    morphPhase -= c_f2pi;
+  }
+  meshMorpher.setWeight(0, 0.5f - 0.5f * cosf(morphPhase));
+  meshMorpher.apply();
+
+  // keep the culling bounds around the animated shape
+  vector3 center, extent;
+  vector3::add(center, meshDeformer.boundsMin(), meshDeformer.boundsMax());
+  center *= 0.5f;
+  vector3::sub(extent, meshDeformer.boundsMax(), meshDeformer.boundsMin());
+  mesh1Bounds.set(center, 0.5f * extent.abs());
+}
+#endif
+
+RenderMode renderMode = kRenderWireframe;
+uint depthTileSize = 32;
+
+void setRenderMode(RenderMode mode)
+{
+  renderMode = mode;
+}
+
+RenderMode getRenderMode()
+{
+  return renderMode;
+}
+
+void setDepthTileSize(uint size)
+{
+  depthTileSize = size;
+}
+
+uint getDepthTileSize()
+{
+  return depthTileSize;
+}
+
+// homogeneous screen-space point (from mtxVtoS) to screen space: (x/w, y/w, 1/w)
+inline void projectToScreen(vector3 &vOut, const vector4 &vClip)
+{
+  float invw = stevesch::recipf(vClip.w);
+  vOut.x = vClip.x * invw;
+  vOut.y = vClip.y * invw;
+  vOut.z = invw;
+}
+
+// edges are collected and handed to the render target in batches
+constexpr uint kLineBatchSize = 256;
+ScreenLine lineBatch[kLineBatchSize];
+uint lineBatchCount = 0;
+
+inline void flushLines(RenderTarget *renderTarget)
+{
+  if (lineBatchCount > 0)
+  {
+    renderTarget->drawLines(lineBatch, lineBatchCount);
+    lineBatchCount = 0;
+  }
+}
+
+inline void queueLine(RenderTarget *renderTarget, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color)
+{
+  if (lineBatchCount == kLineBatchSize)
+  {
+    flushLines(renderTarget);
+  }
+  lineBatch[lineBatchCount++] = ScreenLine{x1, y1, x2, y2, color};
+}
+
+// number of pixels drawLine will touch between two screen-space points
+inline uint linePixels(int16_t x1, int16_t y1, int16_t x2, int16_t y2)
+{
+  return std::max(abs(x2 - x1), abs(y2 - y1)) + 1;
+}
+
+// clips the edge (a, b) in homogeneous screen space, then draws whatever remains
+void drawClippedEdge(RenderTarget *renderTarget, const vector3 &sa, const vector3 &sb, uint codeA, uint codeB,
+                     const vector4 &a, const vector4 &b, uint16_t color)
 {
-  vector4 dst;
-  vector4::transform(dst, mtxLToC, vLocal);
-  float invw = stevesch::recipf(dst.w);
-  dst.x *= invw;
-  dst.y *= invw;
-  dst.z *= invw;
-  dst.w = 1.0f;
+  if (!(codeA & kClipNear) && !(codeB & kClipNear))
+  {
+    // (without clipping, this edge would have been drawn at full length)
+    frameStats.pixelsSubmitted += linePixels((int16_t)sa.x, (int16_t)sa.y, (int16_t)sb.x, (int16_t)sb.y);
+  }
 
-  // Serial.printf("ptC: <%5.2f, %5.2f, %5.2f, %5.2F>\n", dst.x, dst.y, dst.z, dst.w);
+  vector4 ca(a);
+  vector4 cb(b);
+  if (!clipLine(ca, cb, codeA, codeB, clipRegion))
+  {
+    return;
+  }
 
-  vector4::transform(dst, mtxNDCtoS, dst);
-  vOut.x = dst.x;
-  vOut.y = dst.y;
-  vOut.z = dst.z;
-  // Serial.printf("ptS: <%5.2f, %5.2f, %5.2f, %5.2F>\n", dst.x, dst.y, dst.z);
+  vector3 s1, s2;
+  projectToScreen(s1, ca);
+  projectToScreen(s2, cb);
+  int16_t x1 = (int16_t)s1.x;
+  int16_t y1 = (int16_t)s1.y;
+  int16_t x2 = (int16_t)s2.x;
+  int16_t y2 = (int16_t)s2.y;
+  const uint pixels = linePixels(x1, y1, x2, y2);
+  if ((codeA | codeB) & kClipNear)
+  {
+    frameStats.pixelsSubmitted += pixels; // couldn't be drawn unclipped
+  }
+  frameStats.pixelsDrawn += pixels;
+  queueLine(renderTarget, x1, y1, x2, y2, color);
 }
 
-void drawFaceMesh(TFT_eSPI *renderTarget, const FaceMesh &mesh, const matrix4 &mtxLtoW, uint16_t color)
+// draws the edges of a face whose vertices have already been transformed to clip space (vertClip)
+// and screen space (vertDst).
+// bClip: clip edges to the near plane and screen using vertOutcode (not needed if the instance is
+// inside the frustum)
+inline void drawProjectedFace(RenderTarget *renderTarget, uint vertCount, uint16_t color, bool bClip)
 {
-  //matrix4 mtxLtoS;	// mtxLtoW * mtxWtoS	(== mtxLtoW * mtxWtoV * mtxVtoS)
-  matrix4 mtxLtoV;
-  matrix4 mtxLtoC;
-  vector4 faceNormal;
+#if !USE_FACE_NORMALS
+  // works for convex polys, but we're trying non-convex faces:
+  float cw;
+  {
+    float x0 = vertDst[0].x;
+    float y0 = vertDst[0].y;
+    float x1 = vertDst[1].x;
+    float y1 = vertDst[1].y;
+    float x2 = vertDst[2].x;
+    float y2 = vertDst[2].y;
+    x1 -= x0;
+    y1 -= y0;
+    x2 -= x0;
+    y2 -= y0;
+    cw = x1 * y2 - x2 * y1;
+  }
+  if (cw <= 0.0f)
+  {
+    return;
+  }
+#endif
 
-  //matrix4::mul(mtxLtoS, mtxWtoS, mtxLtoW);
-  matrix4::mul(mtxLtoV, mtxWtoV, mtxLtoW);
-  matrix4::mul(mtxLtoC, mtxVtoC, mtxLtoV);
+  int j = vertCount - 1;
+  for (uint k = 0; k < vertCount; ++k)
+  {
+    const vector3 &v1 = vertDst[j];
+    const vector3 &v2 = vertDst[k];
+    if (!bClip || ((vertOutcode[j] | vertOutcode[k]) == 0))
+    {
+      int16_t x1 = (int16_t)v1.x;
+      int16_t y1 = (int16_t)v1.y;
+      int16_t x2 = (int16_t)v2.x;
+      int16_t y2 = (int16_t)v2.y;
+      const uint pixels = linePixels(x1, y1, x2, y2);
+      frameStats.pixelsSubmitted += pixels;
+      frameStats.pixelsDrawn += pixels;
+      queueLine(renderTarget, x1, y1, x2, y2, color);
+    }
+    else
+    {
+      drawClippedEdge(renderTarget, v1, v2, vertOutcode[j], vertOutcode[k], vertClip[j], vertClip[k], color);
+    }
 
-  const stevesch::positionBuffer_t positions = mesh.positions();
-  //const normalBuffer_t normals = mesh.normals();
-  const stevesch::faceBuffer_t &faces = mesh.faces();
-  const stevesch::indexBuffer_t &posIndices = mesh.getPositionIndices();
+    j = k;
+  }
+}
 
-  const int faceCount = faces.size();
-  for (int iface = 0; iface < faceCount; ++iface)
+#if MESH_FIXED_POINT
+// draws the edges of a face projected by the fixed-point pipeline (in vertFixed); no clipping
+inline void drawProjectedFaceFixed(RenderTarget *renderTarget, uint vertCount, uint16_t color)
+{
+#if !USE_FACE_NORMALS
   {
-    const stevesch::IndexedFace &face = faces[iface];
+    const int64_t x1 = vertFixed[1].x - vertFixed[0].x;
+    const int64_t y1 = vertFixed[1].y - vertFixed[0].y;
+    const int64_t x2 = vertFixed[2].x - vertFixed[0].x;
+    const int64_t y2 = vertFixed[2].y - vertFixed[0].y;
+    if ((x1 * y2 - x2 * y1) <= 0)
+    {
+      return;
+    }
+  }
+#endif
+
+  int j = vertCount - 1;
+  for (uint k = 0; k < vertCount; ++k)
+  {
+    int16_t x1 = subpixelToPixel(vertFixed[j].x);
+    int16_t y1 = subpixelToPixel(vertFixed[j].y);
+    int16_t x2 = subpixelToPixel(vertFixed[k].x);
+    int16_t y2 = subpixelToPixel(vertFixed[k].y);
+    const uint pixels = linePixels(x1, y1, x2, y2);
+    frameStats.pixelsSubmitted += pixels;
+    frameStats.pixelsDrawn += pixels;
+    queueLine(renderTarget, x1, y1, x2, y2, color);
+
+    j = k;
+  }
+}
+#endif
 
 #if USE_FACE_NORMALS
-    faceNormal.set(mesh.getNormal(face.iNormal));
-    //Serial.printf("Face normal[%d] (%5.2f, %5.2f, %5.2f)\n", iface, faceNormal.x, faceNormal.y, faceNormal.z);
-    //renderTarget->setCursor(0, 0);
-    //renderTarget->printf("x:%5.2f\ny:%5.2f\nz:%5.2f\n", faceNormal.x, faceNormal.y, faceNormal.z);
-    vector4 v0;
-    //v0.Set(positions[face.iPosition[0]]);
-    uint index0 = face.iFirst;
-    v0.set(positions[posIndices[index0]]);
-
-    v0.transform(mtxLtoV);
-    vector4::transformSub(faceNormal, mtxLtoV, faceNormal);
-    if (faceNormal.dot3(v0) < 0.0f)
-#endif
-    {
-      vector4 src, dst;
-      //uint vertCount = face.iPosition.size();
-      uint vertCount = face.iCount;
-      if (vertDst.size() < vertCount)
+// Filled modes: front faces are collected (subpixel screen points, shade and depth) during the
+// draw call, then at its end either sorted back to front and scan-converted (painter's
+// algorithm, flat mode) or triangulated and depth-tested in screen tiles (depth mode).
+// (Depth is resolved within one draw call; separate calls still draw over each other.)
+constexpr float kAmbient = 0.25f;
+const vector3 vLightV(-0.4f, 0.6f, 0.69282f); // unit direction toward the light, in view space
+
+struct FillFace
+{
+  uint first;     // into fillPoints
+  uint count;
+  float depth;    // w (view distance) of the face's centroid
+  uint16_t color; // shaded
+};
+std::vector<fixedPoint2> fillPoints;
+std::vector<uint16_t> fillPointDepth; // per fillPoints entry, for depth mode
+std::vector<FillFace> fillFaces;
+std::vector<vector4> fillClip;         // scratch for faces clipped to the near plane
+std::vector<DepthVertex> fillVerts;    // scratch for one face in depth mode
+PolygonFiller polygonFiller;
+TileRasterizer tileRasterizer;
+
+// shaded color of each unique normal for one instance (vLightLocal: unit light direction in its
+// local space; the light is taken to local space by the inverse model-view, so n . l matches the
+// inverse-transpose normal in view space)
+void computeNormalShades(uint16_t *shades, const FaceMesh &mesh, const vector3 &vLightLocal, uint16_t color)
+{
+  const uint nc = mesh.normalCount();
+  for (uint i = 0; i < nc; ++i)
+  {
+    const float diffuse = stevesch::maxf(0.0f, mesh.getNormal(i).dot(vLightLocal));
+    shades[i] = shadeColor565(color, kAmbient + (1.0f - kAmbient) * diffuse);
+  }
+}
+
+inline fixedPoint2 toSubpixel(float x, float y)
+{
+  return fixedPoint2{(int32_t)floorf(x * kSubpixelOne + 0.5f), (int32_t)floorf(y * kSubpixelOne + 0.5f)};
+}
+
+// 16-bit depth from 1/w: the near plane maps to 0xffff and depth falls off as 1/w, which is
+// linear across the screen (so it can be interpolated there), with most precision up close
+inline uint16_t depthFromInvW(float invw)
+{
+  const float d = stevesch::minf(kZNear * invw, 1.0f) * 65535.0f;
+  return (uint16_t)stevesch::maxf(d, 1.0f);
+}
+
+// collects a face projected by the float pipeline (vertDst; with bClip, also vertClip and
+// vertOutcode).  The filler clips spans to the target, so only the near plane is clipped here.
+void queueFillFace(uint vertCount, uint16_t color, float depth, bool bClip)
+{
+  const uint first = fillPoints.size();
+  uint codes = 0;
+  for (uint j = 0; bClip && (j < vertCount); ++j)
+  {
+    codes |= vertOutcode[j];
+  }
+
+  if (codes & kClipNear)
+  {
+    if (fillClip.size() < (2 * vertCount))
+    {
+      fillClip.resize(2 * vertCount);
+    }
+    const uint clippedCount = clipPolygonNear(&fillClip[0], &vertClip[0], vertCount);
+    for (uint j = 0; j < clippedCount; ++j)
+    {
+      vector3 s;
+      projectToScreen(s, fillClip[j]);
+      fillPoints.push_back(toSubpixel(s.x, s.y));
+      fillPointDepth.push_back(depthFromInvW(s.z));
+    }
+  }
+  else
+  {
+    for (uint j = 0; j < vertCount; ++j)
+    {
+      fillPoints.push_back(toSubpixel(vertDst[j].x, vertDst[j].y));
+      fillPointDepth.push_back(depthFromInvW(vertDst[j].z));
+    }
+  }
+
+  const uint count = fillPoints.size() - first;
+  if (count < 3)
+  {
+    fillPoints.resize(first); // entirely behind the near plane
+    fillPointDepth.resize(first);
+    return;
+  }
+  fillFaces.push_back(FillFace{first, count, depth, color});
+}
+
+#if MESH_FIXED_POINT
+// collects a face projected by the fixed-point pipeline (vertFixed; never clipped).  The
+// fixed path doesn't produce 1/w, so per-vertex depth comes from mtxLtoS's w row.
+void queueFillFaceFixed(uint vertCount, uint16_t color, float depth, const matrix4 &mtxLtoS)
+{
+  fillFaces.push_back(FillFace{(uint)fillPoints.size(), vertCount, depth, color});
+  fillPoints.insert(fillPoints.end(), vertFixed.begin(), vertFixed.begin() + vertCount);
+  for (uint j = 0; j < vertCount; ++j)
+  {
+    const vector3 &v = vertSrc[j];
+    const float w = mtxLtoS.m30 * v.x + mtxLtoS.m31 * v.y + mtxLtoS.m32 * v.z + mtxLtoS.m33;
+    fillPointDepth.push_back(depthFromInvW(stevesch::recipf(w)));
+  }
+}
+#endif
+
+// fills the collected faces: farthest first, or depth-tested in tiles
+void flushFillFaces(RenderTarget *renderTarget)
+{
+  if (renderMode == kRenderDepth)
+  {
+    tileRasterizer.begin(renderTarget->width(), renderTarget->height(), depthTileSize);
+    for (const FillFace &f : fillFaces)
+    {
+      if (fillVerts.size() < f.count)
       {
-        vertDst.resize(vertCount);
+        fillVerts.resize(f.count);
       }
-
-      int j;
-      for (j = 0; j < vertCount; ++j)
+      for (uint j = 0; j < f.count; ++j)
+      {
+        const fixedPoint2 &p = fillPoints[f.first + j];
+        fillVerts[j] = DepthVertex{p.x, p.y, fillPointDepth[f.first + j]};
+      }
+      frameStats.trianglesBinned += tileRasterizer.addPolygon(&fillVerts[0], f.count, f.color);
+    }
+    frameStats.pixelsFilled += tileRasterizer.flush(*renderTarget);
+  }
+  else
+  {
+    std::sort(fillFaces.begin(), fillFaces.end(),
+              [](const FillFace &a, const FillFace &b) { return a.depth > b.depth; });
+    for (const FillFace &f : fillFaces)
+    {
+      if (!renderTarget->fillPolygon(&fillPoints[f.first], f.count, f.color))
       {
-        //uint posIndex = face.iPosition[j];
-        uint posIndex = posIndices[index0 + j];
-        src.set(positions[posIndex]);
-        perspectiveTransform(vertDst[j], src, mtxLtoC);
+        frameStats.pixelsFilled += polygonFiller.fill(*renderTarget, &fillPoints[f.first], f.count, f.color);
       }
+    }
+  }
+  frameStats.facesFilled += fillFaces.size();
+  fillFaces.clear();
+  fillPoints.clear();
+  fillPointDepth.clear();
+}
+#endif
 
-#if !USE_FACE_NORMALS
-      // works for convex polys, but we're trying non-convex faces:
-      float cw;
+// draws one face for instances [first, last), using the matrices composed by drawFaceRangesInstanced
+// (and, with face normals, the facing classification of each instance's unique normals).
+// bFlat: queue the face for filling with its per-normal shade instead of drawing its edges
+inline void drawFaceInstances(RenderTarget *renderTarget, const FaceMesh &mesh, uint iface,
+                              uint first, uint last, bool bPerNormal, bool bClip, bool bFlat)
+{
+  const stevesch::IndexedFace &face = mesh.getFace(iface);
+  const uint vertCount = face.iCount;
+  bool bLoaded = false;
+  vector3 vCentroid(0.0f, 0.0f, 0.0f); // (for depth sorting, in flat mode)
+
+  for (uint inst = first; inst < last; ++inst)
+  {
+#if USE_FACE_NORMALS
+    const bool bFacing = bPerNormal ? FaceMesh::facesEye(face, &normalDots[(inst - first) * mesh.normalCount()])
+                                    : mesh.facesEye(face, instEye[inst]);
+    if (!bFacing)
+    {
+      continue; // back-facing
+    }
+#endif
+
+    if (!bLoaded)
+    {
+      // fetch the face's positions once, for all instances that see it
+      if (vertSrc.size() < vertCount)
       {
-        float x0 = vertDst[0].x;
-        float y0 = vertDst[0].y;
-        float x1 = vertDst[1].x;
-        float y1 = vertDst[1].y;
-        float x2 = vertDst[2].x;
-        float y2 = vertDst[2].y;
-        x1 -= x0;
-        y1 -= y0;
-        x2 -= x0;
-        y2 -= y0;
-        cw = x1 * y2 - x2 * y1;
+        vertSrc.resize(vertCount);
       }
-      if (cw > 0.0f)
+      if (vertDst.size() < vertCount)
+      {
+        vertDst.resize(vertCount);
+        vertClip.resize(vertCount);
+        vertOutcode.resize(vertCount);
+#if MESH_FIXED_POINT
+        vertSrcFixed.resize(vertCount);
+        vertFixed.resize(vertCount);
 #endif
+      }
+      const stevesch::positionBuffer_t &positions = mesh.positions();
+      const stevesch::indexBuffer_t &posIndices = mesh.getPositionIndices();
+      const uint index0 = face.iFirst;
+      for (uint j = 0; j < vertCount; ++j)
       {
-        j = vertCount - 1;
-        for (int k = 0; k < vertCount; ++k)
+        vertSrc[j] = positions[posIndices[index0 + j]];
+      }
+      if (bFlat)
+      {
+        for (uint j = 0; j < vertCount; ++j)
         {
-          const vector3 &v1 = vertDst[j];
-          const vector3 &v2 = vertDst[k];
-          if ((v1.z >= 0.0f) && (v2.z >= 0.0f))
-          {
-            int16_t x1 = (int16_t)v1.x;
-            int16_t y1 = (int16_t)v1.y;
-            int16_t x2 = (int16_t)v2.x;
-            int16_t y2 = (int16_t)v2.y;
-            renderTarget->drawLine(x1, y1, x2, y2, color);
-          }
-
-          j = k;
+          vCentroid += vertSrc[j];
         }
+        vCentroid *= 1.0f / (float)vertCount;
+      }
+#if MESH_FIXED_POINT
+      if (!bClip)
+      {
+        toFixed(&vertSrcFixed[0], &vertSrc[0], vertCount);
+      }
+#endif
+      bLoaded = true;
+    }
+
+    const matrix4 &mtxLtoS = instLtoS[inst];
+#if USE_FACE_NORMALS
+    uint16_t fillColor = 0;
+    float fillDepth = 0.0f;
+    if (bFlat)
+    {
+      fillColor = normalShade[(inst - first) * mesh.normalCount() + face.iNormal];
+      fillDepth = mtxLtoS.m30 * vCentroid.x + mtxLtoS.m31 * vCentroid.y + mtxLtoS.m32 * vCentroid.z + mtxLtoS.m33;
+    }
+#endif
+    bool bClipFace = bClip;
+    if (bClip)
+    {
+      // keep the homogeneous positions and outcodes for clipping
+      ClipCodes codes = projectVertices(&vertDst[0], &vertClip[0], &vertOutcode[0], &vertSrc[0], vertCount,
+                                        mtxLtoS, clipRegion);
+      if (codes.all != 0)
+      {
+        continue; // entirely outside one plane
+      }
+      bClipFace = (codes.any != 0);
+    }
+    else
+    {
+#if MESH_FIXED_POINT
+      projectPointsFixed(&vertFixed[0], &vertSrcFixed[0], vertCount, instLtoSFixed[inst]);
+#if USE_FACE_NORMALS
+      if (bFlat)
+      {
+        queueFillFaceFixed(vertCount, fillColor, fillDepth, mtxLtoS);
+        continue;
       }
+#endif
+      drawProjectedFaceFixed(renderTarget, vertCount, instColor[inst]);
+      continue;
+#else
+      projectPoints(&vertDst[0], &vertSrc[0], vertCount, mtxLtoS);
+#endif
+    }
+
+#if USE_FACE_NORMALS
+    if (bFlat)
+    {
+      queueFillFace(vertCount, fillColor, fillDepth, bClipFace);
+      continue;
+    }
+#endif
+    drawProjectedFace(renderTarget, vertCount, instColor[inst], bClipFace);
+  }
+}
+
+// draws the (already composed) instances [begin, end) in chunks: each face's data is fetched
+// once per chunk and reused for every instance in it, while the chunk's matrices stay small
+// enough to remain in cache.
+void drawInstanceRun(RenderTarget *renderTarget, const FaceMesh &mesh, const FaceRange *ranges, uint rangeCount,
+                     uint begin, uint end, uint chunkSize, bool bPerNormal, bool bClip, bool bFlat)
+{
+  for (uint first = begin; first < end; first += chunkSize)
+  {
+    const uint last = std::min(first + chunkSize, end);
+
+#if USE_FACE_NORMALS
+    // classify each unique normal once per instance; faces then only compare against their plane
+    const uint nc = mesh.normalCount();
+    for (uint inst = first; bPerNormal && (inst < last); ++inst)
+    {
+      mesh.computeNormalDots(&normalDots[(inst - first) * nc], instEye[inst]);
+    }
+    // (and, when filling, shade each unique normal once per instance)
+    for (uint inst = first; bFlat && (inst < last); ++inst)
+    {
+      computeNormalShades(&normalShade[(inst - first) * nc], mesh, instLight[inst], instColor[inst]);
+    }
+#endif
+
+    for (uint r = 0; r < rangeCount; ++r)
+    {
+      const uint faceEnd = ranges[r].first + ranges[r].count;
+      for (uint iface = ranges[r].first; iface < faceEnd; ++iface)
+      {
+        drawFaceInstances(renderTarget, mesh, iface, first, last, bPerNormal, bClip, bFlat);
+      }
+    }
+  }
+}
+
+// world-space bounding sphere of an instance, from its local bounds
+inline Sphere instanceBounds(const Sphere &localBounds, const matrix4 &mtxLtoW)
+{
+  vector4 center;
+  localBounds.getCenter(center);
+  center.w = 1.0f;
+  center.transform(mtxLtoW);
+
+  // (conservative under non-uniform scale)
+  float scale2 = stevesch::maxf(mtxLtoW.col[0].squareMag(),
+                                stevesch::maxf(mtxLtoW.col[1].squareMag(), mtxLtoW.col[2].squareMag()));
+  return Sphere(vector3(center.x, center.y, center.z), localBounds.getRadius() * sqrtf(scale2));
+}
+
+bool instanceScreenRect(ScreenRect &rect, const Sphere &localBounds, const matrix4 &mtxLtoW)
+{
+  const Sphere bounds = instanceBounds(localBounds, mtxLtoW);
+  vector4 vCenterV(bounds.getCenter());
+  vCenterV.w = 1.0f;
+  vCenterV.transform(mtxWtoV);
+  return sphereScreenRect(rect, vector3(vCenterV.x, vCenterV.y, vCenterV.z), bounds.getRadius(), mtxVtoS);
+}
+
+int instanceLod(const Sphere &localBounds, const matrix4 &mtxLtoW, const QualitySettings &quality, uint lodCount)
+{
+  constexpr float kLodRadius = 24.0f; // (pixels) smaller instances take the next level, and again at half that
+  uint level = 0;
+  ScreenRect rect;
+  if (instanceScreenRect(rect, localBounds, mtxLtoW)) // (else it reaches the eye: full detail)
+  {
+    const float radius = 0.5f * (float)std::max(rect.x1 - rect.x0, rect.y1 - rect.y0);
+    if (radius < quality.minScreenRadius)
+    {
+      return -1;
+    }
+    for (float r = kLodRadius; (radius < r) && ((level + 1) < lodCount); r *= 0.5f)
+    {
+      ++level;
+    }
+  }
+  return (int)std::min(level + quality.lodBias, std::max(lodCount, 1u) - 1);
+}
+
+bool addInstanceByLod(std::vector<matrix4> *groupLtoW, std::vector<uint16_t> *groupColors, uint lodCount,
+                      const Sphere &localBounds, const matrix4 &mtxLtoW, uint16_t color, const QualitySettings &quality)
+{
+  const int level = instanceLod(localBounds, mtxLtoW, quality, lodCount);
+  if (level < 0)
+  {
+    return false;
+  }
+  groupLtoW[level].push_back(mtxLtoW);
+  groupColors[level].push_back(color);
+  return true;
+}
+
+void drawFaceRangesInstanced(RenderTarget *renderTarget, const FaceMesh &mesh, const FaceRange *ranges, uint rangeCount,
+                             const matrix4 *mtxLtoW, uint count, const uint16_t *colors, const Sphere *localBounds)
+{
+  if ((count == 0) || (rangeCount == 0))
+  {
+    return;
+  }
+
+  // classify instances against the frustum: outside ones are dropped, fully-inside ones are
+  // drawn without clipping checks, and only the rest take the clipping path
+  if (instClass.size() < count)
+  {
+    instClass.resize(count);
+  }
+  uint insideCount = 0;
+  uint clipCount = 0;
+  for (uint inst = 0; inst < count; ++inst)
+  {
+    SINTERSECTION c = localBounds ? frustum.intersection(instanceBounds(*localBounds, mtxLtoW[inst])) : SINTERSECT_IN;
+    instClass[inst] = (int8_t)c;
+    insideCount += (c == SINTERSECT_DONE) ? 1 : 0;
+    clipCount += (c == SINTERSECT_IN) ? 1 : 0;
+  }
+  frameStats.instancesOut += count - insideCount - clipCount;
+  frameStats.instancesInside += insideCount;
+  frameStats.instancesClipped += clipCount;
+
+  const uint visibleCount = insideCount + clipCount;
+  if (visibleCount == 0)
+  {
+    return;
+  }
+
+  // compose matrices of visible instances up front: fully-inside first, then clipped
+  if (instLtoS.size() < visibleCount)
+  {
+    instLtoV.resize(visibleCount);
+    instLtoS.resize(visibleCount);
+#if MESH_FIXED_POINT
+    instLtoSFixed.resize(visibleCount);
+#endif
+    instColor.resize(visibleCount);
+  }
+  const affine4x3 affWtoV(mtxWtoV);
+  uint nextInside = 0;
+  uint nextClip = insideCount;
+  for (uint inst = 0; inst < count; ++inst)
+  {
+    if (instClass[inst] == SINTERSECT_OUT)
+    {
+      continue;
+    }
+    uint slot = (instClass[inst] == SINTERSECT_DONE) ? nextInside++ : nextClip++;
+    affine4x3::mul(instLtoV[slot], affWtoV, affine4x3(mtxLtoW[inst]));
+    affine4x3::mul(instLtoS[slot], mtxVtoS, instLtoV[slot]);
+#if MESH_FIXED_POINT
+    if (slot < insideCount)
+    {
+      instLtoSFixed[slot].set(instLtoS[slot]);
+    }
+#endif
+    instColor[slot] = colors ? colors[inst] : TFT_GREEN;
+  }
+
+  uint chunkSize = 16;
+  bool bPerNormal = false;
+  bool bFlat = false;
+
+#if USE_FACE_NORMALS
+  bFlat = (renderMode == kRenderFlat) || (renderMode == kRenderDepth);
+
+  // the eye (the view-space origin), and the light when filling, in each instance's local space
+  if (instEye.size() < visibleCount)
+  {
+    instEye.resize(visibleCount);
+  }
+  if (bFlat && (instLight.size() < visibleCount))
+  {
+    instLight.resize(visibleCount);
+  }
+  for (uint inst = 0; inst < visibleCount; ++inst)
+  {
+    affine4x3 mtxVtoL;
+    mtxVtoL.identity();
+    affine4x3::invert(mtxVtoL, instLtoV[inst]);
+    mtxVtoL.getTranslation(instEye[inst]);
+    if (bFlat)
+    {
+      mtxVtoL.transformVector(instLight[inst], vLightV);
+      instLight[inst].normalize();
+    }
+  }
+
+  // Classifying unique normals pays off when faces share them (faceted models); otherwise
+  // each face is tested directly against the local eye (one dot product per face).
+  const uint nc = std::max(mesh.normalCount(), 1u);
+  bPerNormal = (2 * nc) <= mesh.faceCount();
+  if (bPerNormal || bFlat)
+  {
+    // keep the per-chunk normal classification (and shades) small, even for meshes with many
+    // unique normals
+    constexpr uint kMaxNormalDots = 2048;
+    chunkSize = std::max(1u, std::min(chunkSize, kMaxNormalDots / nc));
+    if (bPerNormal && (normalDots.size() < (chunkSize * nc)))
+    {
+      normalDots.resize(chunkSize * nc);
+    }
+    if (bFlat && (normalShade.size() < (chunkSize * nc)))
+    {
+      normalShade.resize(chunkSize * nc);
+    }
+  }
+#endif
+
+  drawInstanceRun(renderTarget, mesh, ranges, rangeCount, 0, insideCount, chunkSize, bPerNormal, false, bFlat);
+  drawInstanceRun(renderTarget, mesh, ranges, rangeCount, insideCount, visibleCount, chunkSize, bPerNormal, true, bFlat);
+  flushLines(renderTarget);
+#if USE_FACE_NORMALS
+  if (bFlat)
+  {
+    flushFillFaces(renderTarget);
+  }
+#endif
+}
+
+void drawFaceMeshInstanced(RenderTarget *renderTarget, const FaceMesh &mesh, const matrix4 *mtxLtoW, uint count,
+                           const uint16_t *colors, const Sphere *localBounds)
+{
+  const FaceRange all = {0, mesh.faceCount()};
+  drawFaceRangesInstanced(renderTarget, mesh, &all, 1, mtxLtoW, count, colors, localBounds);
+}
+
+void drawFaceMeshBatch(RenderTarget *renderTarget, const FaceMeshBatch &batch, uint16_t color)
+{
+  // batched positions are already in world space; parts are culled individually, and the
+  // batch as a whole takes the clip-free path if it is entirely inside the frustum
+  static const matrix4 mtxIdentity(1.0f);
+  vector3 center, extent;
+  vector3::add(center, batch.boundsMin(), batch.boundsMax());
+  center *= 0.5f;
+  vector3::sub(extent, batch.boundsMax(), batch.boundsMin());
+  const Sphere bounds(center, 0.5f * extent.abs());
+
+  batch.gatherFaceRanges(batchRanges, &frustum);
+  drawFaceRangesInstanced(renderTarget, batch.mesh(), batchRanges.data(), batchRanges.size(), &mtxIdentity, 1, &color, &bounds);
+}
+
+void drawFaceMesh(RenderTarget *renderTarget, const FaceMesh &mesh, const matrix4 &mtxLtoW, uint16_t color)
+{
+  drawFaceMeshInstanced(renderTarget, mesh, &mtxLtoW, 1, &color, nullptr);
+}
+
+#if QUALITY_GOVERNOR
+// sorts the instances the governor's settings allow into levels of detail (less skipped ones)
+void cullGovernedScene()
+{
+  const QualitySettings &quality = qualityGovernor.settings();
+  const uint lodCount = std::max(1u, std::min(mesh1Lod.levelCount(), kLodLevels));
+  for (uint level = 0; level < kLodLevels; ++level)
+  {
+    lodLtoW[level].clear();
+    lodColors[level].clear();
+  }
+  governedSkipped = 0;
+
+  const uint count = std::min((uint)activeInstCount, quality.instanceLimit);
+  for (uint index = 0; index < count; ++index)
+  {
+    const auto &obj = instances[index];
+    matrix4 mtxLtoW;
+    obj.calcLtoW(mtxLtoW);
+    if (!addInstanceByLod(lodLtoW, lodColors, lodCount, mesh1Bounds, mtxLtoW, obj.color, quality))
+    {
+      ++governedSkipped;
+    }
+  }
+}
+
+void drawGovernedScene(RenderTarget *renderTarget)
+{
+  for (uint level = 0; level < kLodLevels; ++level)
+  {
+    if (!lodLtoW[level].empty())
+    {
+      drawFaceMeshInstanced(renderTarget, mesh1Lod.level(level), lodLtoW[level].data(), lodLtoW[level].size(),
+                            lodColors[level].data(), &mesh1Bounds);
     }
   }
 }
 
-void drawScene(TFT_eSPI *renderTarget)
+// prints each quality change, with the phase times behind it
+void reportQualityChange()
 {
-  matrix4 mtxLtoW;
+  const GovernorStats &stats = qualityGovernor.stats();
+  const QualitySettings &quality = qualityGovernor.settings();
+  Serial.printf("quality %s to %u/%u (frame %u us, budget %u):", (stats.lastDecision == kDecisionDegrade) ? "down" : "up",
+                stats.level, stats.levelCount - 1, stats.averageMicros, qualityGovernor.budgetMicros());
+  for (uint i = 0; i < kPhaseCount; ++i)
+  {
+    Serial.printf(" %s %u", phaseName((GovernorPhase)i), stats.phaseAverageMicros[i]);
+  }
+  Serial.printf("\n  lod+%u skip<%.0fpx instances<=%u simulation 1/%u\n", quality.lodBias, quality.minScreenRadius,
+                quality.instanceLimit, quality.simulationInterval);
+}
+#endif
+
+#if DIRTY_RECTS
+// collects this frame's instance rectangles (and the stats overlay) into dirtyRects
+void updateDirtyRects(TFT_eSPI *renderTarget)
+{
+  dirtyRects.beginFrame();
+  if (usingPlaceholder)
+  {
+    dirtyRects.addFullScreen(); // (the placeholder message covers most of the screen)
+  }
+  for (int index = 0; index < activeInstCount; ++index)
+  {
+    matrix4 mtxLtoW;
+    instances[index].calcLtoW(mtxLtoW);
+    ScreenRect rect;
+    if (instanceScreenRect(rect, mesh1Bounds, mtxLtoW))
+    {
+      dirtyRects.add(rect);
+    }
+    else
+    {
+      dirtyRects.addFullScreen();
+    }
+  }
+  constexpr int16_t kOverlayLines = 4;
+  dirtyRects.add(ScreenRect{0, 0, (int16_t)renderTarget->width(), (int16_t)(kOverlayLines * renderTarget->fontHeight())});
+  dirtyRects.endFrame();
+}
+
+// pushes the dirty regions of the frame to the panel, a row at a time; returns the pixels sent
+uint32_t presentDirtyRects()
+{
+  const uint16_t *pixels = dirtyFrame->pixels();
+  const int16_t stride = dirtyFrame->width();
+  uint32_t sent = 0;
+  panel.startWrite();
+  const bool bSwap = panel.getSwapBytes();
+  panel.setSwapBytes(true); // (the frame is native-endian RGB565; the panel wants it byte-swapped)
+  for (const ScreenRect &r : dirtyRects.regions())
+  {
+    const int16_t w = r.x1 - r.x0;
+    panel.setWindow(r.x0, r.y0, r.x1 - 1, r.y1 - 1);
+    for (int16_t y = r.y0; y < r.y1; ++y)
+    {
+      panel.pushPixels(pixels + (int32_t)y * stride + r.x0, w);
+    }
+    sent += r.area();
+  }
+  panel.setSwapBytes(bSwap);
+  panel.endWrite();
+  return sent;
+}
+#endif
+
+void drawScene(RenderTarget *renderTarget)
+{
+  if (sceneLtoW.size() < (size_t)activeInstCount)
+  {
+    sceneLtoW.resize(activeInstCount);
+    sceneColor.resize(activeInstCount);
+  }
 
   // for (auto&& obj : instances)
   for (int index = 0; index < activeInstCount; ++index)
   {
     const auto &obj = instances[index];
-    obj.calcLtoW(mtxLtoW);
-    uint16_t color = obj.color;
-    drawFaceMesh(renderTarget, mesh1, mtxLtoW, color);
+    obj.calcLtoW(sceneLtoW[index]);
+    sceneColor[index] = obj.color;
   }
+  drawFaceMeshInstanced(renderTarget, mesh1, &sceneLtoW[0], activeInstCount, &sceneColor[0], &mesh1Bounds);
 }
 
 void ICACHE_FLASH_ATTR scanModels()
 {
-  display.yieldSPI();
+  yieldDisplaySPI();
   SPIFFS.begin();
 
   String path = "/spiffs/";
@@ -228,10 +1237,16 @@ void ICACHE_FLASH_ATTR scanModels()
     Serial.printf("Couldn't open root folder\n");
   }
   SPIFFS.end();
-  display.claimSPI();
+  claimDisplaySPI();
   yield();
 }
 
+void getViewTransforms(matrix4 &mtxWorldToView, matrix4 &mtxViewToScreen)
+{
+  mtxWorldToView = mtxWtoV;
+  mtxViewToScreen = mtxVtoS;
+}
+
 void SetScreenMatrix(int width, int height)
 {
   matrix4 m;
@@ -248,20 +1263,28 @@ void SetScreenMatrix(int width, int height)
     sFOV_Vertical = fRadiansV;
   }
 
-  Serial.printf("Frustum fovH=%5.2f fovV=%5.2f>\n", radToDeg(fRadiansH), radToDeg(fRadiansV));
+  sFOV_Horizontal = fRadiansH;
   // m.PerspectiveLH(fRadiansH, fRadiansV, kZNear, kZFar);
   m.perspectiveRH(fRadiansH, fRadiansV, kZNear, kZFar);
 
   // projection matrix (view-to-clip)
   mtxVtoC = m;
 
-  // NDC-to-screen matrix
-  m.identity();
-  m.m00 = 0.5f * width;
-  m.m11 = -0.5f * height;
-  m.m03 = 0.5f * width;
-  m.m13 = 0.5f * height;
-  mtxNDCtoS = m;
+  // view-to-screen: the NDC-to-pixels mapping folded into the projection
+  foldViewport(mtxVtoS, mtxVtoC, (float)width, (float)height);
+
+  // (clip region in pixels, since vertices are clipped in homogeneous screen space)
+  clipRegion.set(0.0f, (float)(width - 1), 0.0f, (float)(height - 1));
+  if (kGuardBand > 1.0f)
+  {
+    clipRegion.expand(kGuardBand);
+  }
+}
+
+// (kept out of SetScreenMatrix, which dynamic resolution calls whenever the scale changes)
+void printScreenMatrix()
+{
+  Serial.printf("Frustum fovH=%5.2f fovV=%5.2f>\n", radToDeg(sFOV_Horizontal), radToDeg(sFOV_Vertical));
 }
 
 const char *planeName[] = {
@@ -358,6 +1381,7 @@ void ICACHE_FLASH_ATTR scaleModelToCamera()
       Serial.printf("ideal radius clamped=%5.2f\n", idealRadius);
     }
     float scale = idealRadius / radius;
+    mesh1Bounds.set(0.0f, 0.0f, 0.0f, idealRadius);
 
     uint vc = mesh1.positionCount();
     for (uint i = 0; i < vc; ++i)
@@ -367,6 +1391,9 @@ void ICACHE_FLASH_ATTR scaleModelToCamera()
       rv *= scale;
       //rv.transform(rot);
     }
+#if USE_FACE_NORMALS
+    mesh1.computeFacePlanes();
+#endif
 
     ////////////////
 
@@ -444,6 +1471,27 @@ f 5\\0\\3 4\\0\\3 3\\0\\3 6\\0\\3\n";
 
 static int modelNum = 0;
 
+// models whose estimated import peak exceeds this many bytes are skipped (0: no limit)
+constexpr size_t kModelMemoryBudget = 0;
+
+void ICACHE_FLASH_ATTR printMeshMemory(const FaceMesh &mesh)
+{
+  MeshMemoryReport report;
+  mesh.memoryReport(report);
+  for (uint i = 0; i < report.bufferCount; ++i)
+  {
+    const BufferMemoryInfo &b = report.buffer[i];
+    Serial.printf("  %-10s %5u/%5u x %2u bytes: used %6u reserved %6u (+%u)\n",
+                  b.name, (uint)b.count, (uint)b.capacity, (uint)b.elementSize,
+                  (uint)b.bytesUsed, (uint)b.bytesReserved, (uint)b.overhead);
+  }
+
+  const MeshImportStats &stats = meshImportLastStats();
+  Serial.printf("  mesh total: used %u reserved %u (+%u overhead); import peak %u (transient %u) heap %u\n",
+                (uint)report.bytesUsed, (uint)report.bytesReserved, (uint)report.overhead,
+                (uint)stats.peakBytesReserved, (uint)stats.peakBytesTransient, stats.peakHeapUsed);
+}
+
 bool ICACHE_FLASH_ATTR loadModel(FaceMesh &meshDst, const char *path)
 {
   Serial.printf("Loading model <%s>\n", path);
@@ -451,19 +1499,68 @@ bool ICACHE_FLASH_ATTR loadModel(FaceMesh &meshDst, const char *path)
   // give up this memory for now
   vertDst.clear();
   vertDst.shrink_to_fit();
+  vertSrc.clear();
+  vertSrc.shrink_to_fit();
+  vertClip.clear();
+  vertClip.shrink_to_fit();
+  vertOutcode.clear();
+  vertOutcode.shrink_to_fit();
+#if MESH_FIXED_POINT
+  vertSrcFixed.clear();
+  vertSrcFixed.shrink_to_fit();
+  vertFixed.clear();
+  vertFixed.shrink_to_fit();
+#endif
+#if USE_FACE_NORMALS
+  fillPoints.clear();
+  fillPoints.shrink_to_fit();
+  fillPointDepth.clear();
+  fillPointDepth.shrink_to_fit();
+  fillFaces.clear();
+  fillFaces.shrink_to_fit();
+  fillClip.clear();
+  fillClip.shrink_to_fit();
+  fillVerts.clear();
+  fillVerts.shrink_to_fit();
+  polygonFiller.compactMemory();
+  tileRasterizer.compactMemory();
+#endif
 
   meshDst.clear();
   meshDst.compactMemory();
 
-  display.yieldSPI();
-  bool bImportSuccess = importObj(meshDst, path);
-  display.claimSPI();
+  bool bImportSuccess = false;
+  bool bWithinBudget = true;
+  yieldDisplaySPI();
+  if (kModelMemoryBudget > 0)
+  {
+    MeshMemoryEstimate estimate;
+    if (estimateObjMemory(estimate, path))
+    {
+      bWithinBudget = (estimate.peakBytes <= kModelMemoryBudget);
+      Serial.printf("Estimated model memory: %u bytes (peak %u, budget %u)\n",
+                    (uint)estimate.finalBytes, (uint)estimate.peakBytes, (uint)kModelMemoryBudget);
+    }
+  }
+  if (bWithinBudget)
+  {
+    bImportSuccess = importObj(meshDst, path);
+  }
+  claimDisplaySPI();
 
   constexpr size_t kExpectedMaxVertsPerFace = 64;
   vertDst.reserve(kExpectedMaxVertsPerFace);
+  vertSrc.reserve(kExpectedMaxVertsPerFace);
+  vertClip.reserve(kExpectedMaxVertsPerFace);
+  vertOutcode.reserve(kExpectedMaxVertsPerFace);
+#if MESH_FIXED_POINT
+  vertSrcFixed.reserve(kExpectedMaxVertsPerFace);
+  vertFixed.reserve(kExpectedMaxVertsPerFace);
+#endif
 
   if (bImportSuccess && meshDst.positionCount() > 0)
   {
+    printMeshMemory(meshDst);
     usingPlaceholder = false;
     return true;
   }
@@ -485,10 +1582,16 @@ bool ICACHE_FLASH_ATTR loadModel(FaceMesh &meshDst, const char *path)
 
     StreamString ss;
     ss.write((const uint8_t *)src, strlen(src) + 1);
-    display.yieldSPI();
+    yieldDisplaySPI();
     importObj(meshDst, ss);
-    display.claimSPI();
+    claimDisplaySPI();
+  }
+#if ASYNC_PRESENT
+  if (!usingPlaceholder) // (async frames carry no text overlay)
+  {
+    Serial.printf("%s\n", kPlaceholderHint);
   }
+#endif
   usingPlaceholder = true;
   return false;
 }
@@ -580,9 +1683,53 @@ void ICACHE_FLASH_ATTR nextModel()
 
   if ((currentModel != lastModel) && (currentModel < modelCount))
   {
-    display.fullScreenMessage("Loading...");
+#if ASYNC_PRESENT
+    asyncPresenter->stop(); // (the panel is ours again until restarted below)
+#endif
+    displayMessage("Loading...");
+#if DIRTY_RECTS
+    dirtyRects.invalidate();
+#endif
     loadModel(mesh1, models[currentModel].c_str());
     scaleModelToCamera();
+#if QUALITY_GOVERNOR
+    mesh1Lod.build(mesh1, MORPH_DEMO ? 1 : kLodLevels); // (coarser levels wouldn't morph)
+    qualityGovernor.setLodLevels(mesh1Lod.levelCount());
+#endif
+#if MORPH_DEMO
+    setupMorphDemo();
+#endif
+#if MESH_BENCHMARKS
+    benchmarkModel(models[currentModel].c_str(), mesh1);
+    displayTarget.setTarget(displaySurface());
+    benchmarkInstancing(&displayTarget, mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z));
+    benchmarkStaticBatch(&displayTarget, mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z));
+    benchmarkLineRaster(&displayTarget);
+    benchmarkHeadless(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    benchmarkFlatFill(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    benchmarkTileRaster(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    benchmarkStripRender(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    benchmarkDirtyRects(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    benchmarkAsyncPresent(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    benchmarkParallelRaster(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    benchmarkCommandList(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    benchmarkIndexedFrame(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    benchmarkDynamicResolution(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    benchmarkQualityGovernor(mesh1, vector3(vCameraFocus.x, vCameraFocus.y, vCameraFocus.z), displayTarget.width(), displayTarget.height());
+    displaySurface()->fillScreen(TFT_BLACK);
+#endif
+#if DYNAMIC_RESOLUTION
+    // (loading stalled a frame: restart the average, and the projection the benchmarks changed)
+    resolutionController.setScale(resolutionController.scale());
+    applyRenderScale();
+#endif
+#if QUALITY_GOVERNOR
+    qualityGovernor.setLevel(qualityGovernor.level()); // (restarts the average past the loading stall)
+#endif
+#if ASYNC_PRESENT
+    asyncPresenter->start(kPresentCore);
+    tPresentStats = micros();
+#endif
   }
   // else there must be no models
 
@@ -661,12 +1808,71 @@ void updateTransforms(float dt)
 
 void simpleRendererSetup()
 {
+#if DIRECT_PANEL
+  panel.init();
+  panel.setRotation(PANEL_ROTATION);
+  panel.fillScreen(TFT_BLACK);
+#else
   display.setup();
+#endif
 
-  TFT_eSPI *renderTarget = display.currentRenderTarget();
+  TFT_eSPI *renderTarget = displaySurface();
   int w = renderTarget->getViewportWidth();
   int h = renderTarget->getViewportHeight();
   SetScreenMatrix(w, h);
+  printScreenMatrix();
+#if DIRTY_RECTS
+  dirtyRects.setScreen(w, h);
+  dirtyRects.setBufferAge(kDirtyBufferAge);
+  dirtyFrame = new FrameBuffer565(w, h);
+#endif
+#if ASYNC_PRESENT
+  panelSink.setTarget(&panel);
+  asyncPresenter = new AsyncPresenter(w, h, &panelSink);
+#endif
+#if STRIP_RENDERING
+  bandSink.setTarget(&panel);
+  stripTarget = new StripRenderTarget(w, h, STRIP_RENDERING, &bandSink);
+  Serial.printf("Strip rendering: %u bands of %d rows (%u bytes)\n", stripTarget->bandCount(),
+                stripTarget->bandHeight(), (uint)stripTarget->bandBytes());
+#endif
+#if COMMAND_LIST
+  commandList = new CommandList(w, h);
+#endif
+#if INDEXED_FRAMEBUFFER
+  panel.initDMA();
+  stripSink.setTarget(&panel);
+  indexedTarget = new IndexedFrameBuffer(w, h, INDEXED_FRAMEBUFFER, &stripSink);
+  indexedTarget->setSwapBytes(true); // (strips go to the panel by DMA, as they are)
+  {
+    // black, then the instance colors; shades (flat mode) take the remaining entries
+    uint16_t palette[1 + stockColorCount];
+    palette[0] = TFT_BLACK;
+    std::copy(stockColors, stockColors + stockColorCount, palette + 1);
+    indexedTarget->setPalette(palette, 1 + stockColorCount);
+  }
+  Serial.printf("Indexed frame: %u bytes + %u bytes of %d-row strips\n", (uint)indexedTarget->frameBytes(),
+                (uint)indexedTarget->stripBytes(), indexedTarget->stripHeight());
+#endif
+#if DYNAMIC_RESOLUTION
+  scaledTarget = new ScaledRenderTarget(w, h, kUpscaleStripRows, &scaledSink);
+  resolutionController.setTargetFrameMicros(1000000 / DYNAMIC_RESOLUTION);
+  resolutionController.setScaleRange(kMinRenderScale, 1.0f);
+  resolutionController.setHysteresis(kResolutionHysteresis);
+  applyRenderScale();
+#endif
+#if QUALITY_GOVERNOR
+  governedList = new CommandList(w, h);
+  qualityGovernor.setBudgetMicros(1000000 / QUALITY_GOVERNOR);
+  qualityGovernor.setSkipRadius(kSkipRadius, kSkipSteps);
+  qualityGovernor.setInstanceRange(1, maxInstCount);
+  qualityGovernor.setSimulationSteps(1);
+#endif
+#if PARALLEL_RASTER
+  parallelTarget = new ParallelRenderTarget(w, h, kParallelBandRows, PARALLEL_RASTER, &frameSink);
+  Serial.printf("Parallel rasterization: %u workers, %u bands of %d rows (%u bytes)\n", parallelTarget->workerCount(),
+                parallelTarget->bandCount(), parallelTarget->bandHeight(), (uint)parallelTarget->frameBytes());
+#endif
 
   updateFrustum();
 
@@ -681,7 +1887,7 @@ void simpleRendererSetup()
   scanModels();
   if (models.size() == 0)
   {
-    display.fullScreenMessage("No models.\nOnly .obj\nsupported.");
+    displayMessage("No models.\nOnly .obj\nsupported.");
     models.push_back("dummy1");
     models.push_back("dummy2");
   }
@@ -691,17 +1897,21 @@ void simpleRendererSetup()
 
 #ifdef BUTTON_1
   // assign button 1 to advance to next model
-  button1.setClickHandler([=](Button2 &btn) {
+  button1.setClickHandler([=](Button2 &) {
     nextModel();
     restartInstances();
   });
 #endif
 #ifdef BUTTON_2
   // assign button 1 to change number of models drawn
-  button2.setClickHandler([=](Button2 &btn) {
+  button2.setClickHandler([=](Button2 &) {
     activeInstCount = (activeInstCount % maxInstCount) + 1;
     restartInstances();
   });
+  // long-press button 2 to cycle wireframe, flat-shaded (sorted) and flat-shaded (depth-tested) faces
+  button2.setLongClickHandler([=](Button2 &) {
+    setRenderMode((RenderMode)((getRenderMode() + 1) % (kRenderDepth + 1)));
+  });
 #endif
 }
 
@@ -732,6 +1942,21 @@ void drawFps(TFT_eSPI* target, float dt)
 	}
 	target->setTextColor(color);
 	target->printf("fps: %5.1f\n", fps);
+	target->printf("in:%u clip:%u out:%u\n", frameStats.instancesInside, frameStats.instancesClipped, frameStats.instancesOut);
+#if DIRTY_RECTS
+	target->printf("clr:%u tx:%u\n", frameStats.pixelsCleared, frameStats.pixelsPresented);
+#endif
+#if DYNAMIC_RESOLUTION
+	target->printf("res:%dx%d\n", scaledTarget->width(), scaledTarget->height());
+#endif
+#if QUALITY_GOVERNOR
+	target->printf("q:%u/%u skip:%u\n", qualityGovernor.level(), qualityGovernor.levelCount() - 1, governedSkipped);
+#endif
+	if (frameStats.facesFilled > 0) {
+		target->printf("faces:%u px:%u\n", frameStats.facesFilled, frameStats.pixelsFilled);
+	} else {
+		target->printf("px:%u/%u\n", frameStats.pixelsDrawn, frameStats.pixelsSubmitted);
+	}
 }
 
 
@@ -744,19 +1969,115 @@ void simpleRendererLoop(float dt)
   button2.loop();
 #endif
 
+#if QUALITY_GOVERNOR
+  qualityGovernor.beginFrame(); // (the update phase)
+  // at the lowest quality the simulation steps every few frames, over the time since it last did
+  simulationDt += dt;
+  if (++simulationFrames >= qualityGovernor.settings().simulationInterval)
+  {
+    updateTransforms(simulationDt);
+#if MORPH_DEMO
+    updateMorphDemo(simulationDt);
+#endif
+    simulationDt = 0.0f;
+    simulationFrames = 0;
+  }
+#else
   updateTransforms(dt);
+#if MORPH_DEMO
+  updateMorphDemo(dt);
+#endif
+#endif
 
-  display.clearRenderTarget();
+#if ASYNC_PRESENT
+  FrameBuffer565 &frame = asyncPresenter->beginFrame();
+  frame.clear(TFT_BLACK);
+  frameStats = FrameStats();
+  drawScene(&frame);
+  asyncPresenter->submit();
+  reportAsyncPresent();
+  return;
+#endif
 
-  TFT_eSPI *renderTarget = display.currentRenderTarget();
-  drawScene(renderTarget);
+  TFT_eSPI *renderTarget = displaySurface();
+  displayTarget.setTarget(renderTarget);
+  frameStats = FrameStats();
+#if QUALITY_GOVERNOR
+  qualityGovernor.beginPhase(kPhaseRaster); // (clearing is raster work)
+#endif
+
+#if DIRTY_RECTS
+  updateDirtyRects(renderTarget);
+  for (const ScreenRect &r : dirtyRects.regions())
+  {
+    dirtyFrame->fillRect(r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0, TFT_BLACK);
+  }
+  frameStats.pixelsCleared = dirtyRects.regionPixels();
+#else
+#if !DIRECT_PANEL
+  display.clearRenderTarget(); // (direct modes clear their own buffers)
+#endif
+  frameStats.pixelsCleared = renderTarget->width() * renderTarget->height();
+  frameStats.pixelsPresented = frameStats.pixelsCleared;
+#endif
+#if STRIP_RENDERING
+  stripTarget->clear(TFT_BLACK);
+  drawScene(stripTarget);
+  stripTarget->present();
+#elif PARALLEL_RASTER
+  frameSink.setTarget(renderTarget);
+  parallelTarget->clear(TFT_BLACK);
+  drawScene(parallelTarget);
+  parallelTarget->present();
+#elif COMMAND_LIST
+  commandList->clear(TFT_BLACK);
+  drawScene(commandList);
+  commandList->replay(displayTarget);
+#elif INDEXED_FRAMEBUFFER
+  indexedTarget->clear(TFT_BLACK);
+  drawScene(indexedTarget);
+  stripSink.begin();
+  indexedTarget->present();
+  stripSink.finish();
+#elif DYNAMIC_RESOLUTION
+  if (resolutionController.update((uint32_t)(dt * 1.0e6f)))
+  {
+    applyRenderScale();
+  }
+  scaledSink.setTarget(renderTarget);
+  scaledTarget->clear(TFT_BLACK);
+  drawScene(scaledTarget);
+  scaledTarget->present();
+#elif QUALITY_GOVERNOR
+  qualityGovernor.beginPhase(kPhaseCull);
+  cullGovernedScene();
+  qualityGovernor.beginPhase(kPhaseTransform);
+  governedList->clear(TFT_BLACK);
+  drawGovernedScene(governedList);
+  qualityGovernor.beginPhase(kPhaseRaster);
+  governedList->replay(displayTarget);
+  qualityGovernor.beginPhase(kPhasePresent);
+#elif DIRTY_RECTS
+  drawScene(dirtyFrame);
+  frameStats.pixelsPresented = presentDirtyRects(); // (the overlay is drawn over it, on the panel)
+#else
+  drawScene(&displayTarget);
+#endif
 
   drawFps(renderTarget, dt);
 
   if (usingPlaceholder) {
     renderTarget->setTextColor(TFT_YELLOW);
-    renderTarget->printf("No .obj found in data folder.  Rendering placeholder model.  Use 'Upload Filesystem Image' to upload .obj files");
+    renderTarget->printf("%s", kPlaceholderHint);
   }
 
+#if !DIRECT_PANEL
   display.finishRender();
+#endif
+#if QUALITY_GOVERNOR
+  if (qualityGovernor.endFrame())
+  {
+    reportQualityChange();
+  }
+#endif
 }
@@ -10,18 +10,80 @@
  */
 #include <Arduino.h>
 
-class TFT_eSPI;
+#include <vector>
+
 namespace stevesch
 {
   class FaceMesh;
+  class FaceMeshBatch;
   class matrix4;
+  class RenderTarget;
+  class Sphere;
+  struct QualitySettings;
+  struct ScreenRect;
 }
 
+// per-frame counters (reset at the start of each frame)
+struct FrameStats
+{
+  uint instancesOut;     // culled: bounding sphere outside the frustum
+  uint instancesInside;  // drawn without clipping checks
+  uint instancesClipped; // partially visible: drawn with clipping checks
+  uint pixelsSubmitted;  // line pixels the edges would cost without clipping
+  uint pixelsDrawn;      // line pixels actually sent to the display
+  uint facesFilled;      // faces scan-converted (flat mode)
+  uint pixelsFilled;     // pixels written by those faces
+  uint trianglesBinned;  // triangles sent to the tile rasterizer (depth mode)
+  uint pixelsCleared;    // background pixels cleared before drawing
+  uint pixelsPresented;  // pixels of the frame sent to the panel
+};
+extern FrameStats frameStats;
+
+// wireframe edges, or filled faces shaded by their normals: sorted back to front (flat), or
+// depth-tested per pixel in screen tiles (depth).  Filled modes need USE_FACE_NORMALS, and
+// fall back to wireframe otherwise.
+enum RenderMode
+{
+  kRenderWireframe,
+  kRenderFlat,
+  kRenderDepth
+};
+void setRenderMode(RenderMode mode);
+RenderMode getRenderMode();
+// tile edge, in pixels, for the depth mode (its tile buffers take 4 * size^2 bytes)
+void setDepthTileSize(uint size);
+uint getDepthTileSize();
+
 void simpleRendererSetup();
 void simpleRendererLoop(float dt);
+// bytes the Display holds for frames in this build (0 when frames go straight to the panel)
+size_t displayBufferBytes();
+// projection and clip region for a width x height target (setup sets the display's)
+void SetScreenMatrix(int width, int height);
+// the current world-to-view (camera) and view-to-screen (projection with the viewport) transforms
+void getViewTransforms(stevesch::matrix4 &mtxWorldToView, stevesch::matrix4 &mtxViewToScreen);
 
-void drawFaceMesh(TFT_eSPI *renderTarget, const stevesch::FaceMesh &mesh, const stevesch::matrix4 &mtxLtoW, uint16_t color);
-void drawScene(TFT_eSPI *renderTarget);
+void drawFaceMesh(stevesch::RenderTarget *renderTarget, const stevesch::FaceMesh &mesh, const stevesch::matrix4 &mtxLtoW, uint16_t color);
+// draw count instances of mesh in one call (colors may be null).  With localBounds (the mesh's
+// bounding sphere), instances outside the frustum are skipped and those inside skip clipping.
+void drawFaceMeshInstanced(stevesch::RenderTarget *renderTarget, const stevesch::FaceMesh &mesh,
+                           const stevesch::matrix4 *mtxLtoW, uint count, const uint16_t *colors,
+                           const stevesch::Sphere *localBounds = nullptr);
+// draw the visible parts of a static batch (parts outside the view frustum are skipped)
+void drawFaceMeshBatch(stevesch::RenderTarget *renderTarget, const stevesch::FaceMeshBatch &batch, uint16_t color);
+void drawScene(stevesch::RenderTarget *renderTarget);
+// conservative screen rectangle of an instance, from its mesh's local bounding sphere (false if
+// the instance reaches behind the camera)
+bool instanceScreenRect(stevesch::ScreenRect &rect, const stevesch::Sphere &localBounds, const stevesch::matrix4 &mtxLtoW);
+// level of detail (of lodCount) to draw an instance with at a quality governor's settings: the
+// level its screen size picks plus the settings' bias, or -1 if it's too small to draw at all
+int instanceLod(const stevesch::Sphere &localBounds, const stevesch::matrix4 &mtxLtoW,
+                const stevesch::QualitySettings &quality, uint lodCount);
+// adds an instance to the transform and color lists (of lodCount) for the level instanceLod
+// picks; returns false, adding nothing, if the instance is skipped
+bool addInstanceByLod(std::vector<stevesch::matrix4> *groupLtoW, std::vector<uint16_t> *groupColors, uint lodCount,
+                      const stevesch::Sphere &localBounds, const stevesch::matrix4 &mtxLtoW, uint16_t color,
+                      const stevesch::QualitySettings &quality);
 void scanModels();
 
 void nextModel();
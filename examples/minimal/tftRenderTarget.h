@@ -0,0 +1,100 @@
+/**
+ * @file tftRenderTarget.h
+ * @author Stephen Schlueter, github: stevesch
+ * @brief RenderTarget adapter for drawing to a TFT_eSPI display (or sprite)
+ * @version 0.1
+ * @date 2021-05-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#pragma once
+
+#include <stevesch-Mesh.h>
+#include <TFT_eSPI.h>
+
+// Forwards drawing to a TFT_eSPI (the display's current render target, which may change
+// from frame to frame with double buffering-- call setTarget each frame).  Presenting is
+// left to the Display, which pushes its sprite in finishRender().
+class TftRenderTarget : public stevesch::RenderTarget
+{
+public:
+  TftRenderTarget() : mTft(nullptr) {}
+
+  void setTarget(TFT_eSPI *tft) { mTft = tft; }
+  TFT_eSPI *target() const { return mTft; }
+
+  int16_t width() const override { return mTft->width(); }
+  int16_t height() const override { return mTft->height(); }
+
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override
+  {
+    mTft->drawLine(x0, y0, x1, y1, color);
+  }
+  void drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color) override { mTft->drawFastHLine(x, y, w, color); }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override
+  {
+    mTft->fillRect(x, y, w, h, color);
+  }
+  void clear(uint16_t color) override { mTft->fillScreen(color); }
+
+protected:
+  TFT_eSPI *mTft;
+};
+
+// Pushes the finished bands of a StripRenderTarget to a TFT_eSPI display (or sprite).
+class TftBandSink : public stevesch::BandSink
+{
+public:
+  TftBandSink() : mTft(nullptr) {}
+
+  void setTarget(TFT_eSPI *tft) { mTft = tft; }
+
+  void pushBand(int16_t y, int16_t width, int16_t height, const uint16_t *pixels) override
+  {
+    // band pixels are native-endian RGB565; the display wants them byte-swapped
+    const bool bSwap = mTft->getSwapBytes();
+    mTft->setSwapBytes(true);
+    mTft->pushImage(0, y, width, height, pixels);
+    mTft->setSwapBytes(bSwap);
+  }
+
+protected:
+  TFT_eSPI *mTft;
+};
+
+// Pushes bands to a TFT_eSPI panel by DMA (initDMA() must have been called): pushBand() waits
+// for the previous band's transfer, starts this one and returns, so the next band can be filled
+// meanwhile.  Bands must already be in the panel's byte order (DMA sends memory as it is) and
+// stay untouched until the next-but-one pushBand() or finish().  Call begin() before a frame's
+// first band and finish() after its last.
+class TftDmaBandSink : public stevesch::BandSink
+{
+public:
+  TftDmaBandSink() : mTft(nullptr), mSwap(false) {}
+
+  void setTarget(TFT_eSPI *tft) { mTft = tft; }
+
+  void begin()
+  {
+    mTft->startWrite();
+    mSwap = mTft->getSwapBytes();
+    mTft->setSwapBytes(false); // (swapping would rewrite the band in place)
+  }
+
+  void pushBand(int16_t y, int16_t width, int16_t height, const uint16_t *pixels) override
+  {
+    mTft->pushImageDMA(0, y, width, height, const_cast<uint16_t *>(pixels)); // (not written without swapping)
+  }
+
+  void finish()
+  {
+    mTft->dmaWait();
+    mTft->setSwapBytes(mSwap);
+    mTft->endWrite();
+  }
+
+protected:
+  TFT_eSPI *mTft;
+  bool mSwap;
+};
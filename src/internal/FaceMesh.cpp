@@ -7,7 +7,7 @@
 namespace stevesch
 {
   ICACHE_FLASH_ATTR FaceMesh::FaceMesh(const FaceMesh &src)
-      : mPosition(src.mPosition)
+      : LiveMeshList<FaceMesh>(), mPosition(src.mPosition)
 #if USE_FACE_NORMALS
         ,
         mNormal(src.mNormal)
@@ -55,6 +55,40 @@ namespace stevesch
     //}
   }
 
+  void FaceMesh::memoryReport(MeshMemoryReport &report) const
+  {
+    report.clear();
+    report.meshCount = 1;
+    report.addBuffer("positions", mPosition);
+#if USE_FACE_NORMALS
+    report.addBuffer("normals", mNormal);
+#endif
+    report.addBuffer("indices", mPositionIndex);
+    report.addBuffer("faces", mFace);
+  }
+
+  size_t FaceMesh::memoryReserved() const
+  {
+    size_t bytes = mPosition.capacity() * sizeof(vector3);
+#if USE_FACE_NORMALS
+    bytes += mNormal.capacity() * sizeof(vector3);
+#endif
+    bytes += mPositionIndex.capacity() * sizeof(index_t);
+    bytes += mFace.capacity() * sizeof(IndexedFace);
+    return bytes;
+  }
+
+  size_t FaceMesh::estimateMemory(uint positions, uint indices, uint faces, uint normals)
+  {
+    size_t bytes = positions * sizeof(vector3);
+#if USE_FACE_NORMALS
+    bytes += normals * sizeof(vector3);
+#endif
+    bytes += indices * sizeof(index_t);
+    bytes += faces * sizeof(IndexedFace);
+    return bytes;
+  }
+
   uint FaceMesh::addFace(const PlanarFace &face)
   {
     indexBuffer_t &indices = refPositionIndices();
@@ -68,9 +102,15 @@ namespace stevesch
 
     IndexedFace f;
     f.iNormal = face.iNormal;
+    f.fPlane = 0.0f;
     f.iFirst = i0;
     f.iCount = i1 - i0;
-    return addFace(f);
+    uint iface = addFace(f);
+    if ((f.iNormal < normalCount()) && (f.iCount > 0))
+    {
+      updateFacePlane(iface);
+    }
+    return iface;
   }
 
 #if USE_FACE_NORMALS
@@ -81,12 +121,68 @@ namespace stevesch
     for (index_t i = 0; i < nc; ++i)
     {
       const vector3 &n = normals[i];
-      if (v.dot(n) > 0.9998f)
+      if (normalsMatch(v, n))
       {
         return i;
       }
     }
     return -1;
   }
+
+  bool FaceMesh::computeFaceNormal(stevesch::vector3 &outNormal, const IndexedFace &face) const
+  {
+    vector3 v0, v1, v2;
+    vector3 e1, e2, ncontrib, n;
+
+    // sum of fan cross products (twice the vector area of the face), so
+    // non-convex faces still produce a normal facing the same way as the face
+    auto i = mPositionIndex.begin() + face.iFirst;
+    auto iEnd = i + face.iCount;
+    auto j = i + 1;
+    auto k = j + 1;
+
+    v0 = mPosition[*i];
+    n.set(0.0f, 0.0f, 0.0f);
+    do
+    {
+      v1 = mPosition[*j];
+      v2 = mPosition[*k];
+      vector3::sub(e1, v1, v0);
+      vector3::sub(e2, v2, v0);
+      vector3::cross(ncontrib, e1, e2);
+      n += ncontrib;
+
+      j = k;
+      ++k;
+    } while (k != iEnd);
+
+    if (n.squareMag() > 1.0e-5f)
+    {
+      n.normalize();
+      outNormal = n;
+      return true;
+    }
+
+    outNormal.set(0.0f, 1.0f, 0.0f);
+    return false;
+  }
+
+  void FaceMesh::computeFacePlanes()
+  {
+    const uint fc = faceCount();
+    for (uint iface = 0; iface < fc; ++iface)
+    {
+      updateFacePlane(iface);
+    }
+  }
+
+  void FaceMesh::computeNormalDots(float *normalDots, const vector3 &vEyeLocal) const
+  {
+    const uint nc = normalCount();
+    for (uint in = 0; in < nc; ++in)
+    {
+      normalDots[in] = mNormal[in].dot(vEyeLocal);
+    }
+  }
 #endif
 }
@@ -4,12 +4,13 @@
 #include <stevesch-vector3.h>
 
 #include "MeshTypes.h"
+#include "MeshMemory.h"
 #include <stdint.h>
 //#include <c_types.h>
 
 namespace stevesch
 {
-  class FaceMesh
+  class FaceMesh : public LiveMeshList<FaceMesh>
   {
     positionBuffer_t mPosition;
 #if USE_FACE_NORMALS
@@ -29,6 +30,11 @@ namespace stevesch
 
     void compactMemory(); // give back any unused memory
 
+    void memoryReport(MeshMemoryReport &report) const; // per-buffer counts, capacities and bytes
+    size_t memoryReserved() const;                     // bytes held by all buffers (cheap-- no report)
+    // bytes needed for a compacted mesh of the given size
+    static size_t estimateMemory(uint positions, uint indices, uint faces, uint normals);
+
     uint positionCount() const { return mPosition.size(); }
     const positionBuffer_t &positions() const { return mPosition; }
     const stevesch::vector3 &getPosition(stevesch::index_t nIndex) const;
@@ -49,6 +55,26 @@ namespace stevesch
     index_t addNormal(const stevesch::vector3 &v);
 
     stevesch::index_t findMatchingNormal(const stevesch::vector3 &v);
+
+    static constexpr float kNormalMatchDot = 0.9998f; // unit normals with a dot product above this are shared
+    static bool normalsMatch(const stevesch::vector3 &a, const stevesch::vector3 &b) { return a.dot(b) > kNormalMatchDot; }
+
+    // computes the (unit) normal of a face from its current positions.
+    // returns false (and a failsafe normal) for degenerate faces
+    bool computeFaceNormal(stevesch::vector3 &outNormal, const IndexedFace &face) const;
+
+    // face plane distances must be refreshed after a face's normal or positions change
+    void updateFacePlane(uint nIndex);
+    void computeFacePlanes();
+
+    // Facing classification for an eye position in the mesh's local space: computes
+    // (normal . eye) once per unique normal into normalDots (normalCount() entries).
+    // Faces sharing a normal differ only by plane distance, so each face is then
+    // classified with a single compare (see facesEye).
+    void computeNormalDots(float *normalDots, const stevesch::vector3 &vEyeLocal) const;
+    static bool facesEye(const IndexedFace &face, const float *normalDots) { return normalDots[face.iNormal] > face.fPlane; }
+    // single-face test (one dot product)-- cheaper when few faces share normals
+    bool facesEye(const IndexedFace &face, const stevesch::vector3 &vEyeLocal) const { return getNormal(face.iNormal).dot(vEyeLocal) > face.fPlane; }
 #endif
 
     uint faceCount() const
@@ -86,7 +112,7 @@ namespace stevesch
 
   inline const IndexedFace &FaceMesh::getFace(uint nIndex) const
   {
-    SASSERT((nIndex >= 0) && (nIndex < faceCount()));
+    SASSERT(nIndex < faceCount());
     return mFace[nIndex];
   }
 
@@ -98,7 +124,7 @@ namespace stevesch
 
   inline IndexedFace &FaceMesh::refFace(uint nIndex)
   {
-    SASSERT((nIndex >= 0) && (nIndex < faceCount()));
+    SASSERT(nIndex < faceCount());
     return mFace[nIndex];
   }
 
@@ -121,6 +147,12 @@ namespace stevesch
     return mNormal[nIndex];
   }
 
+  inline void FaceMesh::updateFacePlane(uint nIndex)
+  {
+    IndexedFace &face = refFace(nIndex);
+    face.fPlane = getNormal(face.iNormal).dot(mPosition[mPositionIndex[face.iFirst]]);
+  }
+
 #endif
 }
 
@@ -0,0 +1,622 @@
+#include "FaceMeshBVH.h"
+#include "FaceMesh.h"
+
+#include <algorithm>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    constexpr float kParallelEpsilon = 1.0e-8f;
+
+    inline float axisOf(const vector3 &v, int axis)
+    {
+      return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+    }
+
+    // choose the two coordinates to keep when flattening a face onto its dominant plane
+    inline void projectionAxes(const vector3 &n, int &a0, int &a1)
+    {
+      float ax = fabsf(n.x);
+      float ay = fabsf(n.y);
+      float az = fabsf(n.z);
+      if (ax > ay)
+      {
+        if (ax > az)
+        {
+          a0 = 1;
+          a1 = 2;
+          return;
+        }
+      }
+      else if (ay > az)
+      {
+        a0 = 2;
+        a1 = 0;
+        return;
+      }
+      a0 = 0;
+      a1 = 1;
+    }
+
+    inline float cross2(float ax, float ay, float bx, float by)
+    {
+      return ax * by - ay * bx;
+    }
+
+    // Locates p (known to lie in the face plane) within the face's triangle fan.
+    // Returns the winding number of the face around p; if non-zero, corner/u/v are set
+    // to the fan triangle (and barycentrics) containing p.
+    int fanWinding(const FaceMesh &mesh, const IndexedFace &face, const vector3 &n, const vector3 &p,
+                   std::uint16_t &corner, float &u, float &v)
+    {
+      const positionBuffer_t &positions = mesh.positions();
+      const indexBuffer_t &posIndices = mesh.getPositionIndices();
+
+      int a0, a1;
+      projectionAxes(n, a0, a1);
+
+      const vector3 &v0 = positions[posIndices[face.iFirst]];
+      const float x0 = axisOf(v0, a0);
+      const float y0 = axisOf(v0, a1);
+      const float px = axisOf(p, a0) - x0;
+      const float py = axisOf(p, a1) - y0;
+
+      int winding = 0;
+      float bx = axisOf(positions[posIndices[face.iFirst + 1]], a0) - x0;
+      float by = axisOf(positions[posIndices[face.iFirst + 1]], a1) - y0;
+      for (uint k = 1; k + 1 < face.iCount; ++k)
+      {
+        const vector3 &vc = positions[posIndices[face.iFirst + k + 1]];
+        float cx = axisOf(vc, a0) - x0;
+        float cy = axisOf(vc, a1) - y0;
+
+        float denom = cross2(bx, by, cx, cy);
+        if (denom != 0.0f)
+        {
+          float inv = 1.0f / denom;
+          float tu = cross2(px, py, cx, cy) * inv;
+          float tv = cross2(bx, by, px, py) * inv;
+          if ((tu >= 0.0f) && (tv >= 0.0f) && ((tu + tv) <= 1.0f))
+          {
+            int s = (denom > 0.0f) ? 1 : -1;
+            winding += s;
+            if (winding != 0)
+            {
+              corner = k;
+              u = tu;
+              v = tv;
+            }
+          }
+        }
+
+        bx = cx;
+        by = cy;
+      }
+      return winding;
+    }
+
+    // squared distance from point to box (0 if inside)
+    inline float squareDistToBox(const Box4 &box, const vector3 &p)
+    {
+      float dd = 0.0f;
+      const vector4 &vMin = box.getMin();
+      const vector4 &vMax = box.getMax();
+      float d;
+      d = stevesch::maxf(stevesch::maxf(vMin.x - p.x, p.x - vMax.x), 0.0f);
+      dd += d * d;
+      d = stevesch::maxf(stevesch::maxf(vMin.y - p.y, p.y - vMax.y), 0.0f);
+      dd += d * d;
+      d = stevesch::maxf(stevesch::maxf(vMin.z - p.z, p.z - vMax.z), 0.0f);
+      dd += d * d;
+      return dd;
+    }
+
+    // slab test; true if the ray enters the box within [0, fMax] (entry distance returned in tEnter)
+    inline bool rayBox(float &tEnter, const Box4 &box, const vector3 &o, const vector3 &invDir, float fMax)
+    {
+      const vector4 &vMin = box.getMin();
+      const vector4 &vMax = box.getMax();
+
+      float t0 = (vMin.x - o.x) * invDir.x;
+      float t1 = (vMax.x - o.x) * invDir.x;
+      float tmin = stevesch::minf(t0, t1);
+      float tmax = stevesch::maxf(t0, t1);
+
+      t0 = (vMin.y - o.y) * invDir.y;
+      t1 = (vMax.y - o.y) * invDir.y;
+      tmin = stevesch::maxf(tmin, stevesch::minf(t0, t1));
+      tmax = stevesch::minf(tmax, stevesch::maxf(t0, t1));
+
+      t0 = (vMin.z - o.z) * invDir.z;
+      t1 = (vMax.z - o.z) * invDir.z;
+      tmin = stevesch::maxf(tmin, stevesch::minf(t0, t1));
+      tmax = stevesch::minf(tmax, stevesch::maxf(t0, t1));
+
+      tEnter = stevesch::maxf(tmin, 0.0f);
+      return (tmax >= tEnter) && (tEnter <= fMax);
+    }
+
+    inline float safeRecip(float x)
+    {
+      return (fabsf(x) > kParallelEpsilon) ? (1.0f / x) : ((x < 0.0f) ? -3.0e38f : 3.0e38f);
+    }
+  }
+
+  void ICACHE_FLASH_ATTR FaceMeshBVH::clear()
+  {
+    mMesh = nullptr;
+    mNode.clear();
+    mNode.shrink_to_fit();
+    mFaceIndex.clear();
+    mFaceIndex.shrink_to_fit();
+    mFaceLeaf.clear();
+    mFaceLeaf.shrink_to_fit();
+    mNodeDirty.clear();
+    mNodeDirty.shrink_to_fit();
+  }
+
+  size_t FaceMeshBVH::memoryBytes() const
+  {
+    return mNode.capacity() * sizeof(Node) + mFaceIndex.capacity() * sizeof(index_t) +
+           mFaceLeaf.capacity() * sizeof(std::uint32_t) + mNodeDirty.capacity();
+  }
+
+  void FaceMeshBVH::faceBounds(Box4 &box, uint iface) const
+  {
+    const positionBuffer_t &positions = mMesh->positions();
+    const indexBuffer_t &posIndices = mMesh->getPositionIndices();
+    const IndexedFace &face = mMesh->getFace(iface);
+
+    box.m_vMin.set(positions[posIndices[face.iFirst]]);
+    box.m_vMax = box.m_vMin;
+    for (uint j = 1; j < face.iCount; ++j)
+    {
+      vector4 v;
+      v.set(positions[posIndices[face.iFirst + j]]);
+      box.booleanOr(v);
+    }
+  }
+
+  void ICACHE_FLASH_ATTR FaceMeshBVH::build(const FaceMesh &mesh)
+  {
+    clear();
+    mMesh = &mesh;
+
+    const uint fc = mesh.faceCount();
+    if (fc == 0)
+    {
+      return;
+    }
+
+    // per-face bounds and centroids are only needed during the build
+    std::vector<Box4> faceBox(fc);
+    std::vector<vector3> faceCenter(fc);
+    mFaceIndex.resize(fc);
+    for (uint i = 0; i < fc; ++i)
+    {
+      faceBounds(faceBox[i], i);
+      vector4 c;
+      faceBox[i].getCenter(c);
+      faceCenter[i] = c;
+      mFaceIndex[i] = i;
+    }
+
+    mNode.reserve(2 * ((fc + kMaxLeafFaces - 1) / kMaxLeafFaces));
+    buildNode(faceBox, faceCenter, 0, fc, 0);
+    mNode.shrink_to_fit();
+  }
+
+  uint FaceMeshBVH::buildNode(std::vector<Box4> &faceBox, std::vector<vector3> &faceCenter, uint first, uint count, uint depth)
+  {
+    const uint nodeIndex = mNode.size();
+    mNode.emplace_back();
+
+    Box4 box(faceBox[mFaceIndex[first]]);
+    vector4 cmin, cmax;
+    cmin.set(faceCenter[mFaceIndex[first]]);
+    cmax = cmin;
+    for (uint i = first + 1; i < first + count; ++i)
+    {
+      box.booleanOr(faceBox[mFaceIndex[i]]);
+      vector4 c;
+      c.set(faceCenter[mFaceIndex[i]]);
+      vector4::min3(cmin, cmin, c);
+      vector4::max3(cmax, cmax, c);
+    }
+    mNode[nodeIndex].mBox = box;
+
+    if ((count <= kMaxLeafFaces) || (depth >= kMaxDepth))
+    {
+      Node &leaf = mNode[nodeIndex];
+      leaf.mFirst = first;
+      leaf.mCount = count;
+      return nodeIndex;
+    }
+
+    // split at the median centroid along the axis of largest centroid spread
+    vector4 spread;
+    vector4::sub3(spread, cmax, cmin);
+    int axis = 0;
+    if (spread.y > spread.x)
+    {
+      axis = 1;
+    }
+    if (spread.z > axisOf(spread, axis))
+    {
+      axis = 2;
+    }
+
+    const uint half = count / 2;
+    auto ibegin = mFaceIndex.begin() + first;
+    std::nth_element(ibegin, ibegin + half, ibegin + count,
+                     [&faceCenter, axis](index_t a, index_t b) {
+                       return axisOf(faceCenter[a], axis) < axisOf(faceCenter[b], axis);
+                     });
+
+    buildNode(faceBox, faceCenter, first, half, depth + 1);
+    uint second = buildNode(faceBox, faceCenter, first + half, count - half, depth + 1);
+
+    Node &node = mNode[nodeIndex];
+    node.mFirst = second;
+    node.mCount = 0;
+    return nodeIndex;
+  }
+
+  void FaceMeshBVH::leafBounds(Node &node) const
+  {
+    faceBounds(node.mBox, mFaceIndex[node.mFirst]);
+    for (uint j = 1; j < node.mCount; ++j)
+    {
+      Box4 b;
+      faceBounds(b, mFaceIndex[node.mFirst + j]);
+      node.mBox.booleanOr(b);
+    }
+  }
+
+  void FaceMeshBVH::refit()
+  {
+    if (!isBuilt())
+    {
+      return;
+    }
+
+    // children always follow their parent, so a reverse sweep sees children first
+    uint i = mNode.size();
+    while (i-- > 0)
+    {
+      Node &node = mNode[i];
+      if (node.isLeaf())
+      {
+        leafBounds(node);
+      }
+      else
+      {
+        node.mBox = mNode[i + 1].mBox;
+        node.mBox.booleanOr(mNode[node.mFirst].mBox);
+      }
+    }
+  }
+
+  void FaceMeshBVH::refitFaces(const index_t *faces, uint count)
+  {
+    if (!isBuilt() || (count == 0))
+    {
+      return;
+    }
+
+    const uint nc = mNode.size();
+    if (mFaceLeaf.empty())
+    {
+      mFaceLeaf.resize(mMesh->faceCount());
+      for (uint i = 0; i < nc; ++i)
+      {
+        const Node &node = mNode[i];
+        for (uint j = 0; j < node.mCount; ++j)
+        {
+          mFaceLeaf[mFaceIndex[node.mFirst + j]] = i;
+        }
+      }
+      mNodeDirty.assign(nc, 0);
+    }
+
+    for (uint k = 0; k < count; ++k)
+    {
+      mNodeDirty[mFaceLeaf[faces[k]]] = 1;
+    }
+
+    // only dirty leaves are recomputed; dirtiness propagates to parents in the reverse sweep
+    uint i = nc;
+    while (i-- > 0)
+    {
+      Node &node = mNode[i];
+      if (node.isLeaf())
+      {
+        if (mNodeDirty[i])
+        {
+          leafBounds(node);
+        }
+      }
+      else if (mNodeDirty[i + 1] || mNodeDirty[node.mFirst])
+      {
+        node.mBox = mNode[i + 1].mBox;
+        node.mBox.booleanOr(mNode[node.mFirst].mBox);
+        mNodeDirty[i + 1] = 0;
+        mNodeDirty[node.mFirst] = 0;
+        mNodeDirty[i] = 1;
+      }
+    }
+    mNodeDirty[0] = 0;
+  }
+
+  bool FaceMeshBVH::intersectFace(FaceMeshHit &hit, const FaceMesh &mesh, uint iface,
+                                  const vector3 &vOrigin, const vector3 &vDir, float fMaxDistance)
+  {
+    const IndexedFace &face = mesh.getFace(iface);
+    const vector3 &n = mesh.getNormal(face.iNormal);
+    const vector3 &v0 = mesh.getPosition(mesh.getPositionIndices()[face.iFirst]);
+
+    float ndir = n.dot(vDir);
+    if (fabsf(ndir) < kParallelEpsilon)
+    {
+      return false; // parallel to face plane
+    }
+
+    // plane: n.p = n.v0
+    vector3 toPlane;
+    vector3::sub(toPlane, v0, vOrigin);
+    float t = n.dot(toPlane) / ndir;
+    if ((t < 0.0f) || (t >= fMaxDistance))
+    {
+      return false;
+    }
+
+    vector3 p;
+    vector3::addScaled(p, vOrigin, vDir, t);
+    std::uint16_t corner = 1;
+    float u = 0.0f;
+    float v = 0.0f;
+    if (0 == fanWinding(mesh, face, n, p, corner, u, v))
+    {
+      return false;
+    }
+
+    hit.face = iface;
+    hit.distance = t;
+    hit.point = p;
+    hit.corner = corner;
+    hit.u = u;
+    hit.v = v;
+    return true;
+  }
+
+  bool FaceMeshBVH::nearestOnFace(FaceMeshHit &hit, const FaceMesh &mesh, uint iface, const vector3 &vPoint)
+  {
+    const positionBuffer_t &positions = mesh.positions();
+    const indexBuffer_t &posIndices = mesh.getPositionIndices();
+    const IndexedFace &face = mesh.getFace(iface);
+    const vector3 &n = mesh.getNormal(face.iNormal);
+    const vector3 &v0 = positions[posIndices[face.iFirst]];
+
+    // project onto face plane-- if the projection is inside the face, it's the nearest point
+    vector3 rel;
+    vector3::sub(rel, vPoint, v0);
+    float h = n.dot(rel);
+    vector3 q;
+    vector3::addScaled(q, vPoint, n, -h);
+
+    std::uint16_t corner = 1;
+    float u = 0.0f;
+    float v = 0.0f;
+    if (0 != fanWinding(mesh, face, n, q, corner, u, v))
+    {
+      hit.face = iface;
+      hit.distance = fabsf(h);
+      hit.point = q;
+      hit.corner = corner;
+      hit.u = u;
+      hit.v = v;
+      return true;
+    }
+
+    // otherwise it's on the boundary
+    const uint vc = face.iCount;
+    float bestDD = 3.0e38f;
+    uint bestEdge = 0;
+    float bestT = 0.0f;
+    for (uint j = 0; j < vc; ++j)
+    {
+      uint k = (j + 1 < vc) ? (j + 1) : 0;
+      const vector3 &a = positions[posIndices[face.iFirst + j]];
+      const vector3 &b = positions[posIndices[face.iFirst + k]];
+      vector3 ab, ap;
+      vector3::sub(ab, b, a);
+      vector3::sub(ap, vPoint, a);
+      float len2 = ab.squareMag();
+      float t = (len2 > 0.0f) ? stevesch::minf(stevesch::maxf(ap.dot(ab) / len2, 0.0f), 1.0f) : 0.0f;
+      vector3 c;
+      vector3::addScaled(c, a, ab, t);
+      float dd = vector3::squareDist(c, vPoint);
+      if (dd < bestDD)
+      {
+        bestDD = dd;
+        bestEdge = j;
+        bestT = t;
+        hit.point = c;
+      }
+    }
+
+    // express boundary point in terms of the fan triangle that owns the edge
+    if (bestEdge == 0)
+    {
+      corner = 1;
+      u = bestT;
+      v = 0.0f;
+    }
+    else if (bestEdge == vc - 1)
+    {
+      corner = vc - 2;
+      u = 0.0f;
+      v = 1.0f - bestT;
+    }
+    else
+    {
+      corner = bestEdge;
+      u = 1.0f - bestT;
+      v = bestT;
+    }
+
+    hit.face = iface;
+    hit.distance = sqrtf(bestDD);
+    hit.corner = corner;
+    hit.u = u;
+    hit.v = v;
+    return true;
+  }
+
+  bool FaceMeshBVH::raycast(FaceMeshHit &hit, const vector3 &vOrigin, const vector3 &vDir, float fMaxDistance) const
+  {
+    if (!isBuilt())
+    {
+      return false;
+    }
+
+    vector3 invDir(safeRecip(vDir.x), safeRecip(vDir.y), safeRecip(vDir.z));
+
+    bool bHit = false;
+    float tBest = fMaxDistance;
+
+    std::uint32_t stack[kMaxDepth + 2];
+    uint sp = 0;
+    float tEnter;
+    if (!rayBox(tEnter, mNode[0].mBox, vOrigin, invDir, tBest))
+    {
+      return false;
+    }
+    stack[sp++] = 0;
+
+    while (sp > 0)
+    {
+      const Node &node = mNode[stack[--sp]];
+      if (!rayBox(tEnter, node.mBox, vOrigin, invDir, tBest))
+      {
+        continue; // a closer hit was found since this node was pushed
+      }
+
+      if (node.isLeaf())
+      {
+        for (uint j = 0; j < node.mCount; ++j)
+        {
+          if (intersectFace(hit, *mMesh, mFaceIndex[node.mFirst + j], vOrigin, vDir, tBest))
+          {
+            tBest = hit.distance;
+            bHit = true;
+          }
+        }
+        continue;
+      }
+
+      // push the farther child first so the nearer one is visited next
+      std::uint32_t ia = (std::uint32_t)(&node - &mNode[0]) + 1;
+      std::uint32_t ib = node.mFirst;
+      float ta, tb;
+      bool ha = rayBox(ta, mNode[ia].mBox, vOrigin, invDir, tBest);
+      bool hb = rayBox(tb, mNode[ib].mBox, vOrigin, invDir, tBest);
+      if (ha && hb)
+      {
+        if (ta > tb)
+        {
+          std::swap(ia, ib);
+        }
+        stack[sp++] = ib;
+        stack[sp++] = ia;
+      }
+      else if (ha)
+      {
+        stack[sp++] = ia;
+      }
+      else if (hb)
+      {
+        stack[sp++] = ib;
+      }
+    }
+
+    return bHit;
+  }
+
+  bool FaceMeshBVH::intersect(FaceMeshHit &hit, const Segment &segment) const
+  {
+    vector3 vOrigin(segment.getV0().x, segment.getV0().y, segment.getV0().z);
+    vector3 vDir;
+    vector3::sub(vDir, segment.getV1(), segment.getV0());
+    return raycast(hit, vOrigin, vDir, 1.0f);
+  }
+
+  bool FaceMeshBVH::nearest(FaceMeshHit &hit, const vector3 &vPoint, float fMaxDistance) const
+  {
+    if (!isBuilt())
+    {
+      return false;
+    }
+
+    bool bFound = false;
+    float ddBest = (fMaxDistance < 1.0e19f) ? (fMaxDistance * fMaxDistance) : 3.0e38f;
+
+    std::uint32_t stack[kMaxDepth + 2];
+    uint sp = 0;
+    stack[sp++] = 0;
+
+    FaceMeshHit candidate;
+    while (sp > 0)
+    {
+      const Node &node = mNode[stack[--sp]];
+      if (squareDistToBox(node.mBox, vPoint) > ddBest)
+      {
+        continue;
+      }
+
+      if (node.isLeaf())
+      {
+        for (uint j = 0; j < node.mCount; ++j)
+        {
+          if (nearestOnFace(candidate, *mMesh, mFaceIndex[node.mFirst + j], vPoint))
+          {
+            float dd = candidate.distance * candidate.distance;
+            if (dd <= ddBest)
+            {
+              ddBest = dd;
+              hit = candidate;
+              bFound = true;
+            }
+          }
+        }
+        continue;
+      }
+
+      // visit the closer child first
+      std::uint32_t ia = (std::uint32_t)(&node - &mNode[0]) + 1;
+      std::uint32_t ib = node.mFirst;
+      float da = squareDistToBox(mNode[ia].mBox, vPoint);
+      float db = squareDistToBox(mNode[ib].mBox, vPoint);
+      if (da > db)
+      {
+        std::swap(ia, ib);
+        std::swap(da, db);
+      }
+      if (db <= ddBest)
+      {
+        stack[sp++] = ib;
+      }
+      if (da <= ddBest)
+      {
+        stack[sp++] = ia;
+      }
+    }
+
+    return bFound;
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef STEVESCH_RENDER_SFACEMESHBVH_H_
+#define STEVESCH_RENDER_SFACEMESHBVH_H_
+
+#include <stevesch-MathVec.h>
+
+#include "Geom/Geom.h"
+#include "MeshTypes.h"
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  class FaceMesh;
+
+  // result of a ray/segment or nearest-point query against a FaceMesh
+  // (all positions are in the mesh's local space)
+  struct FaceMeshHit
+  {
+    uint face;               // index of face (into FaceMesh::faces())
+    float distance;          // distance along ray (or from query point to nearest point)
+    stevesch::vector3 point; // location of hit (or nearest point) on the face
+    std::uint16_t corner;    // face is fanned from vertex 0: point lies in triangle (0, corner, corner+1)
+    float u;                 // barycentric weight of vertex 'corner'
+    float v;                 // barycentric weight of vertex 'corner+1' (weight of vertex 0 is 1-u-v)
+  };
+
+  // Bounding volume hierarchy over the faces of a FaceMesh, for picking (ray/segment casts)
+  // and nearest-point queries.  Faces may be non-convex (as allowed by USE_FACE_NORMALS);
+  // containment is determined by winding number over the face's triangle fan.
+  //
+  // The BVH keeps a pointer to the mesh it was built from-- rebuild (or refit, if only
+  // positions moved) after modifying the mesh.
+  class FaceMeshBVH
+  {
+  public:
+    struct Node
+    {
+      Box4 mBox;
+      std::uint32_t mFirst; // leaf: first entry in face index list; interior: index of second child (first child is next node)
+      std::uint16_t mCount; // leaf: number of faces; interior: 0
+
+      bool isLeaf() const { return mCount > 0; }
+    };
+
+    static constexpr uint kMaxLeafFaces = 4;
+    static constexpr uint kMaxDepth = 48;
+
+    FaceMeshBVH() : mMesh(nullptr) {}
+    ~FaceMeshBVH() {}
+
+    void build(const FaceMesh &mesh);
+    void refit(); // recompute node bounds after positions have moved (topology must be unchanged)
+    void refitFaces(const index_t *faces, uint count); // refit only the nodes containing the given faces
+    void clear();
+
+    bool isBuilt() const { return (nullptr != mMesh) && (mNode.size() > 0); }
+    const FaceMesh *mesh() const { return mMesh; }
+
+    uint nodeCount() const { return mNode.size(); }
+    const Node &getNode(uint nIndex) const;
+    size_t memoryBytes() const; // heap memory held by node and face index buffers
+
+    // cast a ray from vOrigin along vDir (need not be normalized-- distances are in units of |vDir|),
+    // returning the nearest face hit closer than fMaxDistance.
+    bool raycast(FaceMeshHit &hit, const stevesch::vector3 &vOrigin, const stevesch::vector3 &vDir, float fMaxDistance = 3.0e38f) const;
+
+    // nearest intersection of the segment with the mesh (hit.distance is in units of segment length, 0..1)
+    bool intersect(FaceMeshHit &hit, const Segment &segment) const;
+
+    // nearest point on the mesh surface within fMaxDistance of vPoint
+    bool nearest(FaceMeshHit &hit, const stevesch::vector3 &vPoint, float fMaxDistance = 3.0e38f) const;
+
+    // single-face tests (no acceleration-- also usable for brute-force comparison)
+    static bool intersectFace(FaceMeshHit &hit, const FaceMesh &mesh, uint iface,
+                              const stevesch::vector3 &vOrigin, const stevesch::vector3 &vDir, float fMaxDistance);
+    static bool nearestOnFace(FaceMeshHit &hit, const FaceMesh &mesh, uint iface, const stevesch::vector3 &vPoint);
+
+  protected:
+    const FaceMesh *mMesh;
+    std::vector<Node> mNode;
+    std::vector<index_t> mFaceIndex; // faces referenced by leaves
+    std::vector<std::uint32_t> mFaceLeaf; // leaf node of each face (built on first partial refit)
+    std::vector<std::uint8_t> mNodeDirty;
+
+    uint buildNode(std::vector<Box4> &faceBox, std::vector<stevesch::vector3> &faceCenter, uint first, uint count, uint depth);
+    void faceBounds(Box4 &box, uint iface) const;
+    void leafBounds(Node &node) const;
+  };
+
+  inline const FaceMeshBVH::Node &FaceMeshBVH::getNode(uint nIndex) const
+  {
+    SASSERT(nIndex < nodeCount());
+    return mNode[nIndex];
+  }
+}
+
+#endif
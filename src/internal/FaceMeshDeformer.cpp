@@ -0,0 +1,322 @@
+#include "FaceMeshDeformer.h"
+#include "FaceMesh.h"
+#include "FaceMeshBVH.h"
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  FaceMeshDeformer::FaceMeshDeformer()
+      : mMesh(nullptr), mBVH(nullptr), mStamp(0),
+        mBoundsMin(0.0f, 0.0f, 0.0f), mBoundsMax(0.0f, 0.0f, 0.0f), mBoundsStale(false),
+        mStatFaces(0), mStatSplits(0)
+  {
+  }
+
+  void ICACHE_FLASH_ATTR FaceMeshDeformer::attach(FaceMesh &mesh, FaceMeshBVH *bvh)
+  {
+    detach();
+    mMesh = &mesh;
+    mBVH = bvh;
+
+    const uint vc = mesh.positionCount();
+    const uint fc = mesh.faceCount();
+    const indexBuffer_t &posIndices = mesh.getPositionIndices();
+
+    // build position -> face adjacency
+    mVertFaceStart.assign(vc + 1, 0);
+    for (uint iface = 0; iface < fc; ++iface)
+    {
+      const IndexedFace &face = mesh.getFace(iface);
+      for (uint j = 0; j < face.iCount; ++j)
+      {
+        ++mVertFaceStart[posIndices[face.iFirst + j] + 1];
+      }
+    }
+    for (uint i = 0; i < vc; ++i)
+    {
+      mVertFaceStart[i + 1] += mVertFaceStart[i];
+    }
+    mVertFace.resize(mVertFaceStart[vc]);
+    {
+      std::vector<std::uint32_t> fill(mVertFaceStart.begin(), mVertFaceStart.end() - 1);
+      for (uint iface = 0; iface < fc; ++iface)
+      {
+        const IndexedFace &face = mesh.getFace(iface);
+        for (uint j = 0; j < face.iCount; ++j)
+        {
+          mVertFace[fill[posIndices[face.iFirst + j]]++] = iface;
+        }
+      }
+    }
+
+    mDirtyFlag.assign(vc, 0);
+    mDirtyList.clear();
+    mFaceStamp.assign(fc, 0);
+    mStamp = 0;
+
+#if USE_FACE_NORMALS
+    const uint nc = mesh.normalCount();
+    mNormalUse.assign(nc, 0);
+    for (uint iface = 0; iface < fc; ++iface)
+    {
+      ++mNormalUse[mesh.getFace(iface).iNormal];
+    }
+    mNormalStamp.assign(nc, 0);
+    mNormalDirtyUse.assign(nc, 0);
+    mNormalKeep.assign(nc, 0);
+    mNormalState.assign(nc, kNormalUndecided);
+    mFreeNormal.clear();
+    for (uint in = 0; in < nc; ++in)
+    {
+      if (mNormalUse[in] == 0)
+      {
+        mFreeNormal.push_back(in);
+      }
+    }
+#endif
+
+    mesh.computeExtents(mBoundsMin, mBoundsMax);
+    mBoundsStale = false;
+  }
+
+  void ICACHE_FLASH_ATTR FaceMeshDeformer::detach()
+  {
+    mMesh = nullptr;
+    mBVH = nullptr;
+    mVertFaceStart.clear();
+    mVertFace.clear();
+    mDirtyFlag.clear();
+    mDirtyList.clear();
+    mFaceStamp.clear();
+    mTouchedFace.clear();
+    mTouchedNormal.clear();
+    mTouchedKeep.clear();
+    mNormalUse.clear();
+    mNormalStamp.clear();
+    mNormalDirtyUse.clear();
+    mNormalKeep.clear();
+    mNormalState.clear();
+    mUpdatedNormal.clear();
+    mFreeNormal.clear();
+  }
+
+  bool FaceMeshDeformer::onBounds(const vector3 &v) const
+  {
+    return (v.x <= mBoundsMin.x) || (v.y <= mBoundsMin.y) || (v.z <= mBoundsMin.z) ||
+           (v.x >= mBoundsMax.x) || (v.y >= mBoundsMax.y) || (v.z >= mBoundsMax.z);
+  }
+
+  void FaceMeshDeformer::setPosition(index_t nIndex, const vector3 &v)
+  {
+    SASSERT(isAttached());
+    vector3 &rv = mMesh->refPosition(nIndex);
+    if (!mBoundsStale && onBounds(rv))
+    {
+      mBoundsStale = true; // bounds may shrink
+    }
+    rv = v;
+    if (!mDirtyFlag[nIndex])
+    {
+      mDirtyFlag[nIndex] = 1;
+      mDirtyList.push_back(nIndex);
+    }
+  }
+
+  void FaceMeshDeformer::markAllDirty()
+  {
+    SASSERT(isAttached());
+    const uint vc = mDirtyFlag.size();
+    for (uint i = 0; i < vc; ++i)
+    {
+      markDirty(i);
+    }
+  }
+
+  void FaceMeshDeformer::stampNormal(index_t in)
+  {
+    if (mNormalStamp[in] != mStamp)
+    {
+      mNormalStamp[in] = mStamp;
+      mNormalDirtyUse[in] = 0;
+      mNormalKeep[in] = 0;
+      mNormalState[in] = kNormalUndecided;
+    }
+  }
+
+  index_t FaceMeshDeformer::splitNormal(index_t inOld, const vector3 &n)
+  {
+#if USE_FACE_NORMALS
+    ++mStatSplits;
+
+    if (--mNormalUse[inOld] == 0)
+    {
+      mFreeNormal.push_back(inOld);
+    }
+
+    // share with a normal already produced by this update, if one matches
+    for (index_t in : mUpdatedNormal)
+    {
+      if ((mNormalUse[in] > 0) && FaceMesh::normalsMatch(mMesh->getNormal(in), n))
+      {
+        ++mNormalUse[in];
+        return in;
+      }
+    }
+
+    index_t in;
+    if (!mFreeNormal.empty())
+    {
+      in = mFreeNormal.back();
+      mFreeNormal.pop_back();
+      mMesh->refNormal(in) = n;
+    }
+    else
+    {
+      in = mMesh->addNormal(n);
+      mNormalUse.push_back(0);
+      mNormalStamp.push_back(0);
+      mNormalDirtyUse.push_back(0);
+      mNormalKeep.push_back(0);
+      mNormalState.push_back(kNormalUndecided);
+    }
+    stampNormal(in);
+    mNormalState[in] = kNormalRewritten;
+    mNormalUse[in] = 1;
+    mUpdatedNormal.push_back(in);
+    return in;
+#else
+    return inOld;
+#endif
+  }
+
+  uint FaceMeshDeformer::update()
+  {
+    mStatFaces = 0;
+    mStatSplits = 0;
+    if (!isAttached() || mDirtyList.empty())
+    {
+      return 0;
+    }
+
+    FaceMesh &mesh = *mMesh;
+    ++mStamp;
+
+    // gather faces touched by dirty positions
+    mTouchedFace.clear();
+    for (index_t iv : mDirtyList)
+    {
+      const std::uint32_t iEnd = mVertFaceStart[iv + 1];
+      for (std::uint32_t k = mVertFaceStart[iv]; k < iEnd; ++k)
+      {
+        index_t iface = mVertFace[k];
+        if (mFaceStamp[iface] != mStamp)
+        {
+          mFaceStamp[iface] = mStamp;
+          mTouchedFace.push_back(iface);
+        }
+      }
+    }
+    const uint tc = mTouchedFace.size();
+    mStatFaces = tc;
+
+#if USE_FACE_NORMALS
+    // pass 1: new normals; faces that still agree with their shared normal keep it
+    mTouchedNormal.resize(tc);
+    mTouchedKeep.resize(tc);
+    mUpdatedNormal.clear();
+    for (uint t = 0; t < tc; ++t)
+    {
+      const IndexedFace &face = mesh.getFace(mTouchedFace[t]);
+      vector3 &n = mTouchedNormal[t];
+      mesh.computeFaceNormal(n, face);
+
+      index_t in = face.iNormal;
+      stampNormal(in);
+      ++mNormalDirtyUse[in];
+      bool bKeep = FaceMesh::normalsMatch(mesh.getNormal(in), n);
+      mTouchedKeep[t] = bKeep ? 1 : 0;
+      if (bKeep)
+      {
+        ++mNormalKeep[in];
+      }
+    }
+
+    // decide, before anything changes, which shared normals can simply be rewritten:
+    // those whose users all moved, with none of them keeping the old value
+    for (uint t = 0; t < tc; ++t)
+    {
+      index_t in = mesh.getFace(mTouchedFace[t]).iNormal;
+      if (mNormalState[in] == kNormalUndecided)
+      {
+        bool bRewrite = (mNormalKeep[in] == 0) && (mNormalDirtyUse[in] == mNormalUse[in]);
+        mNormalState[in] = bRewrite ? kNormalRewritable : kNormalFixed;
+      }
+    }
+
+    // pass 2: faces that diverged-- rewrite the normal in place or split the face off
+    for (uint t = 0; t < tc; ++t)
+    {
+      if (mTouchedKeep[t])
+      {
+        continue;
+      }
+
+      IndexedFace &face = mesh.refFace(mTouchedFace[t]);
+      const vector3 &n = mTouchedNormal[t];
+      index_t in = face.iNormal;
+
+      if (mNormalState[in] == kNormalRewritable)
+      {
+        mesh.refNormal(in) = n;
+        mNormalState[in] = kNormalRewritten;
+        mUpdatedNormal.push_back(in);
+        continue;
+      }
+
+      if ((mNormalState[in] == kNormalRewritten) && FaceMesh::normalsMatch(mesh.getNormal(in), n))
+      {
+        continue;
+      }
+
+      face.iNormal = splitNormal(in, n);
+    }
+
+    for (uint t = 0; t < tc; ++t)
+    {
+      mesh.updateFacePlane(mTouchedFace[t]);
+    }
+#endif
+
+    // bounds
+    if (mBoundsStale)
+    {
+      mesh.computeExtents(mBoundsMin, mBoundsMax);
+      mBoundsStale = false;
+    }
+    else
+    {
+      for (index_t iv : mDirtyList)
+      {
+        const vector3 &v = mesh.getPosition(iv);
+        vector3::min(mBoundsMin, mBoundsMin, v);
+        vector3::max(mBoundsMax, mBoundsMax, v);
+      }
+    }
+
+    if (mBVH && mBVH->isBuilt())
+    {
+      mBVH->refitFaces(&mTouchedFace[0], tc);
+    }
+
+    for (index_t iv : mDirtyList)
+    {
+      mDirtyFlag[iv] = 0;
+    }
+    mDirtyList.clear();
+
+    return tc;
+  }
+}
@@ -0,0 +1,110 @@
+#ifndef STEVESCH_RENDER_SFACEMESHDEFORMER_H_
+#define STEVESCH_RENDER_SFACEMESHDEFORMER_H_
+
+#include <stevesch-vector3.h>
+
+#include "MeshTypes.h"
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  class FaceMesh;
+  class FaceMeshBVH;
+
+  // Incremental maintenance of face normals, face planes and bounds for a FaceMesh whose
+  // positions are animated.  Positions changed through setPosition (or edited via FaceMesh::refPosition
+  // and reported with markDirty) are tracked; update() then recomputes only the faces
+  // that use those positions.
+  //
+  // Normals are shared between faces (see FaceMesh::findMatchingNormal).  When faces that
+  // share a normal stop agreeing, the normal is split: the diverging face gets its own
+  // (or another matching) normal.  Normals that are no longer referenced are recycled.
+  class FaceMeshDeformer
+  {
+  public:
+    FaceMeshDeformer();
+    ~FaceMeshDeformer() {}
+
+    void attach(FaceMesh &mesh, FaceMeshBVH *bvh = nullptr); // bvh (optional) is refit on update
+    void detach();
+
+    bool isAttached() const { return nullptr != mMesh; }
+    FaceMesh *mesh() const { return mMesh; }
+
+    void setPosition(index_t nIndex, const stevesch::vector3 &v);
+    void markDirty(index_t nIndex); // position was edited directly
+    void markAllDirty();
+
+    uint dirtyCount() const { return mDirtyList.size(); }
+
+    // recompute normals, face planes (and bounds) affected by dirty positions; returns number of faces refreshed
+    uint update();
+
+    const stevesch::vector3 &boundsMin() const { return mBoundsMin; }
+    const stevesch::vector3 &boundsMax() const { return mBoundsMax; }
+
+    // statistics for the most recent update
+    uint lastFacesUpdated() const { return mStatFaces; }
+    uint lastNormalsSplit() const { return mStatSplits; }
+
+  protected:
+    enum
+    {
+      kNormalUndecided = 0,
+      kNormalRewritable, // every user moved and diverged-- rewrite in place
+      kNormalFixed,      // some user kept the old value-- diverging faces split off
+      kNormalRewritten
+    };
+
+    FaceMesh *mMesh;
+    FaceMeshBVH *mBVH;
+
+    // position -> faces adjacency (compressed: faces of position i are
+    // mVertFace[mVertFaceStart[i]] .. mVertFace[mVertFaceStart[i+1]-1])
+    std::vector<std::uint32_t> mVertFaceStart;
+    std::vector<index_t> mVertFace;
+
+    std::vector<std::uint8_t> mDirtyFlag;
+    std::vector<index_t> mDirtyList;
+
+    // per-update scratch (stamped so nothing needs clearing between updates)
+    std::uint32_t mStamp;
+    std::vector<std::uint32_t> mFaceStamp;
+    std::vector<index_t> mTouchedFace;
+    std::vector<stevesch::vector3> mTouchedNormal;
+    std::vector<std::uint8_t> mTouchedKeep;
+
+    std::vector<std::uint16_t> mNormalUse; // number of faces referencing each normal
+    std::vector<std::uint32_t> mNormalStamp;
+    std::vector<std::uint16_t> mNormalDirtyUse;
+    std::vector<std::uint16_t> mNormalKeep;
+    std::vector<std::uint8_t> mNormalState;
+    std::vector<index_t> mUpdatedNormal; // normals rewritten or created this update (split candidates)
+    std::vector<index_t> mFreeNormal;
+
+    stevesch::vector3 mBoundsMin;
+    stevesch::vector3 mBoundsMax;
+    bool mBoundsStale;
+
+    uint mStatFaces;
+    uint mStatSplits;
+
+    void stampNormal(index_t in);
+    index_t splitNormal(index_t inOld, const stevesch::vector3 &n);
+    bool onBounds(const stevesch::vector3 &v) const;
+  };
+
+  inline void FaceMeshDeformer::markDirty(index_t nIndex)
+  {
+    SASSERT(nIndex < mDirtyFlag.size());
+    if (!mDirtyFlag[nIndex])
+    {
+      mDirtyFlag[nIndex] = 1;
+      mDirtyList.push_back(nIndex);
+    }
+    mBoundsStale = true; // previous position unknown-- it may have been on the bounds
+  }
+}
+
+#endif
@@ -16,6 +16,13 @@ namespace stevesch
     m_vMax = box.getMax();
   }
 
+  SBOX4INLINE Box4 &Box4::operator=(const Box4 &box)
+  {
+    m_vMin = box.getMin();
+    m_vMax = box.getMax();
+    return *this;
+  }
+
   SBOX4INLINE Box4::Box4(const vector4 &vMin, const vector4 &vMax)
   {
     m_vMin = vMin;
@@ -1,5 +1,6 @@
 // TO-CHECK: Plane::transform
 #include "Geom.h"
+#include "../Render/VertexKernel.h"
 #include <cmath>
 
 #ifdef SDEBUG_TRACE_LINE
@@ -751,18 +752,21 @@ namespace stevesch
     //		vector4 vToViewZ;
     //		pWorldToView->GetColumn(2, vToViewZ);
 
-    while (nVerts-- > 0)
+    // TO-CHECK: mul
+    if (nVerts > 0)
     {
-      // TO-CHECK: mul
-      vector4::transform(*pScreen, *pMtxToScreen, *pWorld);
+      transformVertices(pScreen, pWorld, (uint)nVerts, *pMtxToScreen);
+    }
 
-      pScreen->x /= pScreen->w;
-      pScreen->y /= pScreen->w;
+    while (nVerts-- > 0)
+    {
+      float invw = stevesch::recipf(pScreen->w);
+      pScreen->x *= invw;
+      pScreen->y *= invw;
 
       pScreen->z = pScreen->w;
       pScreen->w = 1.0f;
 
-      pWorld++;
       pScreen++;
     }
     return true;
@@ -68,8 +68,8 @@ namespace stevesch
   {
   public:
     // returns true if a transform was performed (otherwise just did copy or no-op)
-    virtual bool transform(vector4 *pDst, const vector4 *pSrc, int nVerts) { return false; }
-    virtual bool untransform(vector4 *pDst, const vector4 *pSrc, int nVerts) { return false; }
+    virtual bool transform(vector4 * /*pDst*/, const vector4 * /*pSrc*/, int /*nVerts*/) { return false; }
+    virtual bool untransform(vector4 * /*pDst*/, const vector4 * /*pSrc*/, int /*nVerts*/) { return false; }
   };
 
   ///////////////////////////////////////////////////////////////
@@ -156,6 +156,7 @@ namespace stevesch
     SSPHEREINLINE Sphere(const float v[4]); // x, y, z, radius
     SSPHEREINLINE Sphere(const vector3 &center, float radius);
     SSPHEREINLINE Sphere(const Sphere &s); // copy existing sphere
+    SSPHEREINLINE Sphere &operator=(const Sphere &s);
 
     SSPHEREINLINE ~Sphere() {}
 
@@ -286,6 +287,7 @@ namespace stevesch
     Box4(){};
     ~Box4(){};
     Box4(const Box4 &box);
+    Box4 &operator=(const Box4 &box);
     Box4(const vector4 &vMin, const vector4 &vMax);
 
     inline const vector4 &getMin() const { return m_vMin; }
@@ -361,15 +363,15 @@ namespace stevesch
     virtual ~ParentLink();
     //		virtual void getLtoW( matrix4& rMtx )	{ rMtx.identity(); /* default to identity */ }
     //		virtual void GetWtoL( matrix4& rMtx )	{ rMtx.identity(); /* default to identity */ }
-    virtual void toParentFrame(matrix4 &rMtx)
+    virtual void toParentFrame(matrix4 & /*rMtx*/)
     { /* default to identity */
     }
-    virtual void fromParentFrame(matrix4 &rMtx)
+    virtual void fromParentFrame(matrix4 & /*rMtx*/)
     { /* default to identity */
     }
 
     // nPosition --> (-1)-->'pre' (local) transform, (0)->'set' transform, (1)-->'post' (parent space)
-    virtual bool modifyRelativeTransform(const matrix4 &crMtxLtoP, int nPosition = 0) { return false; }
+    virtual bool modifyRelativeTransform(const matrix4 & /*crMtxLtoP*/, int /*nPosition*/ = 0) { return false; }
   };
 
   // SALIGN_DECL(16)
@@ -30,6 +30,12 @@ namespace stevesch
     m_v = s.m_v;
   }
 
+  SSPHEREINLINE Sphere &Sphere::operator=(const Sphere &s)
+  {
+    m_v = s.m_v;
+    return *this;
+  }
+
   SSPHEREINLINE void Sphere::set(float x, float y, float z, float fRadius)
   {
     m_v.set(x, y, z, fRadius);
@@ -0,0 +1,171 @@
+#include "MeshBatch.h"
+#include "Geom/Frustum.h"
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    constexpr uint kMaxIndex = 0xffff; // buffers are addressed with (16-bit) index_t
+  }
+
+  FaceMeshBatch::FaceMeshBatch()
+      : mBoundsMin(0.0f, 0.0f, 0.0f), mBoundsMax(0.0f, 0.0f, 0.0f)
+  {
+  }
+
+  void ICACHE_FLASH_ATTR FaceMeshBatch::clear()
+  {
+    mMesh.clear();
+    mPart.clear();
+    mBoundsMin.set(0.0f, 0.0f, 0.0f);
+    mBoundsMax.set(0.0f, 0.0f, 0.0f);
+  }
+
+  void ICACHE_FLASH_ATTR FaceMeshBatch::compactMemory()
+  {
+    mMesh.compactMemory();
+    mPart.shrink_to_fit();
+  }
+
+  uint ICACHE_FLASH_ATTR FaceMeshBatch::add(const FaceMesh &src, const matrix4 &mtxLtoW)
+  {
+    const uint vc = src.positionCount();
+    const uint fc = src.faceCount();
+    const indexBuffer_t &srcIndices = src.getPositionIndices();
+    const uint ic = srcIndices.size();
+
+    const uint vBase = mMesh.positionCount();
+    const uint iBase = mMesh.getPositionIndices().size();
+    if (((vBase + vc) > kMaxIndex) || ((iBase + ic) > kMaxIndex))
+    {
+      return kInvalidPart;
+    }
+#if USE_FACE_NORMALS
+    const uint nBase = mMesh.normalCount();
+    if ((nBase + src.normalCount()) > kMaxIndex)
+    {
+      return kInvalidPart;
+    }
+#endif
+
+    Part part;
+    part.firstPosition = vBase;
+    part.positionCount = vc;
+    part.firstFace = mMesh.faceCount();
+    part.faceCount = fc;
+    part.visible = true;
+
+    // positions
+    vector4 v;
+    for (uint i = 0; i < vc; ++i)
+    {
+      v.set(src.getPosition(i));
+      v.transform(mtxLtoW);
+      mMesh.addPosition(vector3(v.x, v.y, v.z));
+    }
+
+    if (vc > 0)
+    {
+      const positionBuffer_t &positions = mMesh.positions();
+      part.boundsMin = positions[vBase];
+      part.boundsMax = positions[vBase];
+      for (uint i = vBase + 1; i < vBase + vc; ++i)
+      {
+        vector3::min(part.boundsMin, part.boundsMin, positions[i]);
+        vector3::max(part.boundsMax, part.boundsMax, positions[i]);
+      }
+    }
+    else
+    {
+      mtxLtoW.getTranslation(part.boundsMin);
+      part.boundsMax = part.boundsMin;
+    }
+    vector3::add(part.center, part.boundsMin, part.boundsMax);
+    part.center *= 0.5f;
+    vector3 vHalf;
+    vector3::sub(vHalf, part.boundsMax, part.boundsMin);
+    part.radius = 0.5f * vHalf.abs();
+
+    // indices, offset into the combined position buffer
+    indexBuffer_t &indices = mMesh.refPositionIndices();
+    indices.reserve(iBase + ic);
+    for (uint i = 0; i < ic; ++i)
+    {
+      indices.push_back((index_t)(srcIndices[i] + vBase));
+    }
+
+#if USE_FACE_NORMALS
+    // normals transform by the inverse-transpose (correct under non-uniform scale or mirroring)
+    matrix4 mtxWtoL;
+    matrix4::invert(mtxWtoL, mtxLtoW);
+    const uint nc = src.normalCount();
+    for (uint i = 0; i < nc; ++i)
+    {
+      const vector3 &n = src.getNormal(i);
+      const vector4 n4(n.x, n.y, n.z, 0.0f);
+      vector3 nw(mtxWtoL.col[0].dot3(n4), mtxWtoL.col[1].dot3(n4), mtxWtoL.col[2].dot3(n4));
+      nw.normalize();
+      mMesh.addNormal(nw);
+    }
+#endif
+
+    for (uint iface = 0; iface < fc; ++iface)
+    {
+      IndexedFace face = src.getFace(iface);
+#if USE_FACE_NORMALS
+      face.iNormal = (index_t)(face.iNormal + nBase);
+#endif
+      face.iFirst = (index_t)(face.iFirst + iBase);
+      uint iNew = mMesh.addFace(face);
+#if USE_FACE_NORMALS
+      mMesh.updateFacePlane(iNew);
+#endif
+    }
+
+    if (mPart.empty())
+    {
+      mBoundsMin = part.boundsMin;
+      mBoundsMax = part.boundsMax;
+    }
+    else
+    {
+      vector3::min(mBoundsMin, mBoundsMin, part.boundsMin);
+      vector3::max(mBoundsMax, mBoundsMax, part.boundsMax);
+    }
+
+    mPart.push_back(part);
+    return mPart.size() - 1;
+  }
+
+  uint FaceMeshBatch::gatherFaceRanges(std::vector<FaceRange> &ranges, const Frustum *frustum) const
+  {
+    ranges.clear();
+    uint faces = 0;
+    for (const Part &part : mPart)
+    {
+      if (!part.visible || (part.faceCount == 0))
+      {
+        continue;
+      }
+      if (frustum && (SINTERSECT_OUT == frustum->intersection(Sphere(part.center, part.radius))))
+      {
+        continue;
+      }
+
+      if (!ranges.empty() && ((ranges.back().first + ranges.back().count) == part.firstFace))
+      {
+        ranges.back().count += part.faceCount; // adjacent to previous part-- extend
+      }
+      else
+      {
+        ranges.push_back(FaceRange{part.firstFace, part.faceCount});
+      }
+      faces += part.faceCount;
+    }
+    return faces;
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef STEVESCH_RENDER_SMESHBATCH_H_
+#define STEVESCH_RENDER_SMESHBATCH_H_
+
+#include <stevesch-MathVec.h>
+
+#include "FaceMesh.h"
+#include "MeshTypes.h"
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  class Frustum;
+
+  // a contiguous run of faces [first, first + count)
+  struct FaceRange
+  {
+    uint first;
+    uint count;
+  };
+
+  // Static batching: bakes several FaceMeshes, each with its own placement, into one
+  // combined mesh in world space.  Positions are re-indexed, normals are transformed and
+  // remapped, and bounds are merged.  Each source is remembered as a "part" (a range of
+  // positions and faces) so parts can still be hidden or culled individually.
+  //
+  // The combined mesh is limited by 16-bit indices: add() fails (returns kInvalidPart) if
+  // a source would overflow the position, index or normal buffers.
+  class FaceMeshBatch
+  {
+  public:
+    static constexpr uint kInvalidPart = (uint)(-1);
+
+    struct Part
+    {
+      uint firstPosition;
+      uint positionCount;
+      uint firstFace;
+      uint faceCount;
+      stevesch::vector3 boundsMin; // world space
+      stevesch::vector3 boundsMax;
+      stevesch::vector3 center;    // bounding sphere, for culling
+      float radius;
+      bool visible;
+    };
+
+    FaceMeshBatch();
+    ~FaceMeshBatch() {}
+
+    void clear();
+    uint add(const FaceMesh &src, const stevesch::matrix4 &mtxLtoW); // returns part index
+    void compactMemory();
+
+    const FaceMesh &mesh() const { return mMesh; }
+
+    uint partCount() const { return mPart.size(); }
+    const Part &getPart(uint nIndex) const;
+    void setPartVisible(uint nIndex, bool bVisible);
+    bool isPartVisible(uint nIndex) const { return getPart(nIndex).visible; }
+
+    const stevesch::vector3 &boundsMin() const { return mBoundsMin; }
+    const stevesch::vector3 &boundsMax() const { return mBoundsMax; }
+
+    // collect the faces of visible parts (skipping parts outside frustum, if given),
+    // merging adjacent parts into single ranges; returns the number of faces gathered
+    uint gatherFaceRanges(std::vector<FaceRange> &ranges, const Frustum *frustum = nullptr) const;
+
+  protected:
+    FaceMesh mMesh;
+    std::vector<Part> mPart;
+    stevesch::vector3 mBoundsMin;
+    stevesch::vector3 mBoundsMax;
+  };
+
+  inline const FaceMeshBatch::Part &FaceMeshBatch::getPart(uint nIndex) const
+  {
+    SASSERT(nIndex < partCount());
+    return mPart[nIndex];
+  }
+
+  inline void FaceMeshBatch::setPartVisible(uint nIndex, bool bVisible)
+  {
+    SASSERT(nIndex < partCount());
+    mPart[nIndex].visible = bVisible;
+  }
+}
+
+#endif
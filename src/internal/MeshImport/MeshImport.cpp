@@ -13,6 +13,7 @@
 #endif
 
 //#include <c_types.h>
+#include <algorithm>
 #include <set>
 
 #define DEBUG_CLASS Serial
@@ -24,11 +25,21 @@ static int8_t sDebugLevel = 0;
 
 using namespace stevesch;
 
+static MeshImportStats sLastStats;
+
 class MeshImport
 {
   //Tokenizer mLine;
   Tokenizer mWords;
 
+  MeshImportStats mStats;
+  uint32_t mHeapStart;
+  uint32_t mHeapMin;
+  size_t mLastReserved;
+
+  void sampleMemory(const stevesch::FaceMesh &mesh);
+  void sampleHeap();
+
   //static constexpr uint kLineBufLength = 255;
   //char lineBuf[kLineBufLength + 1];
   //void processLine(stevesch::FaceMesh& mesh, uint bytesRead);
@@ -38,6 +49,7 @@ public:
   ICACHE_FLASH_ATTR MeshImport();
 
   bool importObj(stevesch::FaceMesh &mesh, Stream &f);
+  const MeshImportStats &stats() const { return mStats; }
 };
 
 ICACHE_FLASH_ATTR MeshImport::MeshImport()
@@ -48,6 +60,25 @@ ICACHE_FLASH_ATTR MeshImport::MeshImport()
   mWords.setDelimiters(" \t\n\r");
 }
 
+void MeshImport::sampleMemory(const stevesch::FaceMesh &mesh)
+{
+  size_t reserved = mesh.memoryReserved();
+  if (reserved > mLastReserved)
+  {
+    // a buffer grew: its old block was alive alongside the new one (assumes capacity doubling)
+    size_t transient = reserved + (reserved - mLastReserved);
+    mStats.peakBytesTransient = std::max(mStats.peakBytesTransient, transient);
+  }
+  mStats.peakBytesReserved = std::max(mStats.peakBytesReserved, reserved);
+  mStats.peakBytesTransient = std::max(mStats.peakBytesTransient, reserved);
+  mLastReserved = reserved;
+}
+
+void MeshImport::sampleHeap()
+{
+  mHeapMin = std::min(mHeapMin, (uint32_t)ESP.getFreeHeap());
+}
+
 void ICACHE_FLASH_ATTR fixupIndex(int &index, int currentArraySize)
 {
   if (index < 0)
@@ -115,6 +146,7 @@ void ICACHE_FLASH_ATTR MeshImport::processLine(stevesch::FaceMesh &mesh, Stream
         //PlanarFace face;
         IndexedFace face;
         face.iNormal = -1;
+        face.fPlane = 0.0f;
         face.iFirst = posIndex0;
 
         int i0;
@@ -182,49 +214,6 @@ void ICACHE_FLASH_ATTR MeshImport::processLine(stevesch::FaceMesh &mesh, Stream
 }
 
 #if USE_FACE_NORMALS
-bool findGoodNormal(stevesch::vector3 &outNormal, const positionBuffer_t &positions,
-                    const indexBuffer_t::const_iterator &indexBegin,
-                    const indexBuffer_t::const_iterator &indexEnd)
-{
-  vector3 v0, v1, v2;
-  vector3 e1, e2, ncontrib, n;
-
-  //uint vc = indices.size();
-  //uint i = 0;
-  //uint j = 1;
-  //uint k = 2;
-
-  auto i = indexBegin;
-  auto j = i + 1;
-  auto k = j + 1;
-
-  v0 = positions[*i];
-  n.set(0.0f, 0.0f, 0.0f);
-  do
-  {
-    v1 = positions[*j];
-    v2 = positions[*k];
-    vector3::sub(e1, v1, v0);
-    vector3::sub(e2, v2, v0);
-    vector3::cross(ncontrib, e1, e2);
-    n += ncontrib;
-
-    //i = j;
-    j = k;
-    ++k;
-  } while (k != indexEnd);
-
-  if (n.squareMag() > 1.0e-5f)
-  {
-    n.normalize();
-    outNormal = n;
-    return true;
-  }
-
-  outNormal.set(0.0f, 1.0f, 0.0f);
-  return false;
-}
-
 //bool findGoodNormal(stevesch::vector3& outNormal, const positionBuffer_t& positions, const indexBuffer_t& indices)
 //{
 //	vector3 v0, v1, v2;
@@ -265,23 +254,19 @@ bool findGoodNormal(stevesch::vector3 &outNormal, const positionBuffer_t &positi
 
 void ICACHE_FLASH_ATTR indexFaceNormals(stevesch::FaceMesh &mesh)
 {
-  const positionBuffer_t &positions = mesh.positions();
-  const indexBuffer_t &posIndices = mesh.getPositionIndices();
   vector3 faceNormal;
   const uint fc = mesh.faceCount();
 
-  for (int iface = 0; iface < fc; ++iface)
+  for (uint iface = 0; iface < fc; ++iface)
   {
     //PlanarFace& face = mesh.refFace(iface);
     IndexedFace &face = mesh.refFace(iface);
     //if (!findGoodNormal(faceNormal, positions, face.iPosition))
-    auto i0 = posIndices.begin() + face.iFirst;
-    auto i1 = i0 + face.iCount;
-    if (!findGoodNormal(faceNormal, positions, i0, i1))
+    if (!mesh.computeFaceNormal(faceNormal, face))
     {
       if (sDebugLevel > 0)
       {
-        DEBUG_CLASS.printf("WARNING: Using failsafe face normal for face %d (possible degenerate face)\n", iface);
+        DEBUG_CLASS.printf("WARNING: Using failsafe face normal for face %u (possible degenerate face)\n", iface);
       }
     }
 
@@ -295,6 +280,7 @@ void ICACHE_FLASH_ATTR indexFaceNormals(stevesch::FaceMesh &mesh)
     // 	DEBUG_CLASS.printf("Reusing normal %d for face %d\n", in, iface);
     // }
     face.iNormal = in;
+    mesh.updateFacePlane(iface);
     //DEBUG_CLASS.printf("Face[%d] n=[%d] (%5.2f, %5.2f, %5.2f)\n", iface, in, mesh.getNormal(in).x, mesh.getNormal(in).y, mesh.getNormal(in).z);
   }
 }
@@ -304,6 +290,9 @@ bool ICACHE_FLASH_ATTR MeshImport::importObj(stevesch::FaceMesh &mesh, Stream &f
 {
   int numLinesProcessed = 0;
   long t0 = micros();
+  mStats = MeshImportStats();
+  mHeapStart = mHeapMin = ESP.getFreeHeap();
+  mLastReserved = mesh.memoryReserved();
   long lastYield = t0;
   constexpr long kForceYieldTime = 1000;
   while (f.available() > 0)
@@ -312,11 +301,13 @@ bool ICACHE_FLASH_ATTR MeshImport::importObj(stevesch::FaceMesh &mesh, Stream &f
     //lineBuf[bytesRead] = '\0';
     //processLine(mesh, bytesRead);
     processLine(mesh, f);
+    sampleMemory(mesh);
 
     ++numLinesProcessed;
     long now = micros();
     if ((now - lastYield) > kForceYieldTime)
     {
+      sampleHeap();
       if (sDebugLevel > 0)
       {
         DEBUG_CLASS.printf("  processed %d lines (%d verts, "
@@ -338,10 +329,14 @@ bool ICACHE_FLASH_ATTR MeshImport::importObj(stevesch::FaceMesh &mesh, Stream &f
     }
   }
 
+  sampleHeap();
   mesh.compactMemory();
 
 #if USE_FACE_NORMALS
+  mLastReserved = mesh.memoryReserved();
   indexFaceNormals(mesh);
+  sampleMemory(mesh);
+  sampleHeap();
   if (sDebugLevel > 0)
   {
     DEBUG_CLASS.printf("Indexed %d face normals\n", mesh.normalCount());
@@ -350,6 +345,11 @@ bool ICACHE_FLASH_ATTR MeshImport::importObj(stevesch::FaceMesh &mesh, Stream &f
 
   mesh.compactMemory();
 
+  mStats.lines = numLinesProcessed;
+  mStats.finalBytesReserved = mesh.memoryReserved();
+  mStats.peakHeapUsed = mHeapStart - mHeapMin;
+  mStats.micros = (uint32_t)(micros() - t0);
+
   bool bSuccess = true;
   return bSuccess;
 }
@@ -366,6 +366,11 @@ namespace stevesch
     return sDebugLevel;
   }
 
+  const MeshImportStats &meshImportLastStats()
+  {
+    return sLastStats;
+  }
+
   bool ICACHE_FLASH_ATTR importObj(stevesch::FaceMesh &mesh, const char *path)
   {
     bool bOk = false;
@@ -378,6 +383,7 @@ namespace stevesch
       MeshImport importer;
       File f = SPIFFS.open(path, "r");
       bOk = importer.importObj(mesh, f);
+      sLastStats = importer.stats();
       DEBUG_CLASS.printf("Model load success: <%s>\n", (bOk ? "true" : "false"));
       DEBUG_CLASS.printf("vertex count: %d\n", mesh.positionCount());
       DEBUG_CLASS.printf("face count: %d\n", mesh.faceCount());
@@ -399,6 +405,7 @@ namespace stevesch
 
     MeshImport importer;
     bOk = importer.importObj(mesh, s);
+    sLastStats = importer.stats();
     DEBUG_CLASS.printf("Model load success: <%s>\n", (bOk ? "true" : "false"));
     DEBUG_CLASS.printf("vertex count: %d\n", mesh.positionCount());
     DEBUG_CLASS.printf("face count: %d\n", mesh.faceCount());
@@ -406,4 +413,110 @@ namespace stevesch
     return bOk;
   }
 
+  bool ICACHE_FLASH_ATTR estimateObjMemory(MeshMemoryEstimate &estimate, Stream &s)
+  {
+    estimate = MeshMemoryEstimate();
+
+    // count 'v' lines, and 'f' lines with the number of index tokens on each
+    enum
+    {
+      kTag,
+      kVertex,
+      kFace,
+      kSkip
+    } state = kTag;
+    char tag0 = 0;
+    uint tagLength = 0;
+    uint tokens = 0;
+    bool bInToken = false;
+
+    long lastYield = micros();
+    int c;
+    do
+    {
+      c = s.read();
+      if ((c < 0) || (c == '\n') || (c == '\r'))
+      {
+        if (state == kVertex)
+        {
+          ++estimate.positions;
+        }
+        else if ((state == kFace) && (tokens > 2))
+        {
+          ++estimate.faces;
+          estimate.indices += tokens;
+        }
+        state = kTag;
+        tagLength = 0;
+
+        long now = micros();
+        if ((now - lastYield) > 1000)
+        {
+          yield();
+          lastYield = micros();
+        }
+        continue;
+      }
+
+      const bool bSpace = (c == ' ') || (c == '\t');
+      if (state == kTag)
+      {
+        if (!bSpace)
+        {
+          tag0 = (tagLength == 0) ? (char)c : tag0;
+          ++tagLength;
+        }
+        else if (tagLength > 0)
+        {
+          state = (tagLength != 1) ? kSkip : (tag0 == 'v') ? kVertex : (tag0 == 'f') ? kFace : kSkip;
+          tokens = 0;
+          bInToken = false;
+        }
+      }
+      else if (state == kFace)
+      {
+        if (!bSpace && !bInToken)
+        {
+          ++tokens;
+        }
+        bInToken = !bSpace;
+      }
+    } while (c >= 0);
+
+    // assumes every face gets its own normal
+    const size_t positionBytes = FaceMesh::estimateMemory(estimate.positions, 0, 0, 0);
+    const size_t indexBytes = FaceMesh::estimateMemory(0, estimate.indices, 0, 0);
+    const size_t faceBytes = FaceMesh::estimateMemory(0, 0, estimate.faces, 0);
+    const size_t normalBytes = FaceMesh::estimateMemory(0, 0, 0, estimate.faces);
+    estimate.finalBytes = positionBytes + indexBytes + faceBytes + normalBytes;
+
+    // a vector growing by doubling briefly holds up to 3x its final size (old + new blocks);
+    // positions are compacted before faces are read, and faces before normals are indexed
+    size_t peakVerts = 3 * positionBytes;
+    size_t peakFaces = positionBytes + 2 * (indexBytes + faceBytes) + std::max(indexBytes, faceBytes);
+    size_t peakNormals = positionBytes + indexBytes + faceBytes + 3 * normalBytes;
+    estimate.peakBytes = std::max(peakVerts, std::max(peakFaces, peakNormals));
+
+    return (estimate.positions > 0) && (estimate.faces > 0);
+  }
+
+  bool ICACHE_FLASH_ATTR estimateObjMemory(MeshMemoryEstimate &estimate, const char *path)
+  {
+    bool bOk = false;
+    estimate = MeshMemoryEstimate();
+
+#if HAVE_SPIFFS
+    SPIFFS.begin();
+    File f = SPIFFS.open(path, "r");
+    if (f)
+    {
+      bOk = estimateObjMemory(estimate, f);
+      f.close();
+    }
+    SPIFFS.end();
+    yield();
+#endif
+
+    return bOk;
+  }
 }
@@ -1,14 +1,44 @@
 #ifndef STEVESCH_RENDER_MESHIMPORT_MESHIMPORT_H_
 #define STEVESCH_RENDER_MESHIMPORT_MESHIMPORT_H_
 
+#include <stdint.h>
+#include <stddef.h>
+
 class Stream;
 
 namespace stevesch
 {
   class FaceMesh;
 
+  // memory and timing of the most recent importObj() call
+  struct MeshImportStats
+  {
+    uint32_t lines;
+    size_t peakBytesReserved;  // highest mesh buffer capacity (in bytes) reached while importing
+    size_t peakBytesTransient; // peak including the old buffer still held while a vector grows
+    size_t finalBytesReserved; // after the final compactMemory()
+    uint32_t peakHeapUsed;     // drop in free heap from the start of import to its lowest sampled point
+    uint32_t micros;
+  };
+
+  // sizes counted by a quick pre-scan of an .obj file (see estimateObjMemory)
+  struct MeshMemoryEstimate
+  {
+    uint32_t positions;
+    uint32_t indices;
+    uint32_t faces;
+    size_t finalBytes; // compacted mesh (assumes no face normals are shared)
+    size_t peakBytes;  // conservative bound on buffer memory needed during import
+  };
+
   bool importObj(FaceMesh &mesh, const char *path);
   bool importObj(FaceMesh &mesh, Stream &s);
+  const MeshImportStats &meshImportLastStats();
+
+  // scan an .obj without building a mesh, so a memory budget can be checked before loading
+  bool estimateObjMemory(MeshMemoryEstimate &estimate, const char *path);
+  bool estimateObjMemory(MeshMemoryEstimate &estimate, Stream &s);
+
   int8_t meshImportDebugLevel(int8_t level = -1);
 }
 
@@ -0,0 +1,147 @@
+#include "MeshLod.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  uint ICACHE_FLASH_ATTR buildClusteredMesh(FaceMesh &dst, const FaceMesh &src, uint cells)
+  {
+    dst.clear();
+    const uint vc = src.positionCount();
+    if ((vc == 0) || (cells == 0))
+    {
+      return 0;
+    }
+
+    vector3 vmin, vmax, vsize;
+    src.computeExtents(vmin, vmax);
+    vector3::sub(vsize, vmax, vmin);
+    const float extent = std::max(vsize.x, std::max(vsize.y, vsize.z));
+    const float invCell = (extent > 0.0f) ? ((float)cells / extent) : 0.0f;
+    const uint32_t gridSize = cells + 1; // (positions on the max faces land in one more cell)
+
+    // cell of each position, and the running sum of each cell's positions
+    std::unordered_map<uint32_t, index_t> cellIndex;
+    std::vector<index_t> remap(vc);
+    std::vector<vector3> sums;
+    std::vector<uint> counts;
+    for (uint i = 0; i < vc; ++i)
+    {
+      const vector3 &v = src.getPosition(i);
+      const uint32_t ix = (uint32_t)((v.x - vmin.x) * invCell);
+      const uint32_t iy = (uint32_t)((v.y - vmin.y) * invCell);
+      const uint32_t iz = (uint32_t)((v.z - vmin.z) * invCell);
+      const uint32_t key = ix + gridSize * (iy + gridSize * iz);
+      auto found = cellIndex.find(key);
+      if (found == cellIndex.end())
+      {
+        found = cellIndex.emplace(key, (index_t)sums.size()).first;
+        sums.push_back(vector3(0.0f, 0.0f, 0.0f));
+        counts.push_back(0);
+      }
+      remap[i] = found->second;
+      sums[found->second] += v;
+      ++counts[found->second];
+    }
+    for (uint i = 0; i < sums.size(); ++i)
+    {
+      vector3 v(sums[i]);
+      v *= 1.0f / (float)counts[i];
+      dst.addPosition(v);
+    }
+
+    indexBuffer_t &indices = dst.refPositionIndices();
+    const indexBuffer_t &srcIndices = src.getPositionIndices();
+    const uint fc = src.faceCount();
+    for (uint iface = 0; iface < fc; ++iface)
+    {
+      const IndexedFace &srcFace = src.getFace(iface);
+      IndexedFace face = srcFace;
+      face.iFirst = (index_t)indices.size();
+      for (uint j = 0; j < srcFace.iCount; ++j)
+      {
+        const index_t index = remap[srcIndices[srcFace.iFirst + j]];
+        if ((indices.size() == face.iFirst) || (indices.back() != index))
+        {
+          indices.push_back(index);
+        }
+      }
+      while (((indices.size() - face.iFirst) > 1) && (indices.back() == indices[face.iFirst]))
+      {
+        indices.pop_back(); // (the loop closes on its first corner)
+      }
+      face.iCount = (std::uint16_t)(indices.size() - face.iFirst);
+      if (face.iCount < 3)
+      {
+        indices.resize(face.iFirst);
+        continue;
+      }
+
+#if USE_FACE_NORMALS
+      vector3 n;
+      if (!dst.computeFaceNormal(n, face))
+      {
+        indices.resize(face.iFirst); // (collapsed to a sliver)
+        continue;
+      }
+      index_t in = dst.findMatchingNormal(n);
+      if ((index_t)(-1) == in)
+      {
+        in = dst.addNormal(n);
+      }
+      face.iNormal = in;
+#endif
+      const uint iNew = dst.addFace(face);
+#if USE_FACE_NORMALS
+      dst.updateFacePlane(iNew);
+#else
+      (void)iNew;
+#endif
+    }
+
+    dst.compactMemory();
+    return dst.faceCount();
+  }
+
+  void ICACHE_FLASH_ATTR FaceMeshLod::build(const FaceMesh &src, uint levels, uint firstCells)
+  {
+    clear();
+    mSource = &src;
+    mLevels.reserve(levels);
+    uint faces = src.faceCount();
+    uint cells = firstCells;
+    for (uint i = 1; (i < levels) && (cells >= 1); ++i)
+    {
+      FaceMesh lod;
+      const uint lodFaces = buildClusteredMesh(lod, src, cells);
+      if ((lodFaces == 0) || (lodFaces >= faces))
+      {
+        break;
+      }
+      mLevels.push_back(lod);
+      faces = lodFaces;
+      cells /= 2;
+    }
+  }
+
+  void FaceMeshLod::clear()
+  {
+    mSource = nullptr;
+    mLevels.clear();
+  }
+
+  const FaceMesh &FaceMeshLod::level(uint nIndex) const
+  {
+    SASSERT(mSource);
+    if ((nIndex == 0) || mLevels.empty())
+    {
+      return *mSource;
+    }
+    return mLevels[std::min(nIndex, (uint)mLevels.size()) - 1];
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef STEVESCH_RENDER_SMESHLOD_H_
+#define STEVESCH_RENDER_SMESHLOD_H_
+
+#include <stevesch-MathVec.h>
+
+#include "FaceMesh.h"
+#include "MeshTypes.h"
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  // Vertex-clustering simplification: positions are snapped to a grid of cells (cells along
+  // the mesh's longest axis) and each cell's positions merge into their average.  Faces keep
+  // their remapped corners, less repeats; faces left with fewer than three corners (or no
+  // area) are dropped, and normals and planes are recomputed.  Returns dst's face count.
+  uint buildClusteredMesh(FaceMesh &dst, const FaceMesh &src, uint cells);
+
+  // Levels of detail of one mesh: level 0 is the source itself (referenced, not copied), and
+  // each further level is clustered on a grid half as fine as the one before.  Levels that
+  // no longer reduce the face count aren't kept, so levelCount() may be less than requested.
+  class FaceMeshLod
+  {
+  public:
+    FaceMeshLod() : mSource(nullptr) {}
+    ~FaceMeshLod() {}
+
+    // (firstCells: grid of level 1; src must outlive this, or be rebuilt with it)
+    void build(const FaceMesh &src, uint levels, uint firstCells = 32);
+    void clear();
+
+    uint levelCount() const { return mSource ? (1 + (uint)mLevels.size()) : 0; }
+    // the given level, or the coarsest there is
+    const FaceMesh &level(uint nIndex) const;
+
+  protected:
+    const FaceMesh *mSource;
+    std::vector<FaceMesh> mLevels; // (levels 1 and up)
+  };
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include "MeshMemory.h"
+#include "FaceMesh.h"
+#include "WireMesh.h"
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  void MeshMemoryReport::clear()
+  {
+    bufferCount = 0;
+    meshCount = 0;
+    bytesUsed = 0;
+    bytesReserved = 0;
+    overhead = 0;
+  }
+
+  void MeshMemoryReport::accumulate(const MeshMemoryReport &other)
+  {
+    meshCount += other.meshCount;
+    bytesUsed += other.bytesUsed;
+    bytesReserved += other.bytesReserved;
+    overhead += other.overhead;
+  }
+
+  void ICACHE_FLASH_ATTR liveMeshMemory(MeshMemoryReport &faceMeshTotals, MeshMemoryReport &wireMeshTotals)
+  {
+    MeshMemoryReport report;
+
+    faceMeshTotals.clear();
+    for (const FaceMesh *mesh = FaceMesh::firstLive(); mesh; mesh = mesh->nextLive())
+    {
+      mesh->memoryReport(report);
+      report.overhead += sizeof(FaceMesh);
+      faceMeshTotals.accumulate(report);
+    }
+
+    wireMeshTotals.clear();
+    for (const WireMesh *mesh = WireMesh::firstLive(); mesh; mesh = mesh->nextLive())
+    {
+      mesh->memoryReport(report);
+      report.overhead += sizeof(WireMesh);
+      wireMeshTotals.accumulate(report);
+    }
+  }
+}
@@ -0,0 +1,128 @@
+#ifndef STEVESCH_RENDER_SMESHMEMORY_H_
+#define STEVESCH_RENDER_SMESHMEMORY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace stevesch
+{
+  // approximate bookkeeping cost of one heap allocation (ESP-IDF multi_heap block header)
+  constexpr size_t kHeapBlockOverhead = 8;
+
+  // memory held by a single buffer of a mesh
+  struct BufferMemoryInfo
+  {
+    const char *name;
+    size_t count;         // elements in use
+    size_t capacity;      // elements allocated
+    size_t elementSize;   // bytes per element
+    size_t bytesUsed;     // count * elementSize
+    size_t bytesReserved; // capacity * elementSize
+    size_t overhead;      // heap block header (the vector object itself is counted with its mesh)
+
+    size_t bytesWasted() const { return bytesReserved - bytesUsed; }
+  };
+
+  // per-buffer breakdown for one mesh (or running totals over several meshes)
+  struct MeshMemoryReport
+  {
+    static constexpr unsigned int kMaxBuffers = 8;
+
+    BufferMemoryInfo buffer[kMaxBuffers];
+    unsigned int bufferCount;
+    unsigned int meshCount;
+
+    size_t bytesUsed;
+    size_t bytesReserved;
+    size_t overhead;
+
+    MeshMemoryReport() { clear(); }
+    void clear();
+
+    template <typename T>
+    void addBuffer(const char *name, const std::vector<T> &v);
+
+    void accumulate(const MeshMemoryReport &other); // add another report's totals to ours
+
+    size_t bytesWasted() const { return bytesReserved - bytesUsed; }
+    size_t bytesTotal() const { return bytesReserved + overhead; }
+  };
+
+  // Intrusive list of live instances of T, so memory can be totalled across all meshes.
+  // (Not thread-safe: create and destroy meshes from one task.)
+  template <class T>
+  class LiveMeshList
+  {
+  public:
+    static T *firstLive() { return sFirstLive; }
+    T *nextLive() const { return mNextLive; }
+
+  protected:
+    LiveMeshList() { link(); }
+    LiveMeshList(const LiveMeshList &) { link(); }
+    LiveMeshList &operator=(const LiveMeshList &) { return *this; } // keep our own linkage
+    ~LiveMeshList() { unlink(); }
+
+  private:
+    T *mNextLive;
+    T *mPrevLive;
+    static T *sFirstLive;
+
+    void link()
+    {
+      mPrevLive = nullptr;
+      mNextLive = sFirstLive;
+      if (sFirstLive)
+      {
+        static_cast<LiveMeshList *>(sFirstLive)->mPrevLive = static_cast<T *>(this);
+      }
+      sFirstLive = static_cast<T *>(this);
+    }
+
+    void unlink()
+    {
+      if (mPrevLive)
+      {
+        static_cast<LiveMeshList *>(mPrevLive)->mNextLive = mNextLive;
+      }
+      else
+      {
+        sFirstLive = mNextLive;
+      }
+      if (mNextLive)
+      {
+        static_cast<LiveMeshList *>(mNextLive)->mPrevLive = mPrevLive;
+      }
+    }
+  };
+
+  template <class T>
+  T *LiveMeshList<T>::sFirstLive = nullptr;
+
+  template <typename T>
+  void MeshMemoryReport::addBuffer(const char *name, const std::vector<T> &v)
+  {
+    BufferMemoryInfo info;
+    info.name = name;
+    info.count = v.size();
+    info.capacity = v.capacity();
+    info.elementSize = sizeof(T);
+    info.bytesUsed = info.count * info.elementSize;
+    info.bytesReserved = info.capacity * info.elementSize;
+    info.overhead = (info.capacity > 0) ? kHeapBlockOverhead : 0;
+
+    if (bufferCount < kMaxBuffers)
+    {
+      buffer[bufferCount++] = info;
+    }
+    bytesUsed += info.bytesUsed;
+    bytesReserved += info.bytesReserved;
+    overhead += info.overhead;
+  }
+
+  // totals over every live FaceMesh and WireMesh (overhead includes the mesh objects themselves)
+  void liveMeshMemory(MeshMemoryReport &faceMeshTotals, MeshMemoryReport &wireMeshTotals);
+}
+
+#endif
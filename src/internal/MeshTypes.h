@@ -33,6 +33,7 @@ namespace stevesch
   {
 #if USE_FACE_NORMALS
     index_t iNormal; // single normal per face
+    float fPlane;    // plane distance (normal . vertex 0): faces an eye e when (normal . e) > fPlane
 #endif
     index_t iFirst;       // first vertex index in index buffer
     std::uint16_t iCount; // number of indices used in index buffer
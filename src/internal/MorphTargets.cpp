@@ -0,0 +1,233 @@
+#include "MorphTargets.h"
+#include "FaceMesh.h"
+#include "FaceMeshDeformer.h"
+
+#include <algorithm>
+#include <iterator>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  FaceMeshMorpher::FaceMeshMorpher() : mDeformer(nullptr), mStamp(0)
+  {
+  }
+
+  void ICACHE_FLASH_ATTR FaceMeshMorpher::attach(FaceMeshDeformer &deformer)
+  {
+    SASSERT(deformer.isAttached());
+    detach();
+    mDeformer = &deformer;
+  }
+
+  void ICACHE_FLASH_ATTR FaceMeshMorpher::detach()
+  {
+    mDeformer = nullptr;
+    mTarget.clear();
+    mAffected.clear();
+    mBase.clear();
+    mScratch.clear();
+    mSlotStamp.clear();
+    mEvalSlot.clear();
+    mStamp = 0;
+  }
+
+  size_t FaceMeshMorpher::memoryBytes() const
+  {
+    size_t bytes = mTarget.capacity() * sizeof(Target);
+    for (const Target &t : mTarget)
+    {
+      bytes += t.mSlot.capacity() * sizeof(index_t) + t.mDelta.capacity() * sizeof(vector3);
+    }
+    bytes += mAffected.capacity() * sizeof(index_t);
+    bytes += (mBase.capacity() + mScratch.capacity()) * sizeof(vector3);
+    bytes += mSlotStamp.capacity() * sizeof(std::uint32_t);
+    bytes += mEvalSlot.capacity() * sizeof(index_t);
+    return bytes;
+  }
+
+  void ICACHE_FLASH_ATTR FaceMeshMorpher::mergeAffected(const indexBuffer_t &sortedIndices)
+  {
+    const FaceMesh &mesh = *mDeformer->mesh();
+
+    indexBuffer_t merged;
+    merged.reserve(mAffected.size() + sortedIndices.size());
+    std::set_union(mAffected.begin(), mAffected.end(), sortedIndices.begin(), sortedIndices.end(),
+                   std::back_inserter(merged));
+    if (merged.size() == mAffected.size())
+    {
+      return; // nothing new
+    }
+
+    // positions not yet affected by any target are still at their base pose
+    positionBuffer_t base(merged.size());
+    indexBuffer_t remap(mAffected.size());
+    uint iOld = 0;
+    for (uint slot = 0; slot < merged.size(); ++slot)
+    {
+      if ((iOld < mAffected.size()) && (mAffected[iOld] == merged[slot]))
+      {
+        base[slot] = mBase[iOld];
+        remap[iOld] = slot;
+        ++iOld;
+      }
+      else
+      {
+        base[slot] = mesh.getPosition(merged[slot]);
+      }
+    }
+
+    for (Target &t : mTarget)
+    {
+      for (index_t &slot : t.mSlot)
+      {
+        slot = remap[slot];
+      }
+    }
+
+    mAffected.swap(merged);
+    mBase.swap(base);
+    mScratch.resize(mAffected.size());
+    mSlotStamp.resize(mAffected.size(), 0);
+    mAffected.shrink_to_fit();
+  }
+
+  uint ICACHE_FLASH_ATTR FaceMeshMorpher::addTarget(const index_t *indices, const vector3 *deltas, uint count)
+  {
+    SASSERT(isAttached());
+
+    // sort deltas by position index
+    std::vector<uint> order(count);
+    for (uint i = 0; i < count; ++i)
+    {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [indices](uint a, uint b) { return indices[a] < indices[b]; });
+
+    indexBuffer_t sorted;
+    sorted.reserve(count);
+    for (uint i : order)
+    {
+      if (sorted.empty() || (sorted.back() != indices[i]))
+      {
+        sorted.push_back(indices[i]);
+      }
+    }
+    mergeAffected(sorted);
+
+    mTarget.emplace_back();
+    Target &t = mTarget.back();
+    t.mWeight = 0.0f;
+    t.mAppliedWeight = 0.0f;
+    t.mSlot.reserve(sorted.size());
+    t.mDelta.reserve(sorted.size());
+    for (uint i : order)
+    {
+      index_t slot = std::lower_bound(mAffected.begin(), mAffected.end(), indices[i]) - mAffected.begin();
+      if (!t.mSlot.empty() && (t.mSlot.back() == slot))
+      {
+        t.mDelta.back() += deltas[i]; // repeated index-- combine
+      }
+      else
+      {
+        t.mSlot.push_back(slot);
+        t.mDelta.push_back(deltas[i]);
+      }
+    }
+    return mTarget.size() - 1;
+  }
+
+  uint ICACHE_FLASH_ATTR FaceMeshMorpher::addTargetFromPositions(const positionBuffer_t &targetPositions, float fEpsilon)
+  {
+    SASSERT(isAttached());
+    const FaceMesh &mesh = *mDeformer->mesh();
+    const uint vc = std::min((uint)targetPositions.size(), mesh.positionCount());
+    const float eps2 = fEpsilon * fEpsilon;
+
+    indexBuffer_t indices;
+    positionBuffer_t deltas;
+    for (uint i = 0; i < vc; ++i)
+    {
+      auto it = std::lower_bound(mAffected.begin(), mAffected.end(), (index_t)i);
+      bool bAffected = (it != mAffected.end()) && (*it == i);
+      const vector3 &base = bAffected ? mBase[it - mAffected.begin()] : mesh.getPosition(i);
+
+      vector3 d;
+      vector3::sub(d, targetPositions[i], base);
+      if (d.squareMag() > eps2)
+      {
+        indices.push_back(i);
+        deltas.push_back(d);
+      }
+    }
+
+    return addTarget(indices.empty() ? nullptr : &indices[0], deltas.empty() ? nullptr : &deltas[0], indices.size());
+  }
+
+  uint FaceMeshMorpher::apply()
+  {
+    if (!isAttached())
+    {
+      return 0;
+    }
+
+    // slots to re-evaluate: everything moved by a target whose weight changed
+    ++mStamp;
+    mEvalSlot.clear();
+    for (const Target &t : mTarget)
+    {
+      if (t.mWeight != t.mAppliedWeight)
+      {
+        for (index_t slot : t.mSlot)
+        {
+          if (mSlotStamp[slot] != mStamp)
+          {
+            mSlotStamp[slot] = mStamp;
+            mEvalSlot.push_back(slot);
+          }
+        }
+      }
+    }
+
+    if (mEvalSlot.empty())
+    {
+      return 0;
+    }
+
+    for (index_t slot : mEvalSlot)
+    {
+      mScratch[slot] = mBase[slot];
+    }
+
+    // single accumulation pass over all weighted targets
+    for (Target &t : mTarget)
+    {
+      const float w = t.mWeight;
+      t.mAppliedWeight = w;
+      if (w == 0.0f)
+      {
+        continue;
+      }
+
+      const uint dc = t.mSlot.size();
+      for (uint k = 0; k < dc; ++k)
+      {
+        index_t slot = t.mSlot[k];
+        if (mSlotStamp[slot] == mStamp)
+        {
+          vector3::addScaled(mScratch[slot], mScratch[slot], t.mDelta[k], w);
+        }
+      }
+    }
+
+    for (index_t slot : mEvalSlot)
+    {
+      mDeformer->setPosition(mAffected[slot], mScratch[slot]);
+    }
+    mDeformer->update();
+
+    return mEvalSlot.size();
+  }
+}
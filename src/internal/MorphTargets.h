@@ -0,0 +1,95 @@
+#ifndef STEVESCH_RENDER_SMORPHTARGETS_H_
+#define STEVESCH_RENDER_SMORPHTARGETS_H_
+
+#include <stevesch-vector3.h>
+
+#include "MeshTypes.h"
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  class FaceMeshDeformer;
+
+  // Morph target (blend shape) animation for a FaceMesh.
+  //
+  // Each target stores sparse position deltas: only the positions it moves, so memory per
+  // target scales with the number of changed positions rather than the mesh size.
+  // Positions are addressed through "slots"-- indices into the sorted union of all
+  // positions touched by any target-- so the base pose is only kept for those positions.
+  //
+  // apply() re-evaluates only the slots of targets whose weights changed, accumulating all
+  // weighted targets in one pass into a scratch buffer, then writes the results through a
+  // FaceMeshDeformer so only faces using those positions get their normals refreshed.
+  class FaceMeshMorpher
+  {
+  public:
+    FaceMeshMorpher();
+    ~FaceMeshMorpher() {}
+
+    // the deformer must already be attached to the mesh being animated
+    void attach(FaceMeshDeformer &deformer);
+    void detach(); // (does not restore the base pose-- set all weights to 0 and apply() first)
+
+    bool isAttached() const { return nullptr != mDeformer; }
+
+    // add a target from sparse (position index, delta) pairs; returns target index
+    uint addTarget(const index_t *indices, const stevesch::vector3 *deltas, uint count);
+    // add a target from a full set of positions, keeping only those further than fEpsilon from the base
+    uint addTargetFromPositions(const positionBuffer_t &targetPositions, float fEpsilon = 1.0e-5f);
+
+    uint targetCount() const { return mTarget.size(); }
+    uint targetDeltaCount(uint nTarget) const;
+
+    void setWeight(uint nTarget, float w);
+    float getWeight(uint nTarget) const;
+
+    // evaluate the blend and write changed positions; returns number of positions written
+    uint apply();
+
+    uint affectedCount() const { return mAffected.size(); }
+    size_t memoryBytes() const;
+
+  protected:
+    struct Target
+    {
+      indexBuffer_t mSlot;      // slots (into mAffected) moved by this target, ascending
+      positionBuffer_t mDelta;  // delta per slot
+      float mWeight;
+      float mAppliedWeight;     // weight at last apply()
+    };
+
+    FaceMeshDeformer *mDeformer;
+    std::vector<Target> mTarget;
+
+    indexBuffer_t mAffected;    // sorted position indices touched by any target
+    positionBuffer_t mBase;     // base pose, per slot
+    positionBuffer_t mScratch;  // blended result, per slot
+
+    std::uint32_t mStamp;
+    std::vector<std::uint32_t> mSlotStamp;
+    indexBuffer_t mEvalSlot;    // slots being re-evaluated by apply()
+
+    void mergeAffected(const indexBuffer_t &sortedIndices);
+  };
+
+  inline uint FaceMeshMorpher::targetDeltaCount(uint nTarget) const
+  {
+    SASSERT(nTarget < targetCount());
+    return mTarget[nTarget].mSlot.size();
+  }
+
+  inline void FaceMeshMorpher::setWeight(uint nTarget, float w)
+  {
+    SASSERT(nTarget < targetCount());
+    mTarget[nTarget].mWeight = w;
+  }
+
+  inline float FaceMeshMorpher::getWeight(uint nTarget) const
+  {
+    SASSERT(nTarget < targetCount());
+    return mTarget[nTarget].mWeight;
+  }
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include "AsyncPresenter.h"
+#include "FrameTiming.h"
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+#if MESH_ASYNC_PRESENT_FREERTOS
+    constexpr uint32_t kWorkerStackBytes = 4096;
+    constexpr UBaseType_t kWorkerPriority = 2; // above the Arduino loop task
+
+    inline void waitBriefly() { taskYIELD(); }
+#else
+    inline void waitBriefly() { std::this_thread::yield(); }
+#endif
+  }
+
+  AsyncPresenter::AsyncPresenter(int16_t width, int16_t height, FrameSink *sink)
+      : mFrames{{width, height}, {width, height}}, mSink(sink), mBack(0), mSubmitTime{0, 0}, mPending(-1),
+        mBusy{{false}, {false}}, mRunning(false), mStopRequested(false), mFramesPresented(0), mLatencyTotal(0),
+        mPresentTotal(0)
+#if MESH_ASYNC_PRESENT_FREERTOS
+        ,
+        mTask(nullptr)
+#endif
+  {
+  }
+
+  AsyncPresenter::~AsyncPresenter()
+  {
+    stop();
+  }
+
+  bool ICACHE_FLASH_ATTR AsyncPresenter::start(int core)
+  {
+    if (mRunning.load())
+    {
+      return true;
+    }
+    mStopRequested.store(false);
+    mRunning.store(true);
+#if MESH_ASYNC_PRESENT_FREERTOS
+    if (xTaskCreatePinnedToCore(workerEntry, "present", kWorkerStackBytes, this, kWorkerPriority, &mTask, core) != pdPASS)
+    {
+      mTask = nullptr;
+      mRunning.store(false);
+      return false;
+    }
+#else
+    (void)core;
+    mThread = std::thread([this]() { workerLoop(); });
+#endif
+    return true;
+  }
+
+  void ICACHE_FLASH_ATTR AsyncPresenter::stop()
+  {
+    if (!mRunning.load())
+    {
+      return;
+    }
+    waitIdle();
+    mStopRequested.store(true);
+#if MESH_ASYNC_PRESENT_FREERTOS
+    xTaskNotifyGive(mTask);
+    while (mRunning.load())
+    {
+      waitBriefly();
+    }
+    mTask = nullptr;
+#else
+    wakeWorker();
+    mThread.join();
+#endif
+  }
+
+  FrameBuffer565 &AsyncPresenter::beginFrame()
+  {
+    while (mBusy[mBack].load(std::memory_order_acquire))
+    {
+      waitBriefly(); // the worker is still presenting this buffer
+    }
+    return mFrames[mBack];
+  }
+
+  void AsyncPresenter::submit()
+  {
+    const int index = (int)mBack;
+    mBack ^= 1;
+    mSubmitTime[index] = nowMicros();
+    mBusy[index].store(true, std::memory_order_relaxed);
+
+    if (!mRunning.load())
+    {
+      present(index);
+      return;
+    }
+
+    // (one frame in flight at most: wait for the worker to take the previous one)
+    while (mPending.load(std::memory_order_acquire) >= 0)
+    {
+      waitBriefly();
+    }
+    mPending.store(index, std::memory_order_release);
+#if MESH_ASYNC_PRESENT_FREERTOS
+    xTaskNotifyGive(mTask);
+#else
+    wakeWorker();
+#endif
+  }
+
+  void AsyncPresenter::waitIdle()
+  {
+    while (mBusy[0].load(std::memory_order_acquire) || mBusy[1].load(std::memory_order_acquire))
+    {
+      waitBriefly();
+    }
+  }
+
+  void AsyncPresenter::present(int index)
+  {
+    const uint32_t t0 = nowMicros();
+    if (mSink)
+    {
+      mSink->presentFrame(mFrames[index]);
+    }
+    mFrames[index].present();
+    const uint32_t t1 = nowMicros();
+
+    mPresentTotal.fetch_add(t1 - t0, std::memory_order_relaxed);
+    mLatencyTotal.fetch_add(t1 - mSubmitTime[index], std::memory_order_relaxed);
+    mFramesPresented.fetch_add(1, std::memory_order_relaxed);
+    mBusy[index].store(false, std::memory_order_release);
+  }
+
+  void AsyncPresenter::workerLoop()
+  {
+    for (;;)
+    {
+      const int index = mPending.exchange(-1, std::memory_order_acquire);
+      if (index >= 0)
+      {
+        present(index);
+        continue;
+      }
+      if (mStopRequested.load())
+      {
+        break;
+      }
+#if MESH_ASYNC_PRESENT_FREERTOS
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#else
+      std::unique_lock<std::mutex> lock(mWakeMutex);
+      mWake.wait(lock, [this]() { return mStopRequested.load() || (mPending.load(std::memory_order_acquire) >= 0); });
+#endif
+    }
+    mRunning.store(false);
+  }
+
+#if !MESH_ASYNC_PRESENT_FREERTOS
+  void AsyncPresenter::wakeWorker()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mWakeMutex); // (so the wake can't fall between its check and its wait)
+    }
+    mWake.notify_one();
+  }
+#endif
+
+#if MESH_ASYNC_PRESENT_FREERTOS
+  void AsyncPresenter::workerEntry(void *arg)
+  {
+    static_cast<AsyncPresenter *>(arg)->workerLoop();
+    vTaskDelete(nullptr);
+  }
+#endif
+
+  uint32_t AsyncPresenter::averageLatencyMicros() const
+  {
+    const uint32_t frames = mFramesPresented.load();
+    return (frames > 0) ? (mLatencyTotal.load() / frames) : 0;
+  }
+
+  uint32_t AsyncPresenter::averagePresentMicros() const
+  {
+    const uint32_t frames = mFramesPresented.load();
+    return (frames > 0) ? (mPresentTotal.load() / frames) : 0;
+  }
+
+  void AsyncPresenter::resetStats()
+  {
+    mFramesPresented.store(0);
+    mLatencyTotal.store(0);
+    mPresentTotal.store(0);
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef STEVESCH_RENDER_RENDER_SASYNCPRESENTER_H_
+#define STEVESCH_RENDER_RENDER_SASYNCPRESENTER_H_
+
+#include "FrameBuffer565.h"
+
+#include <atomic>
+#include <stdint.h>
+
+// The present worker is a FreeRTOS task on ESP32 (pinned to a core of the caller's choice),
+// and a std::thread elsewhere.  Define MESH_ASYNC_PRESENT_FREERTOS to override.
+#ifndef MESH_ASYNC_PRESENT_FREERTOS
+#if defined(ESP32) || defined(ESP_PLATFORM)
+#define MESH_ASYNC_PRESENT_FREERTOS 1
+#else
+#define MESH_ASYNC_PRESENT_FREERTOS 0
+#endif
+#endif
+
+#if MESH_ASYNC_PRESENT_FREERTOS
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace stevesch
+{
+  // receives finished frames, on the present worker
+  class FrameSink
+  {
+  public:
+    virtual ~FrameSink() {}
+    virtual void presentFrame(const FrameBuffer565 &frame) = 0;
+  };
+
+  // Double-buffered, pipelined present: while the worker presents frame N from one buffer,
+  // the caller draws frame N + 1 into the other.  The handoff is lock-free (one producer, one
+  // consumer): submit() publishes the back buffer's index, and the worker marks a buffer free
+  // again once it has been presented.  beginFrame() only waits if the worker still holds the
+  // buffer it returns.  Without a running worker, submit() presents immediately (serially).
+  // An idle worker sleeps on a task notification (or a condition variable off ESP32).
+  class AsyncPresenter
+  {
+  public:
+    AsyncPresenter(int16_t width, int16_t height, FrameSink *sink);
+    ~AsyncPresenter();
+
+    // starts the worker (core: the ESP32 core to run it on); returns false if it couldn't be created
+    bool start(int core = 0);
+    void stop(); // presents anything submitted, then ends the worker
+    bool running() const { return mRunning.load(); }
+
+    FrameBuffer565 &beginFrame(); // the back buffer, once it's free
+    void submit();                // hands the back buffer to the worker and swaps buffers
+    void waitIdle();              // until every submitted frame has been presented
+
+    // latency is from submit() until the frame has been presented
+    uint32_t framesPresented() const { return mFramesPresented.load(); }
+    uint32_t averageLatencyMicros() const;
+    uint32_t averagePresentMicros() const;
+    void resetStats();
+
+  protected:
+    void present(int index);
+    void workerLoop();
+#if MESH_ASYNC_PRESENT_FREERTOS
+    static void workerEntry(void *arg);
+#else
+    void wakeWorker();
+#endif
+
+    FrameBuffer565 mFrames[2];
+    FrameSink *mSink;
+    uint mBack;
+    uint32_t mSubmitTime[2]; // (written before the frame is published, read after)
+
+    std::atomic<int> mPending; // index of a submitted frame not yet taken by the worker, or -1
+    std::atomic<bool> mBusy[2];
+    std::atomic<bool> mRunning;
+    std::atomic<bool> mStopRequested;
+
+    std::atomic<uint32_t> mFramesPresented;
+    std::atomic<uint32_t> mLatencyTotal;
+    std::atomic<uint32_t> mPresentTotal;
+
+#if MESH_ASYNC_PRESENT_FREERTOS
+    TaskHandle_t mTask;
+#else
+    std::thread mThread;
+    std::mutex mWakeMutex; // (only orders the wake with the worker's check; the handoff stays atomic)
+    std::condition_variable mWake;
+#endif
+  };
+}
+
+#endif
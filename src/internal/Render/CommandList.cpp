@@ -0,0 +1,311 @@
+#include "CommandList.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    constexpr uint32_t kFileMagic = 0x314c434d; // "MCL1"
+    constexpr uint16_t kFileVersion = 1;
+
+    struct FileHeader
+    {
+      uint32_t magic;
+      uint16_t version;
+      int16_t width;
+      int16_t height;
+      uint16_t clearColor;
+    };
+
+    template <typename T>
+    bool writeArray(FILE *f, const std::vector<T> &items)
+    {
+      const uint32_t count = items.size();
+      return (fwrite(&count, sizeof(count), 1, f) == 1) &&
+             ((count == 0) || (fwrite(items.data(), sizeof(T), count, f) == count));
+    }
+
+    // (bytesLeft bounds the count, so a corrupt count can't ask for more memory than the file holds)
+    template <typename T>
+    bool readArray(FILE *f, std::vector<T> &items, long &bytesLeft)
+    {
+      uint32_t count = 0;
+      if (fread(&count, sizeof(count), 1, f) != 1)
+      {
+        return false;
+      }
+      bytesLeft -= sizeof(count);
+      if ((bytesLeft < 0) || ((uint64_t)count * sizeof(T) > (uint64_t)bytesLeft))
+      {
+        return false;
+      }
+      items.resize(count);
+      bytesLeft -= (long)(count * sizeof(T));
+      return (count == 0) || (fread(items.data(), sizeof(T), count, f) == count);
+    }
+  }
+
+  CommandList::CommandList(int16_t width, int16_t height) : mWidth(width), mHeight(height), mClearColor(0)
+  {
+  }
+
+  void CommandList::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+  {
+    mCommands.push_back((kCommandLine << kCommandShift) | (uint32_t)mLines.size());
+    mLines.push_back(ScreenLine{x0, y0, x1, y1, color});
+  }
+
+  void CommandList::drawLines(const ScreenLine *lines, uint32_t count)
+  {
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      mCommands.push_back((kCommandLine << kCommandShift) | (uint32_t)mLines.size());
+      mLines.push_back(lines[i]);
+    }
+  }
+
+  void CommandList::drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color)
+  {
+    if (w <= 0)
+    {
+      return;
+    }
+    mCommands.push_back((kCommandSpan << kCommandShift) | (uint32_t)mSpans.size());
+    mSpans.push_back(Span{x, y, w, color});
+  }
+
+  void CommandList::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+  {
+    if ((w <= 0) || (h <= 0))
+    {
+      return;
+    }
+    mCommands.push_back((kCommandRect << kCommandShift) | (uint32_t)mRects.size());
+    mRects.push_back(Rect{x, y, w, h, color});
+  }
+
+  bool CommandList::fillPolygon(const fixedPoint2 *points, uint count, uint16_t color)
+  {
+    if (count < 3)
+    {
+      return true; // (nothing to fill)
+    }
+    int32_t yMin = points[0].y;
+    for (uint i = 1; i < count; ++i)
+    {
+      yMin = std::min(yMin, points[i].y);
+    }
+    mCommands.push_back((kCommandPolygon << kCommandShift) | (uint32_t)mPolygons.size());
+    mPolygons.push_back(Polygon{(uint32_t)mPoints.size(), (uint16_t)count, color, subpixelToPixel(yMin), 0});
+    mPoints.insert(mPoints.end(), points, points + count);
+    return true;
+  }
+
+  void CommandList::clear(uint16_t color)
+  {
+    mClearColor = color;
+    mCommands.clear();
+    mLines.clear();
+    mSpans.clear();
+    mRects.clear();
+    mPolygons.clear();
+    mPoints.clear();
+  }
+
+  size_t CommandList::bytes() const
+  {
+    return mCommands.capacity() * sizeof(uint32_t) + mLines.capacity() * sizeof(ScreenLine) +
+           mSpans.capacity() * sizeof(Span) + mRects.capacity() * sizeof(Rect) +
+           mPolygons.capacity() * sizeof(Polygon) + mPoints.capacity() * sizeof(fixedPoint2);
+  }
+
+  uint32_t CommandList::replay(RenderTarget &target)
+  {
+    uint32_t pixels = 0;
+    for (uint32_t command : mCommands)
+    {
+      const uint32_t index = command & kIndexMask;
+      switch (command >> kCommandShift)
+      {
+      case kCommandLine:
+      {
+        const ScreenLine &l = mLines[index];
+        target.drawLine(l.x0, l.y0, l.x1, l.y1, l.color);
+        break;
+      }
+      case kCommandSpan:
+      {
+        const Span &s = mSpans[index];
+        target.drawSpan(s.x, s.y, s.w, s.color);
+        break;
+      }
+      case kCommandRect:
+      {
+        const Rect &r = mRects[index];
+        target.fillRect(r.x, r.y, r.w, r.h, r.color);
+        break;
+      }
+      default:
+      {
+        const Polygon &p = mPolygons[index];
+        if (!target.fillPolygon(&mPoints[p.first], p.count, p.color))
+        {
+          pixels += mFiller.fill(target, &mPoints[p.first], p.count, p.color);
+        }
+        break;
+      }
+      }
+    }
+    return pixels;
+  }
+
+  uint16_t CommandList::commandColor(uint32_t command) const
+  {
+    const uint32_t index = command & kIndexMask;
+    switch (command >> kCommandShift)
+    {
+    case kCommandLine:
+      return mLines[index].color;
+    case kCommandSpan:
+      return mSpans[index].color;
+    case kCommandRect:
+      return mRects[index].color;
+    default:
+      return mPolygons[index].color;
+    }
+  }
+
+  int16_t CommandList::commandTop(uint32_t command) const
+  {
+    const uint32_t index = command & kIndexMask;
+    switch (command >> kCommandShift)
+    {
+    case kCommandLine:
+      return std::min(mLines[index].y0, mLines[index].y1);
+    case kCommandSpan:
+      return mSpans[index].y;
+    case kCommandRect:
+      return mRects[index].y;
+    default:
+      return mPolygons[index].yMin;
+    }
+  }
+
+  void CommandList::sortByColor()
+  {
+    std::stable_sort(mCommands.begin(), mCommands.end(),
+                     [this](uint32_t a, uint32_t b) { return commandColor(a) < commandColor(b); });
+  }
+
+  void CommandList::sortByRegion(int16_t rows)
+  {
+    if (rows <= 0)
+    {
+      return;
+    }
+    // (rows above the screen count as its first band)
+    auto region = [this, rows](uint32_t command) { return std::max(commandTop(command), (int16_t)0) / rows; };
+    std::stable_sort(mCommands.begin(), mCommands.end(),
+                     [&region](uint32_t a, uint32_t b) { return region(a) < region(b); });
+  }
+
+  bool CommandList::valid() const
+  {
+    for (uint32_t command : mCommands)
+    {
+      const uint32_t index = command & kIndexMask;
+      switch (command >> kCommandShift)
+      {
+      case kCommandLine:
+        if (index >= mLines.size())
+        {
+          return false;
+        }
+        break;
+      case kCommandSpan:
+        if (index >= mSpans.size())
+        {
+          return false;
+        }
+        break;
+      case kCommandRect:
+        if (index >= mRects.size())
+        {
+          return false;
+        }
+        break;
+      default:
+        if ((index >= mPolygons.size()) || (((uint64_t)mPolygons[index].first + mPolygons[index].count) > mPoints.size()))
+        {
+          return false;
+        }
+        break;
+      }
+    }
+    return true;
+  }
+
+  bool ICACHE_FLASH_ATTR CommandList::write(const char *path) const
+  {
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+      return false;
+    }
+    const FileHeader header = {kFileMagic, kFileVersion, mWidth, mHeight, mClearColor};
+    const bool ok = (fwrite(&header, sizeof(header), 1, f) == 1) && writeArray(f, mCommands) &&
+                    writeArray(f, mLines) && writeArray(f, mSpans) && writeArray(f, mRects) &&
+                    writeArray(f, mPolygons) && writeArray(f, mPoints);
+    return (fclose(f) == 0) && ok;
+  }
+
+  bool ICACHE_FLASH_ATTR CommandList::read(const char *path)
+  {
+    clear(0);
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+      return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long bytesLeft = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    FileHeader header;
+    bool ok = (fread(&header, sizeof(header), 1, f) == 1) && (header.magic == kFileMagic) &&
+              (header.version == kFileVersion);
+    bytesLeft -= sizeof(header);
+    ok = ok && readArray(f, mCommands, bytesLeft) && readArray(f, mLines, bytesLeft) &&
+         readArray(f, mSpans, bytesLeft) && readArray(f, mRects, bytesLeft) && readArray(f, mPolygons, bytesLeft) &&
+         readArray(f, mPoints, bytesLeft);
+    fclose(f);
+
+    if (ok && valid())
+    {
+      mWidth = header.width;
+      mHeight = header.height;
+      mClearColor = header.clearColor;
+      return true;
+    }
+    clear(0);
+    return false;
+  }
+
+  void ICACHE_FLASH_ATTR CommandList::compactMemory()
+  {
+    clear(mClearColor);
+    mCommands.shrink_to_fit();
+    mLines.shrink_to_fit();
+    mSpans.shrink_to_fit();
+    mRects.shrink_to_fit();
+    mPolygons.shrink_to_fit();
+    mPoints.shrink_to_fit();
+    mFiller.compactMemory();
+  }
+}
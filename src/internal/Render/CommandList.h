@@ -0,0 +1,110 @@
+#ifndef STEVESCH_RENDER_RENDER_SCOMMANDLIST_H_
+#define STEVESCH_RENDER_RENDER_SCOMMANDLIST_H_
+
+#include "FixedPoint.h"
+#include "PolygonFill.h"
+#include "RenderTarget.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  // Display list between the geometry and raster stages: a render target that records
+  // projected primitives (lines, spans, rectangles and whole polygons, each with its color)
+  // instead of drawing them, so a frame can be reordered, replayed into any target, and saved
+  // to a file to replay later as a raster-only benchmark.
+  //
+  // Commands replay in the order recorded unless sorted.  Sorting is stable, but changes the
+  // result wherever primitives that now swap order overlap.
+  class CommandList : public RenderTarget
+  {
+  public:
+    CommandList(int16_t width, int16_t height);
+    ~CommandList() {}
+
+    int16_t width() const override { return mWidth; }
+    int16_t height() const override { return mHeight; }
+
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override;
+    void drawLines(const ScreenLine *lines, uint32_t count) override;
+    void drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+    bool fillPolygon(const fixedPoint2 *points, uint count, uint16_t color) override; // (recorded: always true)
+    void clear(uint16_t color) override; // discards the commands; color is kept as clearColor()
+
+    uint16_t clearColor() const { return mClearColor; }
+    uint32_t commandCount() const { return mCommands.size(); }
+    size_t bytes() const; // as currently allocated
+
+    // draws the commands into target (which isn't cleared first); returns pixels filled by polygons
+    uint32_t replay(RenderTarget &target);
+
+    void sortByColor();             // fewer color changes
+    void sortByRegion(int16_t rows); // by the band of rows each command starts in, top first
+
+    // binary, in native byte order; read() returns false (leaving the list empty) if the file
+    // can't be read or isn't a valid list
+    bool write(const char *path) const;
+    bool read(const char *path);
+
+    void compactMemory();
+
+  protected:
+    struct Span
+    {
+      int16_t x;
+      int16_t y;
+      int16_t w;
+      uint16_t color;
+    };
+
+    struct Rect
+    {
+      int16_t x;
+      int16_t y;
+      int16_t w;
+      int16_t h;
+      uint16_t color;
+    };
+
+    struct Polygon
+    {
+      uint32_t first; // into mPoints
+      uint16_t count;
+      uint16_t color;
+      int16_t yMin; // top row
+      int16_t reserved; // (0: written files would otherwise carry two bytes of uninitialized padding)
+    };
+
+    // (type << kCommandShift) | index into that type's list
+    enum CommandType : uint32_t
+    {
+      kCommandLine = 0,
+      kCommandSpan = 1,
+      kCommandRect = 2,
+      kCommandPolygon = 3
+    };
+    static constexpr uint32_t kCommandShift = 30;
+    static constexpr uint32_t kIndexMask = (1u << kCommandShift) - 1;
+
+    uint16_t commandColor(uint32_t command) const;
+    int16_t commandTop(uint32_t command) const;
+    bool valid() const; // every command's index is in range
+
+    int16_t mWidth;
+    int16_t mHeight;
+    uint16_t mClearColor;
+
+    std::vector<uint32_t> mCommands;
+    std::vector<ScreenLine> mLines;
+    std::vector<Span> mSpans;
+    std::vector<Rect> mRects;
+    std::vector<Polygon> mPolygons;
+    std::vector<fixedPoint2> mPoints;
+    PolygonFiller mFiller; // (for replaying polygons into targets that want spans)
+  };
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include "DirtyRects.h"
+
+#include <algorithm>
+#include <math.h>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    constexpr float kMinW = 1.0e-3f; // corners nearer the eye than this (in w) make the rect unbounded
+    constexpr float kCoordLimit = 16384.0f;
+  }
+
+  void ScreenRect::unite(const ScreenRect &other)
+  {
+    if (other.empty())
+    {
+      return;
+    }
+    if (empty())
+    {
+      *this = other;
+      return;
+    }
+    x0 = std::min(x0, other.x0);
+    y0 = std::min(y0, other.y0);
+    x1 = std::max(x1, other.x1);
+    y1 = std::max(y1, other.y1);
+  }
+
+  void ScreenRect::clip(int16_t width, int16_t height)
+  {
+    x0 = std::max(x0, (int16_t)0);
+    y0 = std::max(y0, (int16_t)0);
+    x1 = std::min(x1, width);
+    y1 = std::min(y1, height);
+  }
+
+  bool sphereScreenRect(ScreenRect &rect, const vector3 &vCenterV, float radius, const matrix4 &mtxVtoS)
+  {
+    float xMin = kCoordLimit;
+    float xMax = -kCoordLimit;
+    float yMin = kCoordLimit;
+    float yMax = -kCoordLimit;
+    for (uint i = 0; i < 8; ++i)
+    {
+      vector4 v(vCenterV.x + ((i & 1) ? radius : -radius), vCenterV.y + ((i & 2) ? radius : -radius),
+                vCenterV.z + ((i & 4) ? radius : -radius), 1.0f);
+      v.transform(mtxVtoS);
+      if (v.w < kMinW)
+      {
+        return false;
+      }
+      const float invw = stevesch::recipf(v.w);
+      const float x = v.x * invw;
+      const float y = v.y * invw;
+      xMin = stevesch::minf(xMin, x);
+      xMax = stevesch::maxf(xMax, x);
+      yMin = stevesch::minf(yMin, y);
+      yMax = stevesch::maxf(yMax, y);
+    }
+
+    // (clamped to keep far off-screen corners in range; one pixel of padding each side)
+    rect.x0 = (int16_t)(floorf(stevesch::maxf(xMin, -kCoordLimit)) - 1.0f);
+    rect.y0 = (int16_t)(floorf(stevesch::maxf(yMin, -kCoordLimit)) - 1.0f);
+    rect.x1 = (int16_t)(floorf(stevesch::minf(xMax, kCoordLimit)) + 2.0f);
+    rect.y1 = (int16_t)(floorf(stevesch::minf(yMax, kCoordLimit)) + 2.0f);
+    return true;
+  }
+
+  DirtyRectTracker::DirtyRectTracker()
+      : mWidth(0), mHeight(0), mFullFrameThreshold(0.5f), mBufferAge(1), mFrame(0), mFullFramesPending(1),
+        mFullFrame(true), mRegionPixels(0)
+  {
+    mHistory.resize(mBufferAge + 1);
+  }
+
+  void DirtyRectTracker::setScreen(int16_t width, int16_t height)
+  {
+    mWidth = width;
+    mHeight = height;
+    invalidate();
+  }
+
+  void DirtyRectTracker::setBufferAge(uint age)
+  {
+    mBufferAge = std::max(age, 1u);
+    mHistory.assign(mBufferAge + 1, std::vector<ScreenRect>());
+    invalidate();
+  }
+
+  void DirtyRectTracker::invalidate()
+  {
+    // every buffer must be fully redrawn once before its history can be trusted
+    mFullFramesPending = mBufferAge;
+  }
+
+  void DirtyRectTracker::beginFrame()
+  {
+    ++mFrame;
+    mHistory[mFrame % mHistory.size()].clear();
+  }
+
+  void DirtyRectTracker::add(const ScreenRect &rect)
+  {
+    ScreenRect r(rect);
+    r.clip(mWidth, mHeight);
+    if (!r.empty())
+    {
+      mHistory[mFrame % mHistory.size()].push_back(r);
+    }
+  }
+
+  void DirtyRectTracker::addFullScreen()
+  {
+    add(ScreenRect{0, 0, mWidth, mHeight});
+  }
+
+  void DirtyRectTracker::endFrame()
+  {
+    mRegions.clear();
+    for (const std::vector<ScreenRect> &frameRects : mHistory)
+    {
+      mRegions.insert(mRegions.end(), frameRects.begin(), frameRects.end());
+    }
+
+    // merge rects that overlap, or whose union costs no more than the two apart, until none do
+    bool bMerged = true;
+    while (bMerged)
+    {
+      bMerged = false;
+      for (uint i = 0; !bMerged && (i < mRegions.size()); ++i)
+      {
+        for (uint j = i + 1; j < mRegions.size(); ++j)
+        {
+          ScreenRect u(mRegions[i]);
+          u.unite(mRegions[j]);
+          if (mRegions[i].intersects(mRegions[j]) || (u.area() <= (mRegions[i].area() + mRegions[j].area())))
+          {
+            mRegions[i] = u;
+            mRegions.erase(mRegions.begin() + j);
+            bMerged = true;
+            break;
+          }
+        }
+      }
+    }
+
+    mRegionPixels = 0;
+    for (const ScreenRect &r : mRegions)
+    {
+      mRegionPixels += r.area();
+    }
+
+    const uint32_t screenPixels = (uint32_t)std::max(mWidth, (int16_t)0) * (uint32_t)std::max(mHeight, (int16_t)0);
+    mFullFrame = (mFullFramesPending > 0) || ((float)mRegionPixels > (mFullFrameThreshold * (float)screenPixels));
+    if (mFullFramesPending > 0)
+    {
+      --mFullFramesPending;
+    }
+    if (mFullFrame)
+    {
+      mRegions.assign(1, ScreenRect{0, 0, mWidth, mHeight});
+      mRegionPixels = screenPixels;
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef STEVESCH_RENDER_RENDER_SDIRTYRECTS_H_
+#define STEVESCH_RENDER_RENDER_SDIRTYRECTS_H_
+
+#include <stevesch-MathVec.h>
+
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  // pixels [x0, x1) x [y0, y1)
+  struct ScreenRect
+  {
+    int16_t x0;
+    int16_t y0;
+    int16_t x1;
+    int16_t y1;
+
+    bool empty() const { return (x0 >= x1) || (y0 >= y1); }
+    uint32_t area() const { return empty() ? 0 : (uint32_t)(x1 - x0) * (uint32_t)(y1 - y0); }
+    bool intersects(const ScreenRect &other) const
+    {
+      return (x0 < other.x1) && (other.x0 < x1) && (y0 < other.y1) && (other.y0 < y1);
+    }
+    void unite(const ScreenRect &other);
+    void clip(int16_t width, int16_t height);
+  };
+
+  // Conservative screen rectangle of a view-space sphere: the projected corners of its
+  // view-space box (mtxVtoS maps view space to homogeneous pixels), padded by a pixel for
+  // rasterization rounding.  Returns false if the sphere reaches behind the eye (so its
+  // extent on screen is unbounded).
+  bool sphereScreenRect(ScreenRect &rect, const stevesch::vector3 &vCenterV, float radius,
+                        const stevesch::matrix4 &mtxVtoS);
+
+  // Tracks what was drawn in recent frames so a frame only needs to clear, redraw and present
+  // the regions covered now or in the frames its buffer last held: with bufferAge 1 (a single
+  // buffer) that's the union of the previous and current rectangles; a double-buffered target
+  // needs age 2.  Overlapping (or nearly adjacent) rectangles are merged, and when the regions
+  // cover more than a threshold of the screen the frame falls back to a full clear.
+  class DirtyRectTracker
+  {
+  public:
+    DirtyRectTracker();
+
+    void setScreen(int16_t width, int16_t height);
+    void setFullFrameThreshold(float fraction) { mFullFrameThreshold = fraction; } // of the screen's area
+    void setBufferAge(uint age);
+    void invalidate(); // the screen was drawn over by something else: next frames are full
+
+    void beginFrame();
+    void add(const ScreenRect &rect); // clipped to the screen
+    void addFullScreen();             // (something whose bounds are unknown)
+    void endFrame();                  // computes regions()
+
+    bool isFullFrame() const { return mFullFrame; }
+    const std::vector<ScreenRect> &regions() const { return mRegions; } // disjoint
+    uint32_t regionPixels() const { return mRegionPixels; }
+
+  protected:
+    int16_t mWidth;
+    int16_t mHeight;
+    float mFullFrameThreshold;
+    uint mBufferAge;
+    uint mFrame;
+    uint mFullFramesPending;
+    bool mFullFrame;
+    uint32_t mRegionPixels;
+
+    std::vector<std::vector<ScreenRect>> mHistory; // rects of the last mBufferAge + 1 frames
+    std::vector<ScreenRect> mRegions;
+  };
+}
+
+#endif
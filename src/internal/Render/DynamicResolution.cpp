@@ -0,0 +1,133 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    constexpr float kScaleQuantum = 1.0f / 32.0f;
+  }
+
+  void scaleRows(const PixelBuffer16 &src, uint16_t *dst, int16_t dstWidth, int16_t dstHeight, int16_t y,
+                 int16_t rows)
+  {
+    // 16.16 source steps per output pixel (rounded down, so the last output maps inside src)
+    const uint32_t xStep = ((uint32_t)src.width << 16) / (uint32_t)dstWidth;
+    const uint32_t yStep = ((uint32_t)src.height << 16) / (uint32_t)dstHeight;
+    int32_t previousRow = -1;
+    for (int16_t r = 0; r < rows; ++r)
+    {
+      uint16_t *out = dst + (size_t)r * dstWidth;
+      const int32_t sy = (int32_t)(((uint32_t)(y + r) * yStep) >> 16);
+      if (sy == previousRow)
+      {
+        memcpy(out, out - dstWidth, dstWidth * sizeof(uint16_t)); // (same source row as the last)
+        continue;
+      }
+      const uint16_t *in = src.pixels + (size_t)sy * src.stride;
+      uint32_t sx = 0;
+      for (int16_t x = 0; x < dstWidth; ++x)
+      {
+        out[x] = in[sx >> 16];
+        sx += xStep;
+      }
+      previousRow = sy;
+    }
+  }
+
+  ScaledRenderTarget::ScaledRenderTarget(int16_t outputWidth, int16_t outputHeight, int16_t stripHeight,
+                                         BandSink *sink)
+      : mFrame(outputWidth, outputHeight), mView(mFrame.buffer()),
+        mStripHeight(std::max((int16_t)1, std::min(stripHeight, outputHeight))), mScale(1.0f), mSink(sink)
+  {
+    mStrip.resize((size_t)outputWidth * mStripHeight);
+  }
+
+  void ScaledRenderTarget::setScale(float scale)
+  {
+    // (no smaller than a pixel across the frame's longer side)
+    const float minScale = 1.0f / (float)std::max(mFrame.width(), mFrame.height());
+    mScale = stevesch::maxf(minScale, stevesch::minf(scale, 1.0f));
+    PixelBuffer16 view = mFrame.buffer();
+    view.width = (int16_t)std::max(1, (int)((float)view.width * mScale + 0.5f));
+    view.height = (int16_t)std::max(1, (int)((float)view.height * mScale + 0.5f));
+    mView = PixelBufferTarget(view);
+  }
+
+  void ScaledRenderTarget::present()
+  {
+    if (mSink)
+    {
+      PixelBuffer16 view = mFrame.buffer();
+      view.width = mView.width();
+      view.height = mView.height();
+      const int16_t w = mFrame.width();
+      const int16_t h = mFrame.height();
+      for (int16_t y = 0; y < h; y += mStripHeight)
+      {
+        const int16_t rows = std::min(mStripHeight, (int16_t)(h - y));
+        scaleRows(view, mStrip.data(), w, h, y, rows);
+        mSink->pushBand(y, w, rows, mStrip.data());
+      }
+    }
+    mFrame.present();
+  }
+
+  ResolutionController::ResolutionController()
+      : mTargetMicros(33333), mMinScale(0.5f), mMaxScale(1.0f), mHysteresis(0.1f), mStep(0.0625f), mScale(1.0f)
+  {
+  }
+
+  void ResolutionController::setScaleRange(float minScale, float maxScale)
+  {
+    mMinScale = minScale;
+    mMaxScale = stevesch::maxf(maxScale, minScale);
+    setScale(mScale);
+  }
+
+  void ResolutionController::setScale(float scale)
+  {
+    mScale = stevesch::maxf(mMinScale, stevesch::minf(scale, mMaxScale));
+    mAverage.restart();
+  }
+
+  bool ResolutionController::update(uint32_t frameMicros)
+  {
+    if (!mAverage.add(frameMicros))
+    {
+      return false;
+    }
+
+    const float average = mAverage.averageMicros();
+    const float target = (float)mTargetMicros;
+    float scale;
+    if (average > (target * (1.0f + mHysteresis)))
+    {
+      // (rounded down, so any overrun drops at least a quantum)
+      scale = floorf(mScale * sqrtf(target / average) / kScaleQuantum) * kScaleQuantum;
+    }
+    else if (average < (target * (1.0f - mHysteresis)))
+    {
+      scale = mScale + mStep;
+    }
+    else
+    {
+      return false;
+    }
+    scale = stevesch::maxf(mMinScale, stevesch::minf(scale, mMaxScale));
+    if (fabsf(scale - mScale) < (0.5f * kScaleQuantum))
+    {
+      return false;
+    }
+
+    setScale(scale);
+    return true;
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef STEVESCH_RENDER_RENDER_SDYNAMICRESOLUTION_H_
+#define STEVESCH_RENDER_RENDER_SDYNAMICRESOLUTION_H_
+
+#include "FrameBuffer565.h"
+#include "FrameTiming.h"
+#include "StripRenderTarget.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  // Nearest-neighbor scale of src to dstWidth x dstHeight, producing output rows [y, y + rows)
+  // (packed with a stride of dstWidth)
+  void scaleRows(const PixelBuffer16 &src, uint16_t *dst, int16_t dstWidth, int16_t dstHeight, int16_t y,
+                 int16_t rows);
+
+  // Render target drawn at a fraction of its output size: drawing goes to the top-left
+  // width() x height() of a full-size frame, and present() scales that up to the output size
+  // a strip at a time, handing each strip to the sink.  The projection must match the render
+  // size (width() and height() change with setScale()).
+  class ScaledRenderTarget : public RenderTarget
+  {
+  public:
+    ScaledRenderTarget(int16_t outputWidth, int16_t outputHeight, int16_t stripHeight, BandSink *sink = nullptr);
+    ~ScaledRenderTarget() {}
+
+    void setSink(BandSink *sink) { mSink = sink; }
+
+    // scale is clamped to (0, 1] (at least a pixel); the render size is rounded to whole pixels
+    void setScale(float scale);
+    float scale() const { return mScale; }
+
+    int16_t width() const override { return mView.width(); } // (the render size)
+    int16_t height() const override { return mView.height(); }
+    int16_t outputWidth() const { return mFrame.width(); }
+    int16_t outputHeight() const { return mFrame.height(); }
+
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override
+    {
+      mView.drawLine(x0, y0, x1, y1, color);
+    }
+    void drawLines(const ScreenLine *lines, uint32_t count) override { mView.drawLines(lines, count); }
+    void drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color) override { mView.drawSpan(x, y, w, color); }
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override
+    {
+      mView.fillRect(x, y, w, h, color);
+    }
+    void clear(uint16_t color) override { mView.clear(color); }
+    void present() override; // scales and pushes every strip
+
+    size_t frameBytes() const { return (size_t)mFrame.width() * mFrame.height() * sizeof(uint16_t); }
+    size_t stripBytes() const { return mStrip.size() * sizeof(uint16_t); }
+
+  protected:
+    FrameBuffer565 mFrame;
+    PixelBufferTarget mView; // the render-size corner of mFrame
+    std::vector<uint16_t> mStrip;
+    int16_t mStripHeight;
+    float mScale;
+    BandSink *mSink;
+  };
+
+  // Picks a render scale from measured frame times: the scale drops when the (smoothed) frame
+  // time runs over the target by more than the hysteresis fraction, in proportion to the
+  // overrun (pixel cost goes with the square of the scale), and climbs back a step at a time
+  // while frames run that far under it.  After each change it waits a few frames, so the
+  // average reflects the new scale before the next decision.
+  class ResolutionController
+  {
+  public:
+    ResolutionController();
+
+    void setTargetFrameMicros(uint32_t micros) { mTargetMicros = micros; }
+    void setScaleRange(float minScale, float maxScale);
+    void setHysteresis(float fraction) { mHysteresis = fraction; } // of the target frame time
+    void setStep(float step) { mStep = step; }                     // scale increase per change
+    void setScale(float scale);                                    // (restarts the average)
+
+    // feed each frame's time; returns true if scale() changed
+    bool update(uint32_t frameMicros);
+
+    float scale() const { return mScale; }
+    uint32_t averageFrameMicros() const { return (uint32_t)mAverage.averageMicros(); }
+
+  protected:
+    uint32_t mTargetMicros;
+    float mMinScale;
+    float mMaxScale;
+    float mHysteresis;
+    float mStep;
+    float mScale;
+    SettledFrameAverage mAverage; // (restarted at each scale)
+  };
+}
+
+#endif
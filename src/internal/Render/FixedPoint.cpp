@@ -0,0 +1,100 @@
+#include "FixedPoint.h"
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    constexpr int kRecipTableBits = 8;
+    constexpr uint32_t kRecipTableSize = (1u << kRecipTableBits);
+
+    // sRecip.r[i] ~= 2^63 / m for normalized m = 2^31 + (i + 0.5) * 2^23 (the middle of entry i)
+    struct ReciprocalTable
+    {
+      uint32_t r[kRecipTableSize];
+
+      ReciprocalTable()
+      {
+        for (uint32_t i = 0; i < kRecipTableSize; ++i)
+        {
+          const double m = 2147483648.0 + ((double)i + 0.5) * (double)(1u << (31 - kRecipTableBits));
+          r[i] = (uint32_t)(9223372036854775808.0 / m);
+        }
+      }
+    };
+
+    const ReciprocalTable sRecip;
+
+    inline int leadingZeros(uint32_t v)
+    {
+      return __builtin_clz(v);
+    }
+  }
+
+  void fixedMatrix4::set(const matrix4 &src)
+  {
+    for (int c = 0; c < 4; ++c)
+    {
+      m[0][c] = toFixed16(src.col[c].x);
+      m[1][c] = toFixed16(src.col[c].y);
+      m[2][c] = toFixed16(src.col[c].z);
+      m[3][c] = toFixed16(src.col[c].w);
+    }
+  }
+
+  void toFixed(fixedVector3 *dst, const vector3 *src, uint count)
+  {
+    for (uint i = 0; i < count; ++i)
+    {
+      dst[i].set(src[i]);
+    }
+  }
+
+  uint32_t reciprocalFixed(fixed16_t w, int &shift)
+  {
+    // normalize: m in [2^31, 2^32)
+    const int n = leadingZeros((uint32_t)w);
+    const uint32_t m = (uint32_t)w << n;
+    uint64_t g = sRecip.r[(m >> (31 - kRecipTableBits)) & (kRecipTableSize - 1)];
+
+    // one Newton-Raphson step: g' = g * (2 - m * g / 2^63)
+    const uint64_t d = (uint64_t)0 - ((uint64_t)m * g); // 2^64 - m*g (~2^63)
+    g = (g * (d >> 32)) >> 31;
+    shift = n;
+    return (g > 0xffffffffu) ? 0xffffffffu : (uint32_t)g;
+  }
+
+  uint projectPointsFixed(fixedPoint2 *dst, const fixedVector3 *src, uint count, const fixedMatrix4 &mtx)
+  {
+    const fixed16_t(*m)[4] = mtx.m;
+    uint behind = 0;
+    for (uint i = 0; i < count; ++i)
+    {
+      const int64_t x = src[i].x;
+      const int64_t y = src[i].y;
+      const int64_t z = src[i].z;
+      const fixed16_t hw = (fixed16_t)((m[3][0] * x + m[3][1] * y + m[3][2] * z) >> kFixedShift) + m[3][3];
+      if (hw <= 0)
+      {
+        dst[i].x = INT32_MIN;
+        dst[i].y = INT32_MIN;
+        ++behind;
+        continue;
+      }
+      const fixed16_t hx = (fixed16_t)((m[0][0] * x + m[0][1] * y + m[0][2] * z) >> kFixedShift) + m[0][3];
+      const fixed16_t hy = (fixed16_t)((m[1][0] * x + m[1][1] * y + m[1][2] * z) >> kFixedShift) + m[1][3];
+
+      // (h / w) * 2^kSubpixelBits = h * r * 2^(shift - 63 + kSubpixelBits)
+      int shift;
+      const int64_t r = reciprocalFixed(hw, shift);
+      const int s = 63 - kSubpixelBits - shift;
+      const int64_t round = (int64_t)1 << (s - 1);
+      dst[i].x = (int32_t)(((int64_t)hx * r + round) >> s);
+      dst[i].y = (int32_t)(((int64_t)hy * r + round) >> s);
+    }
+    return behind;
+  }
+}
@@ -0,0 +1,156 @@
+#include "FrameBuffer565.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  FrameBuffer565::FrameBuffer565(int16_t width, int16_t height)
+      : mWidth(width), mHeight(height), mFrameCount(0), mPixels((size_t)width * height, 0)
+  {
+  }
+
+  void FrameBuffer565::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+  {
+    rasterLine(buffer(), x0, y0, x1, y1, color);
+  }
+
+  void FrameBuffer565::drawLines(const ScreenLine *lines, uint32_t count)
+  {
+    rasterLines(buffer(), lines, count);
+  }
+
+  void FrameBuffer565::drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color)
+  {
+    if ((y < 0) || (y >= mHeight))
+    {
+      return;
+    }
+    int x0 = (x < 0) ? 0 : x;
+    int x1 = ((x + w) > mWidth) ? mWidth : (x + w);
+    uint16_t *row = &mPixels[y * mWidth];
+    for (int i = x0; i < x1; ++i)
+    {
+      row[i] = color;
+    }
+  }
+
+  void FrameBuffer565::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+  {
+    const int y0 = (y < 0) ? 0 : y;
+    const int y1 = ((y + h) > mHeight) ? mHeight : (y + h);
+    for (int row = y0; row < y1; ++row)
+    {
+      drawSpan(x, row, w, color);
+    }
+  }
+
+  void FrameBuffer565::clear(uint16_t color)
+  {
+    std::fill(mPixels.begin(), mPixels.end(), color);
+  }
+
+  uint32_t FrameBuffer565::diffCount(const FrameBuffer565 &other) const
+  {
+    if ((other.mWidth != mWidth) || (other.mHeight != mHeight))
+    {
+      return (uint32_t)mPixels.size();
+    }
+    uint32_t count = 0;
+    for (size_t i = 0; i < mPixels.size(); ++i)
+    {
+      count += (mPixels[i] != other.mPixels[i]) ? 1 : 0;
+    }
+    return count;
+  }
+
+  uint32_t FrameBuffer565::checksum() const
+  {
+    uint32_t hash = 2166136261u;
+    for (uint16_t p : mPixels)
+    {
+      hash = (hash ^ (p & 0xff)) * 16777619u;
+      hash = (hash ^ (p >> 8)) * 16777619u;
+    }
+    return hash;
+  }
+
+  void PixelBufferTarget::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+  {
+    rasterLine(mBuffer, x0, y0, x1, y1, color);
+  }
+
+  void PixelBufferTarget::drawLines(const ScreenLine *lines, uint32_t count)
+  {
+    rasterLines(mBuffer, lines, count);
+  }
+
+  void PixelBufferTarget::drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color)
+  {
+    if ((y < 0) || (y >= mBuffer.height))
+    {
+      return;
+    }
+    int x0 = (x < 0) ? 0 : x;
+    int x1 = ((x + w) > mBuffer.width) ? mBuffer.width : (x + w);
+    uint16_t *row = &mBuffer.pixels[y * mBuffer.stride];
+    for (int i = x0; i < x1; ++i)
+    {
+      row[i] = color;
+    }
+  }
+
+  void PixelBufferTarget::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+  {
+    const int y0 = (y < 0) ? 0 : y;
+    const int y1 = ((y + h) > mBuffer.height) ? mBuffer.height : (y + h);
+    for (int row = y0; row < y1; ++row)
+    {
+      drawSpan(x, row, w, color);
+    }
+  }
+
+  void PixelBufferTarget::clear(uint16_t color)
+  {
+    for (int y = 0; y < mBuffer.height; ++y)
+    {
+      uint16_t *row = &mBuffer.pixels[y * mBuffer.stride];
+      std::fill(row, row + mBuffer.width, color);
+    }
+  }
+
+  bool ICACHE_FLASH_ATTR FrameBuffer565::writePPM(const char *path) const
+  {
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+      return false;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", mWidth, mHeight);
+
+    // one row at a time, expanding 5/6/5 bits to 8
+    std::vector<uint8_t> row((size_t)mWidth * 3);
+    bool ok = true;
+    for (int y = 0; ok && (y < mHeight); ++y)
+    {
+      const uint16_t *src = &mPixels[y * mWidth];
+      for (int x = 0; x < mWidth; ++x)
+      {
+        const uint16_t p = src[x];
+        const uint8_t r = (p >> 11) & 0x1f;
+        const uint8_t g = (p >> 5) & 0x3f;
+        const uint8_t b = p & 0x1f;
+        row[x * 3 + 0] = (uint8_t)((r << 3) | (r >> 2));
+        row[x * 3 + 1] = (uint8_t)((g << 2) | (g >> 4));
+        row[x * 3 + 2] = (uint8_t)((b << 3) | (b >> 2));
+      }
+      ok = (fwrite(row.data(), 1, row.size(), f) == row.size());
+    }
+    fclose(f);
+    return ok;
+  }
+}
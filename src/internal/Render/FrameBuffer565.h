@@ -0,0 +1,83 @@
+#ifndef STEVESCH_RENDER_RENDER_SFRAMEBUFFER565_H_
+#define STEVESCH_RENDER_RENDER_SFRAMEBUFFER565_H_
+
+#include "RenderTarget.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  // In-memory RGB565 render target, for running the renderer headless (benchmarks, and exact
+  // pixel comparisons between rendering paths).  Frames can be written out as PPM images.
+  class FrameBuffer565 : public RenderTarget
+  {
+  public:
+    FrameBuffer565(int16_t width, int16_t height);
+    ~FrameBuffer565() {}
+
+    int16_t width() const override { return mWidth; }
+    int16_t height() const override { return mHeight; }
+
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override;
+    void drawLines(const ScreenLine *lines, uint32_t count) override;
+    void drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+    void clear(uint16_t color) override;
+    void present() override { ++mFrameCount; }
+
+    uint16_t getPixel(int16_t x, int16_t y) const;
+    void setPixel(int16_t x, int16_t y, uint16_t color);
+    const uint16_t *pixels() const { return mPixels.data(); }
+    PixelBuffer16 buffer() { return PixelBuffer16{mPixels.data(), mWidth, mHeight, mWidth}; }
+    uint32_t frameCount() const { return mFrameCount; }
+
+    // number of pixels that differ from other (all of them if the sizes differ)
+    uint32_t diffCount(const FrameBuffer565 &other) const;
+    // FNV-1a hash of the pixels (for comparing frames without keeping both)
+    uint32_t checksum() const;
+
+    // binary PPM (P6), 8 bits per channel; returns false if the file can't be written
+    bool writePPM(const char *path) const;
+
+  protected:
+    int16_t mWidth;
+    int16_t mHeight;
+    uint32_t mFrameCount;
+    std::vector<uint16_t> mPixels;
+  };
+
+  // RGB565 render target over pixels owned elsewhere (e.g. a band of a larger frame)
+  class PixelBufferTarget : public RenderTarget
+  {
+  public:
+    explicit PixelBufferTarget(const PixelBuffer16 &buffer) : mBuffer(buffer) {}
+
+    int16_t width() const override { return mBuffer.width; }
+    int16_t height() const override { return mBuffer.height; }
+
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override;
+    void drawLines(const ScreenLine *lines, uint32_t count) override;
+    void drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+    void clear(uint16_t color) override;
+
+  protected:
+    PixelBuffer16 mBuffer;
+  };
+
+  inline uint16_t FrameBuffer565::getPixel(int16_t x, int16_t y) const
+  {
+    return ((x >= 0) && (x < mWidth) && (y >= 0) && (y < mHeight)) ? mPixels[y * mWidth + x] : 0;
+  }
+
+  inline void FrameBuffer565::setPixel(int16_t x, int16_t y, uint16_t color)
+  {
+    if ((x >= 0) && (x < mWidth) && (y >= 0) && (y < mHeight))
+    {
+      mPixels[y * mWidth + x] = color;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "FrameTiming.h"
+
+#if defined(ESP32) || defined(ESP_PLATFORM)
+#include <esp_timer.h>
+#else
+#include <chrono>
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    constexpr uint kSettleFrames = 8;        // frames after a change before the next
+    constexpr uint kSettleAverageFrames = 4; // (of those, the last ones start the average)
+  }
+
+  uint32_t nowMicros()
+  {
+#if defined(ESP32) || defined(ESP_PLATFORM)
+    return (uint32_t)esp_timer_get_time();
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  void SettledFrameAverage::restart()
+  {
+    mAverageMicros = 0.0f;
+    mSettleFrames = kSettleFrames;
+  }
+
+  bool SettledFrameAverage::add(uint32_t frameMicros)
+  {
+    if (mSettleFrames > kSettleAverageFrames)
+    {
+      --mSettleFrames; // (still the change's transition)
+      return false;
+    }
+    if (mAverageMicros > 0.0f)
+    {
+      mAverageMicros += kFrameAverageFactor * ((float)frameMicros - mAverageMicros);
+    }
+    else
+    {
+      mAverageMicros = (float)frameMicros;
+    }
+    if (mSettleFrames > 0)
+    {
+      --mSettleFrames;
+      return false;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef STEVESCH_RENDER_RENDER_SFRAMETIMING_H_
+#define STEVESCH_RENDER_RENDER_SFRAMETIMING_H_
+
+#include <stevesch-MathVec.h>
+
+#include <stdint.h>
+
+namespace stevesch
+{
+  // the system timer, in microseconds (esp_timer on ESP32, the steady clock elsewhere)
+  uint32_t nowMicros();
+
+  // microsecond time source for frame timing (a simulated one makes its users testable headless)
+  class FrameClock
+  {
+  public:
+    virtual ~FrameClock() {}
+    virtual uint32_t micros() = 0;
+  };
+
+  class SystemFrameClock : public FrameClock
+  {
+  public:
+    uint32_t micros() override { return nowMicros(); }
+  };
+
+  // time that only moves when told to
+  class SimulatedFrameClock : public FrameClock
+  {
+  public:
+    SimulatedFrameClock() : mMicros(0) {}
+    uint32_t micros() override { return mMicros; }
+    void advance(uint32_t micros) { mMicros += micros; }
+
+  protected:
+    uint32_t mMicros;
+  };
+
+  constexpr float kFrameAverageFactor = 0.25f; // weight of each new frame time in smoothed averages
+
+  // Smoothed frame time for a controller that changes something and then judges the result:
+  // restart() after each change skips the change's transition frames, then averages a few
+  // more before add() reports the average settled enough to decide on again.
+  class SettledFrameAverage
+  {
+  public:
+    SettledFrameAverage() : mAverageMicros(0.0f), mSettleFrames(0) {}
+
+    void restart();
+    // feed each frame's time; returns true once the average can be acted on
+    bool add(uint32_t frameMicros);
+
+    float averageMicros() const { return mAverageMicros; } // (0 until the first averaged frame)
+
+  protected:
+    float mAverageMicros;
+    uint mSettleFrames;
+  };
+}
+
+#endif
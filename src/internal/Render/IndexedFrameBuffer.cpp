@@ -0,0 +1,163 @@
+#include "IndexedFrameBuffer.h"
+
+#include <algorithm>
+#include <string.h>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    constexpr uint kMaxPaletteSize = 256;
+
+    // squared distance between RGB565 colors, with channels widened to 6 bits
+    inline int colorDistance(uint16_t a, uint16_t b)
+    {
+      const int dr = (int)((a >> 11) & 0x1f) * 2 - (int)((b >> 11) & 0x1f) * 2;
+      const int dg = (int)((a >> 5) & 0x3f) - (int)((b >> 5) & 0x3f);
+      const int db = (int)(a & 0x1f) * 2 - (int)(b & 0x1f) * 2;
+      return dr * dr + dg * dg + db * db;
+    }
+  }
+
+  IndexedFrameBuffer::IndexedFrameBuffer(int16_t width, int16_t height, int16_t stripHeight, BandSink *sink)
+      : mWidth(width), mHeight(height), mStripHeight(std::max((int16_t)1, std::min(stripHeight, height))),
+        mSink(sink), mPixels((size_t)width * height, 0), mLastColor(0), mLastIndex(0), mSwapBytes(false)
+  {
+    mStrips[0].resize((size_t)width * mStripHeight);
+    mStrips[1].resize((size_t)width * mStripHeight);
+    mPalette.push_back(0);
+  }
+
+  void IndexedFrameBuffer::setPalette(const uint16_t *colors, uint count)
+  {
+    count = std::min(count, kMaxPaletteSize);
+    mPalette.assign(colors, colors + count);
+    if (mPalette.empty())
+    {
+      mPalette.push_back(0);
+    }
+    mLastColor = mPalette[0];
+    mLastIndex = 0;
+    std::fill(mPixels.begin(), mPixels.end(), 0); // (old indices may be past the end of this palette)
+  }
+
+  uint8_t IndexedFrameBuffer::paletteIndex(uint16_t color)
+  {
+    if (color == mLastColor)
+    {
+      return mLastIndex;
+    }
+
+    uint best = 0;
+    int bestDistance = colorDistance(color, mPalette[0]);
+    for (uint i = 1; (i < mPalette.size()) && (bestDistance > 0); ++i)
+    {
+      const int d = colorDistance(color, mPalette[i]);
+      if (d < bestDistance)
+      {
+        best = i;
+        bestDistance = d;
+      }
+    }
+    if ((bestDistance > 0) && (mPalette.size() < kMaxPaletteSize))
+    {
+      best = mPalette.size();
+      mPalette.push_back(color);
+    }
+
+    mLastColor = color;
+    mLastIndex = (uint8_t)best;
+    return mLastIndex;
+  }
+
+  void IndexedFrameBuffer::span(int16_t x, int16_t y, int16_t w, uint8_t index)
+  {
+    if ((y < 0) || (y >= mHeight))
+    {
+      return;
+    }
+    const int x0 = (x < 0) ? 0 : x;
+    const int x1 = ((x + w) > mWidth) ? mWidth : (x + w);
+    if (x0 < x1)
+    {
+      memset(&mPixels[y * mWidth + x0], index, x1 - x0);
+    }
+  }
+
+  void IndexedFrameBuffer::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+  {
+    rasterLine(buffer(), x0, y0, x1, y1, paletteIndex(color));
+  }
+
+  void IndexedFrameBuffer::drawLines(const ScreenLine *lines, uint32_t count)
+  {
+    const PixelBuffer8 dst = buffer();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      const ScreenLine &l = lines[i];
+      rasterLine(dst, l.x0, l.y0, l.x1, l.y1, paletteIndex(l.color));
+    }
+  }
+
+  void IndexedFrameBuffer::drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color)
+  {
+    span(x, y, w, paletteIndex(color));
+  }
+
+  void IndexedFrameBuffer::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+  {
+    const uint8_t index = paletteIndex(color);
+    const int y0 = (y < 0) ? 0 : y;
+    const int y1 = ((y + h) > mHeight) ? mHeight : (y + h);
+    for (int row = y0; row < y1; ++row)
+    {
+      span(x, row, w, index);
+    }
+  }
+
+  void IndexedFrameBuffer::clear(uint16_t color)
+  {
+    std::fill(mPixels.begin(), mPixels.end(), paletteIndex(color));
+  }
+
+  void IndexedFrameBuffer::convertRows(uint16_t *dst, int16_t y, int16_t rows) const
+  {
+    const uint16_t *palette = mPalette.data();
+    const uint8_t *src = &mPixels[y * mWidth];
+    const uint32_t count = (uint32_t)mWidth * rows;
+    if (mSwapBytes)
+    {
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        const uint16_t c = palette[src[i]];
+        dst[i] = (uint16_t)((c << 8) | (c >> 8));
+      }
+      return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      dst[i] = palette[src[i]];
+    }
+  }
+
+  void IndexedFrameBuffer::present()
+  {
+    if (!mSink)
+    {
+      return;
+    }
+    uint strip = 0;
+    for (int16_t y = 0; y < mHeight; y += mStripHeight)
+    {
+      const int16_t rows = std::min(mStripHeight, (int16_t)(mHeight - y));
+      uint16_t *dst = mStrips[strip].data();
+      convertRows(dst, y, rows);
+      mSink->pushBand(y, mWidth, rows, dst);
+      strip ^= 1;
+    }
+  }
+}
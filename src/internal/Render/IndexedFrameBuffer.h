@@ -0,0 +1,84 @@
+#ifndef STEVESCH_RENDER_RENDER_SINDEXEDFRAMEBUFFER_H_
+#define STEVESCH_RENDER_RENDER_SINDEXEDFRAMEBUFFER_H_
+
+#include "RenderTarget.h"
+#include "StripRenderTarget.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  // 8-bit palettized render target: half the memory (and the memory traffic while rasterizing)
+  // of an RGB565 frame, for scenes drawn in a limited set of colors.  Drawing calls still take
+  // RGB565 colors; each is mapped to a palette index once per primitive (the palette is
+  // seeded with setPalette() and grows as new colors arrive; once all 256 entries are in use,
+  // new colors map to the nearest entry), and rasterization writes one byte per pixel.
+  //
+  // present() converts the frame to RGB565 a strip of rows at a time and hands each strip to
+  // the sink.  It alternates between two strip buffers, so a sink that starts an asynchronous
+  // (DMA) transfer and returns can send one strip while the next is converted: a strip's
+  // pixels stay valid until the sink's next-but-one pushBand().  DMA sends memory as it is, so
+  // setSwapBytes(true) converts strips straight to a panel's (big-endian) byte order.
+  class IndexedFrameBuffer : public RenderTarget
+  {
+  public:
+    IndexedFrameBuffer(int16_t width, int16_t height, int16_t stripHeight, BandSink *sink = nullptr);
+    ~IndexedFrameBuffer() {}
+
+    void setSink(BandSink *sink) { mSink = sink; }
+
+    int16_t width() const override { return mWidth; }
+    int16_t height() const override { return mHeight; }
+    int16_t stripHeight() const { return mStripHeight; }
+
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override;
+    void drawLines(const ScreenLine *lines, uint32_t count) override;
+    void drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+    void clear(uint16_t color) override;
+    void present() override; // converts and pushes every strip
+
+    // replaces the palette with colors (up to 256); the frame is reset to index 0
+    void setPalette(const uint16_t *colors, uint count);
+    uint paletteSize() const { return mPalette.size(); }
+    uint16_t paletteColor(uint8_t index) const { return mPalette[index]; }
+    uint8_t paletteIndex(uint16_t color); // (adds color if there's room)
+
+    const uint8_t *pixels() const { return mPixels.data(); }
+    uint8_t getPixel(int16_t x, int16_t y) const;
+
+    // RGB565 of rows [y, y + rows), packed with a stride of width (byte-swapped if set)
+    void convertRows(uint16_t *dst, int16_t y, int16_t rows) const;
+    void setSwapBytes(bool bSwap) { mSwapBytes = bSwap; }
+
+    // memory held: the indexed frame, and the two RGB565 strips
+    size_t frameBytes() const { return mPixels.size(); }
+    size_t stripBytes() const { return 2 * (size_t)mWidth * mStripHeight * sizeof(uint16_t); }
+
+  protected:
+    PixelBuffer8 buffer() { return PixelBuffer8{mPixels.data(), mWidth, mHeight, mWidth}; }
+    void span(int16_t x, int16_t y, int16_t w, uint8_t index);
+
+    int16_t mWidth;
+    int16_t mHeight;
+    int16_t mStripHeight;
+    BandSink *mSink;
+
+    std::vector<uint8_t> mPixels;
+    std::vector<uint16_t> mPalette;
+    std::vector<uint16_t> mStrips[2];
+
+    uint16_t mLastColor; // (consecutive primitives usually share a color)
+    uint8_t mLastIndex;
+    bool mSwapBytes;
+  };
+
+  inline uint8_t IndexedFrameBuffer::getPixel(int16_t x, int16_t y) const
+  {
+    return ((x >= 0) && (x < mWidth) && (y >= 0) && (y < mHeight)) ? mPixels[y * mWidth + x] : 0;
+  }
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include "LineClip.h"
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    inline void lerp(vector4 &dst, const vector4 &a, const vector4 &b, float t)
+    {
+      dst.x = a.x + t * (b.x - a.x);
+      dst.y = a.y + t * (b.y - a.y);
+      dst.z = a.z + t * (b.z - a.z);
+      dst.w = a.w + t * (b.w - a.w);
+    }
+  }
+
+  uint32_t clipOutcode(const vector4 &v, const ClipRegion &region)
+  {
+    uint32_t code = 0;
+    code |= (v.z < 0.0f) ? kClipNear : 0;
+    code |= (v.x < region.xMin * v.w) ? kClipLeft : 0;
+    code |= (v.x > region.xMax * v.w) ? kClipRight : 0;
+    code |= (v.y < region.yMin * v.w) ? kClipBottom : 0;
+    code |= (v.y > region.yMax * v.w) ? kClipTop : 0;
+    return code;
+  }
+
+  bool clipLine(vector4 &a, vector4 &b, const ClipRegion &region)
+  {
+    return clipLine(a, b, clipOutcode(a, region), clipOutcode(b, region), region);
+  }
+
+  bool clipLine(vector4 &a, vector4 &b, uint32_t outcodeA, uint32_t outcodeB, const ClipRegion &region)
+  {
+    if ((outcodeA & outcodeB) != 0)
+    {
+      return false; // both outside the same plane
+    }
+    if ((outcodeA | outcodeB) == 0)
+    {
+      return true; // both inside
+    }
+
+    // signed distances of each endpoint to each plane (inside >= 0)
+    const float da[5] = {
+        a.z,
+        a.x - region.xMin * a.w,
+        region.xMax * a.w - a.x,
+        a.y - region.yMin * a.w,
+        region.yMax * a.w - a.y};
+    const float db[5] = {
+        b.z,
+        b.x - region.xMin * b.w,
+        region.xMax * b.w - b.x,
+        b.y - region.yMin * b.w,
+        region.yMax * b.w - b.y};
+
+    const uint32_t spanning = outcodeA | outcodeB;
+    float t0 = 0.0f;
+    float t1 = 1.0f;
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+      if (!(spanning & (1 << i)))
+      {
+        continue;
+      }
+      const float t = da[i] / (da[i] - db[i]);
+      if (da[i] < 0.0f)
+      {
+        t0 = stevesch::maxf(t0, t); // entering
+      }
+      else
+      {
+        t1 = stevesch::minf(t1, t); // leaving
+      }
+    }
+    if (t0 > t1)
+    {
+      return false;
+    }
+
+    const vector4 a0(a);
+    const vector4 b0(b);
+    if (t0 > 0.0f)
+    {
+      lerp(a, a0, b0, t0);
+    }
+    if (t1 < 1.0f)
+    {
+      lerp(b, a0, b0, t1);
+    }
+    return true;
+  }
+
+  uint32_t clipPolygonNear(vector4 *dst, const vector4 *src, uint32_t count)
+  {
+    uint32_t n = 0;
+    if (count == 0)
+    {
+      return 0;
+    }
+    const vector4 *a = &src[count - 1];
+    bool bInsideA = (a->z >= 0.0f);
+    for (uint32_t k = 0; k < count; ++k)
+    {
+      const vector4 *b = &src[k];
+      const bool bInsideB = (b->z >= 0.0f);
+      if (bInsideA != bInsideB)
+      {
+        lerp(dst[n++], *a, *b, a->z / (a->z - b->z));
+      }
+      if (bInsideB)
+      {
+        dst[n++] = *b;
+      }
+      a = b;
+      bInsideA = bInsideB;
+    }
+    return n;
+  }
+}
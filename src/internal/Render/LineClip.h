@@ -0,0 +1,61 @@
+#ifndef STEVESCH_RENDER_RENDER_SLINECLIP_H_
+#define STEVESCH_RENDER_RENDER_SLINECLIP_H_
+
+#include <stevesch-MathVec.h>
+#include <stdint.h>
+
+namespace stevesch
+{
+  // Clip region, in the units of the projected x/w and y/w: normalized device coordinates
+  // (viewport [-1, 1]) for plain clip space, or pixels if the viewport mapping is folded into
+  // the projection.  A guard band (a region larger than the viewport) trades clipping work for
+  // rasterizer rejection of pixels that land just off-screen.
+  struct ClipRegion
+  {
+    float xMin;
+    float xMax;
+    float yMin;
+    float yMax;
+
+    void set(float x0, float x1, float y0, float y1)
+    {
+      xMin = x0;
+      xMax = x1;
+      yMin = y0;
+      yMax = y1;
+    }
+    // scale the region about its center (e.g. from the viewport to a guard band)
+    void expand(float fScale)
+    {
+      const float cx = 0.5f * (xMin + xMax);
+      const float cy = 0.5f * (yMin + yMax);
+      set(cx + fScale * (xMin - cx), cx + fScale * (xMax - cx),
+          cy + fScale * (yMin - cy), cy + fScale * (yMax - cy));
+    }
+  };
+
+  // outcode bits: vertex is outside the given plane (D3D-style clip space: near plane is z = 0)
+  enum
+  {
+    kClipNear = (1 << 0),   // z < 0
+    kClipLeft = (1 << 1),   // x < xMin*w
+    kClipRight = (1 << 2),  // x > xMax*w
+    kClipBottom = (1 << 3), // y < yMin*w
+    kClipTop = (1 << 4)     // y > yMax*w
+  };
+
+  uint32_t clipOutcode(const vector4 &v, const ClipRegion &region);
+
+  // Clips the clip-space segment (a, b) to the near plane and region (Liang-Barsky, in
+  // homogeneous coordinates, so segments crossing the near plane are handled correctly).
+  // a and b are replaced by the clipped endpoints; returns false if nothing remains.
+  bool clipLine(vector4 &a, vector4 &b, const ClipRegion &region);
+  // as above, when the outcodes of a and b are already known
+  bool clipLine(vector4 &a, vector4 &b, uint32_t outcodeA, uint32_t outcodeB, const ClipRegion &region);
+
+  // Clips a polygon (any shape) to the near plane (Sutherland-Hodgman); returns the new vertex
+  // count.  dst must have room for 2 * count vertices and must not overlap src.
+  uint32_t clipPolygonNear(vector4 *dst, const vector4 *src, uint32_t count);
+}
+
+#endif
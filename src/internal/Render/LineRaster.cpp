@@ -0,0 +1,166 @@
+#include "LineRaster.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    template <typename Buffer>
+    inline bool inside(const Buffer &dst, int x, int y)
+    {
+      return ((unsigned)x < (unsigned)dst.width) && ((unsigned)y < (unsigned)dst.height);
+    }
+
+    template <typename Pixel>
+    inline void fillSpan(Pixel *p, int count, Pixel color)
+    {
+      std::fill_n(p, count, color);
+    }
+
+    template <typename Pixel>
+    inline void fillRun(Pixel *p, int count, int step, Pixel color)
+    {
+      for (int i = 0; i < count; ++i)
+      {
+        *p = color;
+        p += step;
+      }
+    }
+
+    // per-pixel bounds checks, for lines that leave the buffer
+    template <typename Buffer, typename Pixel>
+    void rasterLineChecked(const Buffer &dst, int x0, int y0, int x1, int y1, Pixel color)
+    {
+      const int dx = abs(x1 - x0);
+      const int dy = -abs(y1 - y0);
+      const int sx = (x0 < x1) ? 1 : -1;
+      const int sy = (y0 < y1) ? 1 : -1;
+      int err = dx + dy;
+      int x = x0;
+      int y = y0;
+      for (;;)
+      {
+        if (inside(dst, x, y))
+        {
+          dst.pixels[y * dst.stride + x] = color;
+        }
+        if ((x == x1) && (y == y1))
+        {
+          break;
+        }
+        const int e2 = 2 * err;
+        if (e2 >= dy)
+        {
+          err += dy;
+          x += sx;
+        }
+        if (e2 <= dx)
+        {
+          err += dx;
+          y += sy;
+        }
+      }
+    }
+
+    template <typename Buffer, typename Pixel>
+    void rasterLineT(const Buffer &dst, int x0, int y0, int x1, int y1, Pixel color)
+    {
+      if (!inside(dst, x0, y0) || !inside(dst, x1, y1))
+      {
+        rasterLineChecked(dst, x0, y0, x1, y1, color);
+        return;
+      }
+
+      const int dx = abs(x1 - x0);
+      const int dy = abs(y1 - y0);
+      const int sx = (x0 < x1) ? 1 : -1;
+      const int sy = (y0 < y1) ? dst.stride : -dst.stride; // (a row step is a pointer step)
+      Pixel *p = dst.pixels + y0 * dst.stride + x0;
+
+      if (dy == 0)
+      {
+        fillSpan((sx > 0) ? p : (p - dx), dx + 1, color);
+        return;
+      }
+      if (dx == 0)
+      {
+        fillRun((sy > 0) ? p : (p - dy * dst.stride), dy + 1, dst.stride, color);
+        return;
+      }
+
+      // Same decisions as the per-pixel form (err = dx - dy; step x if 2err >= -dy, step y if
+      // 2err <= dx).  The major axis steps on every iteration, so pixels form runs along it that
+      // end whenever the minor axis steps.
+      int err = dx - dy;
+      if (dx >= dy)
+      {
+        Pixel *runStart = p;
+        int run = 1;
+        for (int i = 0; i < dx; ++i)
+        {
+          const int e2 = 2 * err;
+          err -= dy;
+          if (e2 <= dx)
+          {
+            err += dx;
+            fillSpan((sx > 0) ? runStart : (runStart - (run - 1)), run, color);
+            runStart += run * sx + sy;
+            run = 1;
+          }
+          else
+          {
+            ++run;
+          }
+        }
+        fillSpan((sx > 0) ? runStart : (runStart - (run - 1)), run, color);
+      }
+      else
+      {
+        Pixel *runStart = p;
+        int run = 1;
+        for (int i = 0; i < dy; ++i)
+        {
+          const int e2 = 2 * err;
+          err += dx;
+          if (e2 >= -dy)
+          {
+            err -= dy;
+            fillRun(runStart, run, sy, color);
+            runStart += run * sy + sx;
+            run = 1;
+          }
+          else
+          {
+            ++run;
+          }
+        }
+        fillRun(runStart, run, sy, color);
+      }
+    }
+  }
+
+  void rasterLine(const PixelBuffer16 &dst, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+  {
+    rasterLineT(dst, x0, y0, x1, y1, color);
+  }
+
+  void rasterLine(const PixelBuffer8 &dst, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t index)
+  {
+    rasterLineT(dst, x0, y0, x1, y1, index);
+  }
+
+  void rasterLines(const PixelBuffer16 &dst, const ScreenLine *lines, uint32_t count)
+  {
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      const ScreenLine &l = lines[i];
+      rasterLine(dst, l.x0, l.y0, l.x1, l.y1, l.color);
+    }
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef STEVESCH_RENDER_RENDER_SLINERASTER_H_
+#define STEVESCH_RENDER_RENDER_SLINERASTER_H_
+
+#include <stdint.h>
+
+namespace stevesch
+{
+  // one line of a batch, in pixels
+  struct ScreenLine
+  {
+    int16_t x0;
+    int16_t y0;
+    int16_t x1;
+    int16_t y1;
+    uint16_t color;
+  };
+
+  // 16-bit framebuffer: row-major, stride in pixels
+  struct PixelBuffer16
+  {
+    uint16_t *pixels;
+    int16_t width;
+    int16_t height;
+    int16_t stride;
+  };
+
+  // 8-bit (palette index) framebuffer, likewise
+  struct PixelBuffer8
+  {
+    uint8_t *pixels;
+    int16_t width;
+    int16_t height;
+    int16_t stride;
+  };
+
+  // Integer Bresenham written straight to memory: horizontal and vertical lines are plain
+  // fills, and other lines are written as runs (horizontal runs for x-major lines, vertical
+  // runs for y-major ones).  Lines with both ends inside the buffer skip all per-pixel checks;
+  // others are drawn with per-pixel bounds checks (clip long lines beforehand).
+  // The pixels set are the same as a per-pixel Bresenham from (x0, y0) to (x1, y1).
+  void rasterLine(const PixelBuffer16 &dst, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void rasterLine(const PixelBuffer8 &dst, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t index);
+  void rasterLines(const PixelBuffer16 &dst, const ScreenLine *lines, uint32_t count);
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include "ParallelRenderTarget.h"
+
+#include <algorithm>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+#if MESH_PARALLEL_RASTER_FREERTOS
+    constexpr uint32_t kWorkerStackBytes = 4096;
+    constexpr UBaseType_t kWorkerPriority = 1; // (the Arduino loop task's)
+
+    inline void waitBriefly() { taskYIELD(); }
+#else
+    inline void waitBriefly() { std::this_thread::yield(); }
+#endif
+  }
+
+  ParallelRenderTarget::ParallelRenderTarget(int16_t width, int16_t height, int16_t bandHeight, uint workerCount,
+                                             BandSink *sink)
+      : StripRenderTarget(width, height, bandHeight, sink, false), mFrame(width, height), mCallerBands(0),
+        mNextBand(0), mWorkersBusy(0), mWorkersRunning(0), mStopRequested(false)
+#if !MESH_PARALLEL_RASTER_FREERTOS
+        ,
+        mGeneration(0)
+#endif
+  {
+    mOrder.resize(mBands.size());
+    setWorkerCount(workerCount);
+  }
+
+  ParallelRenderTarget::~ParallelRenderTarget()
+  {
+    stopWorkers();
+  }
+
+  uint ICACHE_FLASH_ATTR ParallelRenderTarget::setWorkerCount(uint count)
+  {
+    stopWorkers();
+    for (uint i = 1; i < count; ++i)
+    {
+      Worker *worker = new Worker();
+      worker->owner = this;
+      worker->index = i;
+      worker->bandsDrawn = 0;
+      mWorkersRunning.fetch_add(1);
+#if MESH_PARALLEL_RASTER_FREERTOS
+      // (worker 1 on the core the caller isn't using; any more wherever there's room)
+      const int core = (i == 1) ? 0 : tskNO_AFFINITY;
+      if (xTaskCreatePinnedToCore(workerEntry, "raster", kWorkerStackBytes, worker, kWorkerPriority, &worker->task,
+                                  core) != pdPASS)
+      {
+        mWorkersRunning.fetch_sub(1);
+        delete worker;
+        break;
+      }
+#else
+      worker->generation = mGeneration;
+      worker->thread = std::thread([this, worker]() { workerLoop(*worker); });
+#endif
+      mWorkers.push_back(worker);
+    }
+    return workerCount();
+  }
+
+  void ICACHE_FLASH_ATTR ParallelRenderTarget::stopWorkers()
+  {
+    if (mWorkers.empty())
+    {
+      return;
+    }
+    mStopRequested.store(true);
+#if MESH_PARALLEL_RASTER_FREERTOS
+    for (Worker *worker : mWorkers)
+    {
+      xTaskNotifyGive(worker->task);
+    }
+    while (mWorkersRunning.load() > 0)
+    {
+      waitBriefly();
+    }
+#else
+    {
+      std::lock_guard<std::mutex> lock(mWakeMutex);
+    }
+    mWake.notify_all();
+    for (Worker *worker : mWorkers)
+    {
+      worker->thread.join();
+    }
+#endif
+    for (Worker *worker : mWorkers)
+    {
+      delete worker;
+    }
+    mWorkers.clear();
+    mStopRequested.store(false);
+  }
+
+  uint ParallelRenderTarget::drawBands()
+  {
+    const uint bandCount = mOrder.size();
+    uint drawn = 0;
+    for (uint i = mNextBand.fetch_add(1, std::memory_order_relaxed); i < bandCount;
+         i = mNextBand.fetch_add(1, std::memory_order_relaxed))
+    {
+      const uint b = mOrder[i];
+      const int16_t y0 = (int16_t)(b * mBandHeight);
+      const int16_t rows = std::min(mBandHeight, (int16_t)(mHeight - y0));
+      PixelBufferTarget band(PixelBuffer16{mFrame.buffer().pixels + (size_t)y0 * mWidth, mWidth, rows, mWidth});
+      band.clear(mClearColor);
+      replayBand(b, band);
+      ++drawn;
+    }
+    return drawn;
+  }
+
+  void ParallelRenderTarget::workerLoop(Worker &worker)
+  {
+    for (;;)
+    {
+#if MESH_PARALLEL_RASTER_FREERTOS
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#else
+      {
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mWake.wait(lock, [&]() { return mStopRequested.load() || (mGeneration != worker.generation); });
+        worker.generation = mGeneration;
+      }
+#endif
+      if (mStopRequested.load())
+      {
+        break;
+      }
+      worker.bandsDrawn = drawBands();
+      mWorkersBusy.fetch_sub(1, std::memory_order_release);
+    }
+    mWorkersRunning.fetch_sub(1);
+  }
+
+#if MESH_PARALLEL_RASTER_FREERTOS
+  void ParallelRenderTarget::workerEntry(void *arg)
+  {
+    Worker *worker = static_cast<Worker *>(arg);
+    worker->owner->workerLoop(*worker);
+    vTaskDelete(nullptr);
+  }
+#endif
+
+  void ParallelRenderTarget::present()
+  {
+    // busiest bands first, so the last ones taken are short
+    for (uint b = 0; b < mOrder.size(); ++b)
+    {
+      mOrder[b] = (uint16_t)b;
+    }
+    std::stable_sort(mOrder.begin(), mOrder.end(),
+                     [this](uint16_t a, uint16_t b) { return mBands[a].size() > mBands[b].size(); });
+
+    mNextBand.store(0, std::memory_order_relaxed);
+    mWorkersBusy.store((uint)mWorkers.size(), std::memory_order_relaxed);
+#if MESH_PARALLEL_RASTER_FREERTOS
+    for (Worker *worker : mWorkers)
+    {
+      xTaskNotifyGive(worker->task);
+    }
+#else
+    if (!mWorkers.empty())
+    {
+      {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        ++mGeneration;
+      }
+      mWake.notify_all();
+    }
+#endif
+
+    mCallerBands = drawBands();
+    while (mWorkersBusy.load(std::memory_order_acquire) > 0)
+    {
+      waitBriefly(); // the others are finishing their last bands
+    }
+
+    if (mSink)
+    {
+      mSink->pushBand(0, mWidth, mHeight, mFrame.pixels());
+    }
+    mFrame.present();
+    clear(mClearColor);
+  }
+
+  uint ParallelRenderTarget::bandsDrawn(uint worker) const
+  {
+    if (worker == 0)
+    {
+      return mCallerBands;
+    }
+    return (worker <= mWorkers.size()) ? mWorkers[worker - 1]->bandsDrawn : 0;
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef STEVESCH_RENDER_RENDER_SPARALLELRENDERTARGET_H_
+#define STEVESCH_RENDER_RENDER_SPARALLELRENDERTARGET_H_
+
+#include "FrameBuffer565.h"
+#include "StripRenderTarget.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+// Workers are FreeRTOS tasks on ESP32 and std::threads elsewhere (as for AsyncPresenter).
+// Define MESH_PARALLEL_RASTER_FREERTOS to override.
+#ifndef MESH_PARALLEL_RASTER_FREERTOS
+#if defined(ESP32) || defined(ESP_PLATFORM)
+#define MESH_PARALLEL_RASTER_FREERTOS 1
+#else
+#define MESH_PARALLEL_RASTER_FREERTOS 0
+#endif
+#endif
+
+#if MESH_PARALLEL_RASTER_FREERTOS
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace stevesch
+{
+  // Rasterizes a frame on several cores: drawing calls are recorded and binned by horizontal
+  // band (as for StripRenderTarget), and present() has each worker take bands from a shared
+  // queue and replay their commands into its band of a full framebuffer.  Bands don't overlap,
+  // so pixel writes need no locks, and the queue (busiest bands first) keeps workers busy when
+  // the load is uneven; use bands a good deal shorter than height / workers.  The caller's
+  // thread is worker 0; the others are created by setWorkerCount().  The finished frame is
+  // handed to the sink as a single band.
+  class ParallelRenderTarget : public StripRenderTarget
+  {
+  public:
+    ParallelRenderTarget(int16_t width, int16_t height, int16_t bandHeight, uint workerCount,
+                         BandSink *sink = nullptr);
+    ~ParallelRenderTarget();
+
+    // returns the number of workers actually running (at least 1)
+    uint setWorkerCount(uint count);
+    uint workerCount() const { return 1 + (uint)mWorkers.size(); }
+
+    void present() override; // rasterizes the recorded bands, hands the frame to the sink, starts a new frame
+
+    const FrameBuffer565 &frame() const { return mFrame; }
+    size_t frameBytes() const { return (size_t)mWidth * mHeight * sizeof(uint16_t); }
+
+    // bands worker drew in the last frame (how evenly the queue spread the load)
+    uint bandsDrawn(uint worker) const;
+
+  protected:
+    struct Worker
+    {
+      ParallelRenderTarget *owner;
+      uint index;
+      uint bandsDrawn;
+#if MESH_PARALLEL_RASTER_FREERTOS
+      TaskHandle_t task;
+#else
+      std::thread thread;
+      uint generation; // of the last frame started
+#endif
+    };
+
+    uint drawBands(); // takes bands from the queue until it's empty; returns the number drawn
+    void workerLoop(Worker &worker);
+    void stopWorkers();
+#if MESH_PARALLEL_RASTER_FREERTOS
+    static void workerEntry(void *arg);
+#endif
+
+    FrameBuffer565 mFrame;
+    std::vector<uint16_t> mOrder;   // band indices, busiest first
+    std::vector<Worker *> mWorkers; // (workers 1..n-1; the caller is worker 0)
+    uint mCallerBands;
+
+    std::atomic<uint> mNextBand; // position in mOrder of the next band to take
+    std::atomic<uint> mWorkersBusy;
+    std::atomic<uint> mWorkersRunning;
+    std::atomic<bool> mStopRequested;
+#if !MESH_PARALLEL_RASTER_FREERTOS
+    std::mutex mWakeMutex;
+    std::condition_variable mWake;
+    uint mGeneration; // bumped (under mWakeMutex) to start a frame
+#endif
+  };
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "PolygonFill.h"
+
+#include <algorithm>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    // first pixel row/column whose center (n + 0.5) is at or beyond subpixel coordinate v
+    inline int32_t firstCenter(int32_t v)
+    {
+      return (v - (kSubpixelOne / 2) + (kSubpixelOne - 1)) >> kSubpixelBits;
+    }
+
+    // same, for a 32.32 coordinate
+    inline int32_t firstCenter64(int64_t v)
+    {
+      return (int32_t)((v - ((int64_t)1 << 31) + (((int64_t)1 << 32) - 1)) >> 32);
+    }
+  }
+
+  uint32_t PolygonFiller::fill(RenderTarget &target, const fixedPoint2 *points, uint count, uint16_t color, FillRule rule)
+  {
+    if (count < 3)
+    {
+      return 0;
+    }
+    const int32_t height = target.height();
+    const int32_t width = target.width();
+
+    // edge table: non-horizontal edges that cross at least one pixel center
+    mEdges.clear();
+    int32_t yMin = INT32_MAX;
+    int32_t yMax = INT32_MIN;
+    uint j = count - 1;
+    for (uint k = 0; k < count; ++k)
+    {
+      const fixedPoint2 *a = &points[j];
+      const fixedPoint2 *b = &points[k];
+      j = k;
+      int8_t winding = 1;
+      if (a->y > b->y)
+      {
+        std::swap(a, b);
+        winding = -1;
+      }
+      Edge e;
+      e.yStart = std::max(firstCenter(a->y), (int32_t)0);
+      e.yEnd = std::min(firstCenter(b->y), height);
+      if (e.yStart >= e.yEnd)
+      {
+        continue;
+      }
+      // slope and x at the first pixel center, in 32.32
+      const int64_t dy = b->y - a->y;
+      e.dxdy = ((int64_t)(b->x - a->x) << 32) / dy;
+      const int64_t yCenter = ((int64_t)e.yStart << kSubpixelBits) + (kSubpixelOne / 2);
+      e.x = ((int64_t)a->x << (32 - kSubpixelBits)) + ((e.dxdy * (yCenter - a->y)) >> kSubpixelBits);
+      e.winding = winding;
+      mEdges.push_back(e);
+      yMin = std::min(yMin, e.yStart);
+      yMax = std::max(yMax, e.yEnd);
+    }
+    if (mEdges.empty())
+    {
+      return 0;
+    }
+    std::sort(mEdges.begin(), mEdges.end(), [](const Edge &a, const Edge &b) { return a.yStart < b.yStart; });
+
+    uint32_t filled = 0;
+    uint nextEdge = 0;
+    mActive.clear();
+    for (int32_t y = yMin; y < yMax; ++y)
+    {
+      // retire finished edges, add starting ones
+      uint n = 0;
+      for (uint16_t i : mActive)
+      {
+        if (mEdges[i].yEnd > y)
+        {
+          mActive[n++] = i;
+        }
+      }
+      mActive.resize(n);
+      while ((nextEdge < mEdges.size()) && (mEdges[nextEdge].yStart == y))
+      {
+        mActive.push_back((uint16_t)nextEdge++);
+      }
+
+      // keep sorted by x (insertion sort: the order changes little between scanlines)
+      for (uint i = 1; i < mActive.size(); ++i)
+      {
+        const uint16_t e = mActive[i];
+        uint k = i;
+        while ((k > 0) && (mEdges[mActive[k - 1]].x > mEdges[e].x))
+        {
+          mActive[k] = mActive[k - 1];
+          --k;
+        }
+        mActive[k] = e;
+      }
+
+      // spans between crossings where the fill rule says "inside"
+      int wind = 0;
+      for (uint i = 0; (i + 1) < mActive.size(); ++i)
+      {
+        const Edge &e0 = mEdges[mActive[i]];
+        wind += (rule == kFillEvenOdd) ? 1 : e0.winding;
+        const bool bInside = (rule == kFillEvenOdd) ? ((wind & 1) != 0) : (wind != 0);
+        if (!bInside)
+        {
+          continue;
+        }
+        const int32_t x0 = std::max(firstCenter64(e0.x), (int32_t)0);
+        const int32_t x1 = std::min(firstCenter64(mEdges[mActive[i + 1]].x), width);
+        if (x1 > x0)
+        {
+          target.drawSpan((int16_t)x0, (int16_t)y, (int16_t)(x1 - x0), color);
+          filled += x1 - x0;
+        }
+      }
+
+      for (uint16_t i : mActive)
+      {
+        mEdges[i].x += mEdges[i].dxdy;
+      }
+    }
+    return filled;
+  }
+
+  void ICACHE_FLASH_ATTR PolygonFiller::compactMemory()
+  {
+    mEdges.clear();
+    mEdges.shrink_to_fit();
+    mActive.clear();
+    mActive.shrink_to_fit();
+  }
+
+  uint16_t shadeColor565(uint16_t color, float intensity)
+  {
+    const int32_t s = (int32_t)(stevesch::maxf(0.0f, stevesch::minf(intensity, 1.0f)) * 256.0f);
+    const int32_t r = (((color >> 11) & 0x1f) * s) >> 8;
+    const int32_t g = (((color >> 5) & 0x3f) * s) >> 8;
+    const int32_t b = ((color & 0x1f) * s) >> 8;
+    return (uint16_t)((r << 11) | (g << 5) | b);
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef STEVESCH_RENDER_RENDER_SPOLYGONFILL_H_
+#define STEVESCH_RENDER_RENDER_SPOLYGONFILL_H_
+
+#include "FixedPoint.h"
+#include "RenderTarget.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  enum FillRule
+  {
+    kFillEvenOdd, // inside where a ray crosses an odd number of edges
+    kFillNonZero  // inside where edge windings don't cancel
+  };
+
+  // Edge-table scanline fill of arbitrary (including non-convex and self-intersecting) polygons
+  // given in subpixel (28.4) screen coordinates.  Pixels whose centers are inside are filled,
+  // so polygons sharing an edge don't overlap or leave gaps.  Spans are clipped to the target.
+  // Scratch edge lists are kept between calls to avoid allocating per polygon.
+  class PolygonFiller
+  {
+  public:
+    PolygonFiller() {}
+
+    // returns the number of pixels filled
+    uint32_t fill(RenderTarget &target, const fixedPoint2 *points, uint count, uint16_t color,
+                  FillRule rule = kFillEvenOdd);
+
+    void compactMemory();
+
+  protected:
+    struct Edge
+    {
+      int32_t yStart; // first scanline (pixel row) crossed
+      int32_t yEnd;   // one past the last
+      int64_t x;      // x at the current scanline's pixel center, 32.32
+      int64_t dxdy;   // x step per scanline, 32.32
+      int8_t winding; // +1 downward, -1 upward
+    };
+
+    std::vector<Edge> mEdges;      // sorted by yStart
+    std::vector<uint16_t> mActive; // indices of edges crossing the current scanline, by x
+  };
+
+  // color scaled by intensity (0..1) per RGB565 channel
+  uint16_t shadeColor565(uint16_t color, float intensity);
+}
+
+#endif
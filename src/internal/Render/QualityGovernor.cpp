@@ -0,0 +1,236 @@
+#include "QualityGovernor.h"
+
+#include <algorithm>
+#include <string.h>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    constexpr uint kMaxRestoreDelay = 8; // (multiple of the restore frames)
+
+    const char *const kPhaseNames[kPhaseCount] = {"update", "cull", "transform", "raster", "present"};
+  }
+
+  const char *phaseName(GovernorPhase phase)
+  {
+    return ((uint)phase < kPhaseCount) ? kPhaseNames[phase] : "?";
+  }
+
+  QualityGovernor::QualityGovernor()
+      : mClock(&mSystemClock), mBudgetMicros(33333), mHeadroom(0.2f), mRestoreFrames(30), mLodLevels(1),
+        mSkipRadius(4.0f), mSkipSteps(3), mMinInstances(1), mMaxInstances(1), mSimulationSteps(1), mLevel(0),
+        mFrameStart(0), mPhaseStart(0), mPhase(-1), mUnderFrames(0),
+        mRestoreDelay(1), mJustRestored(false)
+  {
+    memset(mPhaseMicros, 0, sizeof(mPhaseMicros));
+    memset(mPhaseAverageMicros, 0, sizeof(mPhaseAverageMicros));
+    memset(&mStats, 0, sizeof(mStats));
+    rebuildLevels();
+  }
+
+  void QualityGovernor::setClock(FrameClock *clock)
+  {
+    mClock = clock ? clock : &mSystemClock;
+    mPhase = -1; // (a frame in progress was timed on the other clock)
+  }
+
+  void QualityGovernor::setRestoreFrames(uint frames)
+  {
+    mRestoreFrames = std::max(frames, 1u);
+  }
+
+  void QualityGovernor::setLodLevels(uint count)
+  {
+    mLodLevels = std::max(count, 1u);
+    rebuildLevels();
+  }
+
+  void QualityGovernor::setSkipRadius(float firstRadius, uint steps)
+  {
+    mSkipRadius = firstRadius;
+    mSkipSteps = steps;
+    rebuildLevels();
+  }
+
+  void QualityGovernor::setInstanceRange(uint minInstances, uint maxInstances)
+  {
+    mMinInstances = std::max(minInstances, 1u);
+    mMaxInstances = std::max(maxInstances, mMinInstances);
+    rebuildLevels();
+  }
+
+  void QualityGovernor::setSimulationSteps(uint steps)
+  {
+    mSimulationSteps = steps;
+    rebuildLevels();
+  }
+
+  void ICACHE_FLASH_ATTR QualityGovernor::rebuildLevels()
+  {
+    // each level degrades one setting of the one before, in the order of the class comment
+    mLevels.clear();
+    QualitySettings q = {0, 0.0f, mMaxInstances, 1};
+    mLevels.push_back(q);
+    for (uint i = 1; i < mLodLevels; ++i)
+    {
+      q.lodBias = i;
+      mLevels.push_back(q);
+    }
+    float radius = mSkipRadius;
+    for (uint i = 0; (i < mSkipSteps) && (radius > 0.0f); ++i)
+    {
+      q.minScreenRadius = radius;
+      mLevels.push_back(q);
+      radius *= 2.0f;
+    }
+    while (q.instanceLimit > mMinInstances)
+    {
+      q.instanceLimit = std::max(q.instanceLimit / 2, mMinInstances);
+      mLevels.push_back(q);
+    }
+    for (uint i = 0; i < mSimulationSteps; ++i)
+    {
+      q.simulationInterval *= 2;
+      mLevels.push_back(q);
+    }
+
+    mLevel = std::min(mLevel, (uint)mLevels.size() - 1);
+    mStats.level = mLevel;
+    mStats.levelCount = (uint)mLevels.size();
+  }
+
+  uint32_t QualityGovernor::now()
+  {
+    return mClock->micros();
+  }
+
+  void QualityGovernor::beginFrame()
+  {
+    mFrameStart = now();
+    mPhaseStart = mFrameStart;
+    mPhase = kPhaseUpdate; // (until another phase begins)
+    memset(mPhaseMicros, 0, sizeof(mPhaseMicros));
+  }
+
+  void QualityGovernor::beginPhase(GovernorPhase phase)
+  {
+    const uint32_t t = now();
+    if (mPhase >= 0)
+    {
+      mPhaseMicros[mPhase] += t - mPhaseStart;
+    }
+    mPhaseStart = t;
+    mPhase = phase;
+  }
+
+  bool QualityGovernor::endFrame()
+  {
+    if (mPhase < 0)
+    {
+      return false; // (no frame begun)
+    }
+    const uint32_t t = now();
+    mPhaseMicros[mPhase] += t - mPhaseStart;
+    mPhase = -1;
+
+    const uint32_t frameMicros = t - mFrameStart;
+    mStats.frameMicros = frameMicros;
+    for (uint i = 0; i < kPhaseCount; ++i)
+    {
+      mPhaseAverageMicros[i] += kFrameAverageFactor * ((float)mPhaseMicros[i] - mPhaseAverageMicros[i]);
+      mStats.phaseMicros[i] = mPhaseMicros[i];
+      mStats.phaseAverageMicros[i] = (uint32_t)mPhaseAverageMicros[i];
+    }
+    ++mStats.frames;
+    mStats.framesOverBudget += (frameMicros > mBudgetMicros) ? 1 : 0;
+
+    const uint lastLevel = mLevel;
+    const bool bChanged = decide(frameMicros);
+    if (bChanged)
+    {
+      const bool bDegraded = (mLevel > lastLevel);
+      mStats.lastDecision = bDegraded ? kDecisionDegrade : kDecisionRestore;
+      mStats.lastDecisionFrame = mStats.frames;
+      mStats.degradations += bDegraded ? 1 : 0;
+      mStats.restorations += bDegraded ? 0 : 1;
+    }
+    mStats.level = mLevel;
+    return bChanged;
+  }
+
+  bool QualityGovernor::decide(uint32_t frameMicros)
+  {
+    const bool bSettled = mAverage.add(frameMicros);
+    const float average = mAverage.averageMicros();
+    if (average > 0.0f)
+    {
+      mStats.averageMicros = (uint32_t)average; // (else still the change's transition)
+    }
+    if (!bSettled)
+    {
+      return false;
+    }
+
+    const float budget = (float)mBudgetMicros;
+    if (average > budget)
+    {
+      if (mJustRestored)
+      {
+        mRestoreDelay = std::min(2 * mRestoreDelay, kMaxRestoreDelay); // (the restored level didn't hold)
+      }
+      mJustRestored = false;
+      mUnderFrames = 0;
+      if ((mLevel + 1) >= mLevels.size())
+      {
+        return false; // (already the lowest quality)
+      }
+      setLevel(mLevel + 1);
+      return true;
+    }
+
+    if (mJustRestored)
+    {
+      mRestoreDelay = 1;
+      mJustRestored = false;
+    }
+    if (average < (budget * (1.0f - mHeadroom)))
+    {
+      ++mUnderFrames;
+      if ((mLevel > 0) && (mUnderFrames >= (mRestoreFrames * mRestoreDelay)))
+      {
+        setLevel(mLevel - 1);
+        mJustRestored = true;
+        return true;
+      }
+    }
+    else
+    {
+      mUnderFrames = 0;
+    }
+    return false;
+  }
+
+  void QualityGovernor::setLevel(uint level)
+  {
+    mLevel = std::min(level, (uint)mLevels.size() - 1);
+    mStats.level = mLevel;
+    mAverage.restart();
+    mUnderFrames = 0;
+    mJustRestored = false;
+  }
+
+  void QualityGovernor::resetStats()
+  {
+    mStats.frames = 0;
+    mStats.framesOverBudget = 0;
+    mStats.degradations = 0;
+    mStats.restorations = 0;
+    mStats.lastDecision = kDecisionNone;
+    mStats.lastDecisionFrame = 0;
+  }
+}
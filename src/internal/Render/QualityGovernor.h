@@ -0,0 +1,134 @@
+#ifndef STEVESCH_RENDER_RENDER_SQUALITYGOVERNOR_H_
+#define STEVESCH_RENDER_RENDER_SQUALITYGOVERNOR_H_
+
+#include "FrameTiming.h"
+
+#include <stevesch-MathVec.h>
+
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  // the timed phases of a frame
+  enum GovernorPhase
+  {
+    kPhaseUpdate = 0,
+    kPhaseCull,
+    kPhaseTransform,
+    kPhaseRaster,
+    kPhasePresent,
+    kPhaseCount
+  };
+  const char *phaseName(GovernorPhase phase);
+
+  // what the renderer should draw at a quality level
+  struct QualitySettings
+  {
+    uint lodBias;            // levels of detail coarser than distance alone would pick
+    float minScreenRadius;   // instances smaller than this (pixels) are skipped (0: none)
+    uint instanceLimit;      // instances drawn at most
+    uint simulationInterval; // frames per simulation update (1: every frame)
+  };
+
+  enum GovernorDecision
+  {
+    kDecisionNone = 0,
+    kDecisionDegrade,
+    kDecisionRestore
+  };
+
+  struct GovernorStats
+  {
+    uint32_t frameMicros;                     // last frame
+    uint32_t averageMicros;                   // (smoothed; what the last decision was based on)
+    uint32_t phaseMicros[kPhaseCount];        // last frame
+    uint32_t phaseAverageMicros[kPhaseCount]; // (smoothed)
+    uint level;                               // 0: full quality
+    uint levelCount;
+    uint32_t frames;
+    uint32_t framesOverBudget;
+    uint32_t degradations;
+    uint32_t restorations;
+    GovernorDecision lastDecision;
+    uint32_t lastDecisionFrame;
+  };
+
+  // Holds a per-frame time budget by stepping through quality levels.  Each frame is timed
+  // phase by phase (beginFrame(), beginPhase() as each phase starts, endFrame()), and while
+  // the smoothed frame time runs over budget quality drops a level at a time, in a fixed
+  // order: coarser levels of detail, then skipping ever larger small (or distant) instances,
+  // then fewer instances, then simulating less often than drawing.  Quality climbs back a
+  // level once frames have run under budget by the headroom fraction for a while; a level
+  // that immediately runs over again doubles that wait (up to a limit).  Each change is given
+  // a few frames to settle before the next decision.
+  class QualityGovernor
+  {
+  public:
+    QualityGovernor();
+
+    // the clock must outlive the governor (nullptr: the system clock)
+    void setClock(FrameClock *clock);
+
+    void setBudgetMicros(uint32_t micros) { mBudgetMicros = micros; }
+    uint32_t budgetMicros() const { return mBudgetMicros; }
+    void setHeadroom(float fraction) { mHeadroom = fraction; } // (of the budget, to restore)
+    void setRestoreFrames(uint frames);                         // (under budget, before restoring)
+
+    // the level table is rebuilt by these (and the level kept, if it still exists)
+    void setLodLevels(uint count);                               // (1: no coarser levels)
+    void setSkipRadius(float firstRadius, uint steps);           // (each step doubles the radius)
+    void setInstanceRange(uint minInstances, uint maxInstances); // (halved down to the minimum)
+    void setSimulationSteps(uint steps);                         // (each step doubles the interval)
+
+    void beginFrame();
+    void beginPhase(GovernorPhase phase); // (a phase runs until the next begins; they may repeat)
+    // returns true if the quality level changed (for the next frame)
+    bool endFrame();
+
+    uint level() const { return mLevel; }
+    uint levelCount() const { return (uint)mLevels.size(); }
+    void setLevel(uint level); // (restarts the average)
+    const QualitySettings &settings() const { return mLevels[mLevel]; }
+    const QualitySettings &levelSettings(uint level) const { return mLevels[level]; }
+
+    const GovernorStats &stats() const { return mStats; }
+    void resetStats(); // (counts only; the level and averages stay)
+
+  protected:
+    void rebuildLevels();
+    uint32_t now();
+    bool decide(uint32_t frameMicros);
+
+    FrameClock *mClock;
+    SystemFrameClock mSystemClock;
+
+    uint32_t mBudgetMicros;
+    float mHeadroom;
+    uint mRestoreFrames;
+    uint mLodLevels;
+    float mSkipRadius;
+    uint mSkipSteps;
+    uint mMinInstances;
+    uint mMaxInstances;
+    uint mSimulationSteps;
+
+    std::vector<QualitySettings> mLevels;
+    uint mLevel;
+
+    uint32_t mFrameStart;
+    uint32_t mPhaseStart;
+    int mPhase; // (-1 between frames)
+    uint32_t mPhaseMicros[kPhaseCount];
+
+    SettledFrameAverage mAverage; // (restarted at each level)
+    float mPhaseAverageMicros[kPhaseCount];
+    uint mUnderFrames;  // consecutive frames under budget by the headroom
+    uint mRestoreDelay; // current multiple of mRestoreFrames
+    bool mJustRestored; // (no decision since the last restore)
+
+    GovernorStats mStats;
+  };
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef STEVESCH_RENDER_RENDER_SRENDERTARGET_H_
+#define STEVESCH_RENDER_RENDER_SRENDERTARGET_H_
+
+#include "LineRaster.h"
+
+#include <stdint.h>
+
+namespace stevesch
+{
+  struct fixedPoint2;
+
+  // Minimal drawing surface for the renderer: lines, horizontal spans and rectangles in
+  // RGB565, plus clear and present.  Implementations clip to their own bounds.
+  class RenderTarget
+  {
+  public:
+    virtual ~RenderTarget() {}
+
+    virtual int16_t width() const = 0;
+    virtual int16_t height() const = 0;
+
+    virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) = 0;
+    virtual void drawLines(const ScreenLine *lines, uint32_t count)
+    {
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        drawLine(lines[i].x0, lines[i].y0, lines[i].x1, lines[i].y1, lines[i].color);
+      }
+    }
+    virtual void drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color) = 0; // pixels [x, x + w) of row y
+    virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) = 0;
+    virtual void clear(uint16_t color) = 0;
+
+    // Polygons in subpixel (28.4) coordinates, filled even-odd.  Targets that keep primitives
+    // whole (command lists) take them here and return true; others return false, and the
+    // caller fills the polygon as spans.
+    virtual bool fillPolygon(const fixedPoint2 * /*points*/, uint /*count*/, uint16_t /*color*/) { return false; }
+
+    // make the frame visible (no-op for targets drawn directly, or whose owner presents them)
+    virtual void present() {}
+  };
+}
+
+#endif
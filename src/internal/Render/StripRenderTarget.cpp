@@ -0,0 +1,158 @@
+#include "StripRenderTarget.h"
+
+#include <algorithm>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  StripRenderTarget::StripRenderTarget(int16_t width, int16_t height, int16_t bandHeight, BandSink *sink)
+      : StripRenderTarget(width, height, bandHeight, sink, true)
+  {
+  }
+
+  StripRenderTarget::StripRenderTarget(int16_t width, int16_t height, int16_t bandHeight, BandSink *sink,
+                                       bool bBandBuffer)
+      : mWidth(width), mHeight(height), mBandHeight(std::max((int16_t)1, std::min(bandHeight, height))),
+        mClearColor(0), mSink(sink), mBand(bBandBuffer ? width : 0, bBandBuffer ? mBandHeight : 0)
+  {
+    mBands.resize((height + mBandHeight - 1) / mBandHeight);
+  }
+
+  void StripRenderTarget::bin(uint32_t command, int32_t yMin, int32_t yMax)
+  {
+    yMin = std::max(yMin, (int32_t)0);
+    yMax = std::min(yMax, (int32_t)mHeight - 1);
+    if (yMin > yMax)
+    {
+      return;
+    }
+    const int32_t bh = mBandHeight;
+    for (int32_t band = yMin / bh; band <= (yMax / bh); ++band)
+    {
+      mBands[band].push_back(command);
+    }
+  }
+
+  void StripRenderTarget::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+  {
+    const uint32_t index = mLines.size();
+    mLines.push_back(ScreenLine{x0, y0, x1, y1, color});
+    bin((kCommandLine << kCommandShift) | index, std::min(y0, y1), std::max(y0, y1));
+  }
+
+  void StripRenderTarget::drawLines(const ScreenLine *lines, uint32_t count)
+  {
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      drawLine(lines[i].x0, lines[i].y0, lines[i].x1, lines[i].y1, lines[i].color);
+    }
+  }
+
+  void StripRenderTarget::drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color)
+  {
+    if ((y < 0) || (y >= mHeight) || (w <= 0))
+    {
+      return;
+    }
+    const uint32_t index = mSpans.size();
+    mSpans.push_back(Span{x, y, w, color});
+    mBands[y / mBandHeight].push_back((kCommandSpan << kCommandShift) | index);
+  }
+
+  void StripRenderTarget::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+  {
+    if ((w <= 0) || (h <= 0))
+    {
+      return;
+    }
+    const uint32_t index = mRects.size();
+    mRects.push_back(Rect{x, y, w, h, color});
+    bin((kCommandRect << kCommandShift) | index, y, (int32_t)y + h - 1);
+  }
+
+  void StripRenderTarget::clear(uint16_t color)
+  {
+    mClearColor = color;
+    mLines.clear();
+    mSpans.clear();
+    mRects.clear();
+    for (std::vector<uint32_t> &band : mBands)
+    {
+      band.clear();
+    }
+  }
+
+  void StripRenderTarget::replayBand(uint band, RenderTarget &target) const
+  {
+    const int16_t y0 = (int16_t)(band * mBandHeight);
+    for (uint32_t command : mBands[band])
+    {
+      const uint32_t index = command & kIndexMask;
+      switch (command >> kCommandShift)
+      {
+      case kCommandLine:
+      {
+        const ScreenLine &l = mLines[index];
+        target.drawLine(l.x0, l.y0 - y0, l.x1, l.y1 - y0, l.color);
+        break;
+      }
+      case kCommandSpan:
+      {
+        const Span &s = mSpans[index];
+        target.drawSpan(s.x, s.y - y0, s.w, s.color);
+        break;
+      }
+      default:
+      {
+        const Rect &r = mRects[index];
+        target.fillRect(r.x, r.y - y0, r.w, r.h, r.color);
+        break;
+      }
+      }
+    }
+  }
+
+  void StripRenderTarget::present()
+  {
+    const int16_t bh = mBandHeight;
+    for (uint b = 0; b < mBands.size(); ++b)
+    {
+      const int16_t y0 = (int16_t)(b * bh);
+      mBand.clear(mClearColor);
+      replayBand(b, mBand);
+
+      if (mSink)
+      {
+        mSink->pushBand(y0, mWidth, std::min(bh, (int16_t)(mHeight - y0)), mBand.pixels());
+      }
+    }
+    mBand.present();
+    clear(mClearColor);
+  }
+
+  size_t StripRenderTarget::commandBytes() const
+  {
+    size_t bytes = mLines.capacity() * sizeof(ScreenLine) + mSpans.capacity() * sizeof(Span) +
+                   mRects.capacity() * sizeof(Rect);
+    for (const std::vector<uint32_t> &band : mBands)
+    {
+      bytes += band.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+  }
+
+  void ICACHE_FLASH_ATTR StripRenderTarget::compactMemory()
+  {
+    clear(mClearColor);
+    mLines.shrink_to_fit();
+    mSpans.shrink_to_fit();
+    mRects.shrink_to_fit();
+    for (std::vector<uint32_t> &band : mBands)
+    {
+      band.shrink_to_fit();
+    }
+  }
+}
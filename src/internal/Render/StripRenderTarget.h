@@ -0,0 +1,103 @@
+#ifndef STEVESCH_RENDER_RENDER_SSTRIPRENDERTARGET_H_
+#define STEVESCH_RENDER_RENDER_SSTRIPRENDERTARGET_H_
+
+#include "FrameBuffer565.h"
+#include "RenderTarget.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  // receives each finished band of a StripRenderTarget (rows [y, y + height), full width,
+  // packed with a stride of the target's width)
+  class BandSink
+  {
+  public:
+    virtual ~BandSink() {}
+    virtual void pushBand(int16_t y, int16_t width, int16_t height, const uint16_t *pixels) = 0;
+  };
+
+  // Renders a frame in horizontal bands through one band-sized buffer, for screens whose full
+  // frame doesn't fit in RAM.  Drawing calls are recorded and binned by the bands they touch;
+  // present() then draws each band in turn (replaying its commands in their original order,
+  // clipped to the band) and hands it to the sink before starting the next.  Lines crossing a
+  // band are drawn with the full line's Bresenham steps, so the assembled frame is
+  // pixel-identical to drawing into a full framebuffer.
+  class StripRenderTarget : public RenderTarget
+  {
+  public:
+    StripRenderTarget(int16_t width, int16_t height, int16_t bandHeight, BandSink *sink = nullptr);
+    ~StripRenderTarget() {}
+
+    void setSink(BandSink *sink) { mSink = sink; }
+
+    int16_t width() const override { return mWidth; }
+    int16_t height() const override { return mHeight; }
+    int16_t bandHeight() const { return mBandHeight; }
+    uint bandCount() const { return mBands.size(); }
+
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override;
+    void drawLines(const ScreenLine *lines, uint32_t count) override;
+    void drawSpan(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+    void clear(uint16_t color) override; // discards recorded commands; bands start with color
+    void present() override;            // draws and pushes every band, then starts a new frame
+
+    // memory held: the band buffer, and the command lists (as currently allocated)
+    size_t bandBytes() const { return (size_t)mWidth * mBand.height() * sizeof(uint16_t); }
+    size_t commandBytes() const;
+
+    void compactMemory(); // release command lists (between frames)
+
+  protected:
+    // (without a band buffer, for subclasses that replay bands somewhere else)
+    StripRenderTarget(int16_t width, int16_t height, int16_t bandHeight, BandSink *sink, bool bBandBuffer);
+
+    struct Span
+    {
+      int16_t x;
+      int16_t y;
+      int16_t w;
+      uint16_t color;
+    };
+
+    struct Rect
+    {
+      int16_t x;
+      int16_t y;
+      int16_t w;
+      int16_t h;
+      uint16_t color;
+    };
+
+    // a band's commands: (type << kCommandShift) | index into mLines/mSpans/mRects
+    enum CommandType : uint32_t
+    {
+      kCommandLine = 0,
+      kCommandSpan = 1,
+      kCommandRect = 2
+    };
+    static constexpr uint32_t kCommandShift = 30;
+    static constexpr uint32_t kIndexMask = (1u << kCommandShift) - 1;
+
+    void bin(uint32_t command, int32_t yMin, int32_t yMax);
+    // draws band's commands into target, translated up so the band's first row is target's row 0
+    void replayBand(uint band, RenderTarget &target) const;
+
+    int16_t mWidth;
+    int16_t mHeight;
+    int16_t mBandHeight;
+    uint16_t mClearColor;
+    BandSink *mSink;
+    FrameBuffer565 mBand;
+
+    std::vector<ScreenLine> mLines;
+    std::vector<Span> mSpans;
+    std::vector<Rect> mRects;
+    std::vector<std::vector<uint32_t>> mBands; // commands touching each band, in drawing order
+  };
+}
+
+#endif
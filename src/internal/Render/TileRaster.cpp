@@ -0,0 +1,430 @@
+#include "TileRaster.h"
+
+#include <algorithm>
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    constexpr uint kMaxStackPolygon = 32; // larger polygons take heap scratch for triangulation
+    constexpr int32_t kHalfSubpixel = kSubpixelOne / 2;
+    constexpr float kDepthScale = 256.0f; // depth is stepped in 24.8
+    constexpr float kDepthLimit = 1.0e6f;
+
+    inline int64_t cross(const fixedPoint2 &a, const fixedPoint2 &b, const fixedPoint2 &c)
+    {
+      return (int64_t)(b.x - a.x) * (c.y - a.y) - (int64_t)(b.y - a.y) * (c.x - a.x);
+    }
+
+    // first and last pixel whose center (n + 0.5) is within subpixel range [lo, hi]
+    inline int32_t firstCenter(int32_t v) { return (v - kHalfSubpixel + (kSubpixelOne - 1)) >> kSubpixelBits; }
+    inline int32_t lastCenter(int32_t v) { return (v - kHalfSubpixel) >> kSubpixelBits; }
+
+    inline int32_t toDepthStep(float f)
+    {
+      return (int32_t)(stevesch::maxf(-kDepthLimit, stevesch::minf(f, kDepthLimit)) * kDepthScale);
+    }
+
+    // edge function of (a, b) at subpixel point (sx, sy); positive inside a counter-clockwise triangle
+    inline int64_t edgeAt(int32_t ax, int32_t ay, int32_t bx, int32_t by, int32_t sx, int32_t sy)
+    {
+      return (int64_t)(bx - ax) * (sy - ay) - (int64_t)(by - ay) * (sx - ax);
+    }
+
+    // true if corner p is inside (or on) triangle abc of orientation sign
+    inline bool inTriangle(const fixedPoint2 &p, const fixedPoint2 &a, const fixedPoint2 &b, const fixedPoint2 &c,
+                           int sign)
+    {
+      return ((cross(a, b, p) * sign) >= 0) && ((cross(b, c, p) * sign) >= 0) && ((cross(c, a, p) * sign) >= 0);
+    }
+
+    inline bool samePoint(const fixedPoint2 &a, const fixedPoint2 &b) { return (a.x == b.x) && (a.y == b.y); }
+  }
+
+  uint triangulatePolygon(uint16_t *indices, const fixedPoint2 *points, uint count)
+  {
+    if (count < 3)
+    {
+      return 0;
+    }
+
+    // orientation from the signed area
+    int64_t area = 0;
+    for (uint j = count - 1, k = 0; k < count; j = k++)
+    {
+      area += (int64_t)points[j].x * points[k].y - (int64_t)points[k].x * points[j].y;
+    }
+    const int sign = (area < 0) ? -1 : 1;
+
+    bool bConvex = true;
+    for (uint i = 0; bConvex && (i < count); ++i)
+    {
+      const uint prev = (i + count - 1) % count;
+      const uint next = (i + 1) % count;
+      bConvex = (cross(points[prev], points[i], points[next]) * sign) >= 0;
+    }
+
+    uint16_t *out = indices;
+    if (bConvex)
+    {
+      for (uint i = 1; (i + 1) < count; ++i)
+      {
+        *out++ = 0;
+        *out++ = (uint16_t)i;
+        *out++ = (uint16_t)(i + 1);
+      }
+      return count - 2;
+    }
+
+    // ear clipping over the remaining corners
+    uint16_t stackRemaining[kMaxStackPolygon];
+    std::vector<uint16_t> heapRemaining;
+    uint16_t *remaining = stackRemaining;
+    if (count > kMaxStackPolygon)
+    {
+      heapRemaining.resize(count);
+      remaining = &heapRemaining[0];
+    }
+    for (uint i = 0; i < count; ++i)
+    {
+      remaining[i] = (uint16_t)i;
+    }
+
+    uint n = count;
+    while (n > 3)
+    {
+      bool bClipped = false;
+      for (uint i = 0; i < n; ++i)
+      {
+        const fixedPoint2 &a = points[remaining[(i + n - 1) % n]];
+        const fixedPoint2 &b = points[remaining[i]];
+        const fixedPoint2 &c = points[remaining[(i + 1) % n]];
+        if ((cross(a, b, c) * sign) <= 0)
+        {
+          continue; // reflex (or degenerate) corner
+        }
+
+        bool bEar = true;
+        for (uint k = 0; bEar && (k < n); ++k)
+        {
+          const fixedPoint2 &p = points[remaining[k]];
+          if (samePoint(p, a) || samePoint(p, b) || samePoint(p, c))
+          {
+            continue;
+          }
+          bEar = !inTriangle(p, a, b, c, sign);
+        }
+        if (!bEar)
+        {
+          continue;
+        }
+
+        *out++ = remaining[(i + n - 1) % n];
+        *out++ = remaining[i];
+        *out++ = remaining[(i + 1) % n];
+        std::copy(remaining + i + 1, remaining + n, remaining + i);
+        --n;
+        bClipped = true;
+        break;
+      }
+
+      if (!bClipped)
+      {
+        break; // no ear (self-intersecting): finish as a fan
+      }
+    }
+
+    for (uint i = 1; (i + 1) < n; ++i)
+    {
+      *out++ = remaining[0];
+      *out++ = remaining[i];
+      *out++ = remaining[i + 1];
+    }
+    return count - 2;
+  }
+
+  TileRasterizer::TileRasterizer() : mWidth(0), mHeight(0), mTileSize(0), mTilesX(0), mTilesY(0)
+  {
+  }
+
+  void TileRasterizer::begin(int16_t width, int16_t height, uint tileSize)
+  {
+    mWidth = std::max(width, (int16_t)0);
+    mHeight = std::max(height, (int16_t)0);
+    mTileSize = std::max(tileSize, 1u);
+    mTilesX = (mWidth + mTileSize - 1) / mTileSize;
+    mTilesY = (mHeight + mTileSize - 1) / mTileSize;
+
+    mTris.clear();
+    mBins.resize(mTilesX * mTilesY);
+    for (std::vector<uint32_t> &bin : mBins)
+    {
+      bin.clear();
+    }
+    mColor.resize(mTileSize * mTileSize);
+    mDepth.resize(mTileSize * mTileSize);
+  }
+
+  uint TileRasterizer::addPolygon(const DepthVertex *verts, uint count, uint16_t color)
+  {
+    if (count < 3)
+    {
+      return 0;
+    }
+    if (count == 3)
+    {
+      addTriangle(verts[0], verts[1], verts[2], color);
+      return 1;
+    }
+
+    mPoints.resize(count);
+    for (uint i = 0; i < count; ++i)
+    {
+      mPoints[i] = fixedPoint2{verts[i].x, verts[i].y};
+    }
+    mIndices.resize(3 * (count - 2));
+    const uint triCount = triangulatePolygon(&mIndices[0], &mPoints[0], count);
+    for (uint t = 0; t < triCount; ++t)
+    {
+      addTriangle(verts[mIndices[3 * t]], verts[mIndices[3 * t + 1]], verts[mIndices[3 * t + 2]], color);
+    }
+    return triCount;
+  }
+
+  void TileRasterizer::addTriangle(const DepthVertex &a, const DepthVertex &b, const DepthVertex &c, uint16_t color)
+  {
+    const int64_t area = edgeAt(a.x, a.y, b.x, b.y, c.x, c.y);
+    if (area == 0)
+    {
+      return;
+    }
+    const DepthVertex *v[3] = {&a, &b, &c};
+    if (area < 0)
+    {
+      std::swap(v[1], v[2]);
+    }
+
+    Triangle t;
+    int32_t xLo = v[0]->x, xHi = v[0]->x, yLo = v[0]->y, yHi = v[0]->y;
+    for (uint k = 0; k < 3; ++k)
+    {
+      t.x[k] = v[k]->x;
+      t.y[k] = v[k]->y;
+      xLo = std::min(xLo, t.x[k]);
+      xHi = std::max(xHi, t.x[k]);
+      yLo = std::min(yLo, t.y[k]);
+      yHi = std::max(yHi, t.y[k]);
+    }
+    const int32_t xMin = std::max(firstCenter(xLo), (int32_t)0);
+    const int32_t xMax = std::min(lastCenter(xHi), (int32_t)mWidth - 1);
+    const int32_t yMin = std::max(firstCenter(yLo), (int32_t)0);
+    const int32_t yMax = std::min(lastCenter(yHi), (int32_t)mHeight - 1);
+    if ((xMin > xMax) || (yMin > yMax))
+    {
+      return;
+    }
+    t.xMin = (int16_t)xMin;
+    t.xMax = (int16_t)xMax;
+    t.yMin = (int16_t)yMin;
+    t.yMax = (int16_t)yMax;
+
+    // depth plane over pixel indices (pixel n's center is at n + 0.5)
+    const float kToPixel = 1.0f / (float)kSubpixelOne;
+    const float x0 = (float)t.x[0] * kToPixel - 0.5f;
+    const float y0 = (float)t.y[0] * kToPixel - 0.5f;
+    const float dx1 = (float)(t.x[1] - t.x[0]) * kToPixel;
+    const float dy1 = (float)(t.y[1] - t.y[0]) * kToPixel;
+    const float dx2 = (float)(t.x[2] - t.x[0]) * kToPixel;
+    const float dy2 = (float)(t.y[2] - t.y[0]) * kToPixel;
+    const float dz1 = (float)v[1]->z - (float)v[0]->z;
+    const float dz2 = (float)v[2]->z - (float)v[0]->z;
+    const float invDen = 1.0f / (dx1 * dy2 - dx2 * dy1);
+    t.zA = (dz1 * dy2 - dz2 * dy1) * invDen;
+    t.zB = (dx1 * dz2 - dx2 * dz1) * invDen;
+    t.zC = (float)v[0]->z - t.zA * x0 - t.zB * y0;
+    t.color = color;
+
+    const uint index = mTris.size();
+    mTris.push_back(t);
+
+    const uint tx0 = xMin / mTileSize;
+    const uint tx1 = xMax / mTileSize;
+    const uint ty0 = yMin / mTileSize;
+    const uint ty1 = yMax / mTileSize;
+    if ((tx0 == tx1) && (ty0 == ty1))
+    {
+      mBins[ty0 * mTilesX + tx0].push_back(index);
+      return;
+    }
+
+    // spanning several tiles: skip tiles entirely outside an edge (tested at the tile's pixel
+    // center that is farthest inside that edge)
+    const int32_t step = (int32_t)mTileSize * kSubpixelOne;
+    for (uint ty = ty0; ty <= ty1; ++ty)
+    {
+      const int32_t top = (int32_t)ty * step + kHalfSubpixel;
+      const int32_t bottom = top + step - kSubpixelOne;
+      for (uint tx = tx0; tx <= tx1; ++tx)
+      {
+        const int32_t left = (int32_t)tx * step + kHalfSubpixel;
+        const int32_t right = left + step - kSubpixelOne;
+        bool bOverlap = true;
+        for (uint k = 0; bOverlap && (k < 3); ++k)
+        {
+          const uint k1 = (k + 1) % 3;
+          const int32_t sx = (t.y[k1] < t.y[k]) ? right : left; // (edge x step is -dy)
+          const int32_t sy = (t.x[k1] > t.x[k]) ? bottom : top;
+          bOverlap = edgeAt(t.x[k], t.y[k], t.x[k1], t.y[k1], sx, sy) >= 0;
+        }
+        if (bOverlap)
+        {
+          mBins[ty * mTilesX + tx].push_back(index);
+        }
+      }
+    }
+  }
+
+  uint32_t TileRasterizer::rasterizeTile(RenderTarget &target, uint tx, uint ty)
+  {
+    const std::vector<uint32_t> &bin = mBins[ty * mTilesX + tx];
+    if (bin.empty())
+    {
+      return 0;
+    }
+
+    const int32_t x0 = (int32_t)(tx * mTileSize);
+    const int32_t y0 = (int32_t)(ty * mTileSize);
+    const int32_t x1 = std::min(x0 + (int32_t)mTileSize, (int32_t)mWidth) - 1; // inclusive
+    const int32_t y1 = std::min(y0 + (int32_t)mTileSize, (int32_t)mHeight) - 1;
+    const uint stride = mTileSize;
+    std::fill(mDepth.begin(), mDepth.begin() + (y1 - y0 + 1) * stride, 0);
+
+    for (uint32_t index : bin)
+    {
+      const Triangle &t = mTris[index];
+      const int32_t bx0 = std::max((int32_t)t.xMin, x0);
+      const int32_t bx1 = std::min((int32_t)t.xMax, x1);
+      const int32_t by0 = std::max((int32_t)t.yMin, y0);
+      const int32_t by1 = std::min((int32_t)t.yMax, y1);
+
+      // edge functions at the first pixel center, and their steps per pixel; edges that are
+      // not top or left are biased so that exactly-on-edge samples belong to one triangle
+      const int32_t sx = (bx0 << kSubpixelBits) + kHalfSubpixel;
+      const int32_t sy = (by0 << kSubpixelBits) + kHalfSubpixel;
+      int64_t eRow[3];
+      int64_t eStepX[3];
+      int64_t eStepY[3];
+      for (uint k = 0; k < 3; ++k)
+      {
+        const uint k1 = (k + 1) % 3;
+        const int32_t dx = t.x[k1] - t.x[k];
+        const int32_t dy = t.y[k1] - t.y[k];
+        const bool bTopLeft = (dy < 0) || ((dy == 0) && (dx > 0));
+        eRow[k] = edgeAt(t.x[k], t.y[k], t.x[k1], t.y[k1], sx, sy) - (bTopLeft ? 0 : 1);
+        eStepX[k] = -(int64_t)dy * kSubpixelOne;
+        eStepY[k] = (int64_t)dx * kSubpixelOne;
+      }
+
+      int32_t zRow = toDepthStep(t.zA * (float)bx0 + t.zB * (float)by0 + t.zC);
+      const int32_t zStepX = toDepthStep(t.zA);
+      const int32_t zStepY = toDepthStep(t.zB);
+      const uint16_t color = t.color;
+
+      for (int32_t y = by0; y <= by1; ++y)
+      {
+        int64_t e0 = eRow[0];
+        int64_t e1 = eRow[1];
+        int64_t e2 = eRow[2];
+        int32_t z = zRow;
+        uint16_t *depth = &mDepth[(y - y0) * stride + (bx0 - x0)];
+        uint16_t *pixel = &mColor[(y - y0) * stride + (bx0 - x0)];
+        for (int32_t x = bx0; x <= bx1; ++x)
+        {
+          if ((e0 | e1 | e2) >= 0)
+          {
+            const int32_t zi = std::min(std::max(z >> 8, (int32_t)1), (int32_t)0xffff);
+            if (zi > *depth)
+            {
+              *depth = (uint16_t)zi;
+              *pixel = color;
+            }
+          }
+          e0 += eStepX[0];
+          e1 += eStepX[1];
+          e2 += eStepX[2];
+          z += zStepX;
+          ++depth;
+          ++pixel;
+        }
+        eRow[0] += eStepY[0];
+        eRow[1] += eStepY[1];
+        eRow[2] += eStepY[2];
+        zRow += zStepY;
+      }
+    }
+
+    // covered pixels go out as runs of one color
+    uint32_t written = 0;
+    for (int32_t y = y0; y <= y1; ++y)
+    {
+      const uint16_t *depth = &mDepth[(y - y0) * stride];
+      const uint16_t *pixel = &mColor[(y - y0) * stride];
+      const int32_t w = x1 - x0 + 1;
+      int32_t i = 0;
+      while (i < w)
+      {
+        if (depth[i] == 0)
+        {
+          ++i;
+          continue;
+        }
+        const int32_t start = i;
+        const uint16_t color = pixel[i];
+        while ((i < w) && (depth[i] != 0) && (pixel[i] == color))
+        {
+          ++i;
+        }
+        target.drawSpan((int16_t)(x0 + start), (int16_t)y, (int16_t)(i - start), color);
+        written += i - start;
+      }
+    }
+    return written;
+  }
+
+  uint32_t TileRasterizer::flush(RenderTarget &target)
+  {
+    uint32_t written = 0;
+    for (uint ty = 0; ty < mTilesY; ++ty)
+    {
+      for (uint tx = 0; tx < mTilesX; ++tx)
+      {
+        written += rasterizeTile(target, tx, ty);
+        mBins[ty * mTilesX + tx].clear();
+      }
+    }
+    mTris.clear();
+    return written;
+  }
+
+  void ICACHE_FLASH_ATTR TileRasterizer::compactMemory()
+  {
+    mTris.clear();
+    mTris.shrink_to_fit();
+    mBins.clear();
+    mBins.shrink_to_fit();
+    mColor.clear();
+    mColor.shrink_to_fit();
+    mDepth.clear();
+    mDepth.shrink_to_fit();
+    mPoints.clear();
+    mPoints.shrink_to_fit();
+    mIndices.clear();
+    mIndices.shrink_to_fit();
+    mTilesX = 0;
+    mTilesY = 0;
+  }
+}
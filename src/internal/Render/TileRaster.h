@@ -0,0 +1,82 @@
+#ifndef STEVESCH_RENDER_RENDER_STILERASTER_H_
+#define STEVESCH_RENDER_RENDER_STILERASTER_H_
+
+#include "FixedPoint.h"
+#include "RenderTarget.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace stevesch
+{
+  // screen vertex for depth-tested rasterization
+  struct DepthVertex
+  {
+    int32_t x;  // subpixel (28.4) screen position
+    int32_t y;
+    uint16_t z; // depth, larger is nearer (e.g. scaled 1/w); 0 is the cleared depth and never drawn
+  };
+
+  // Tile-based triangle rasterizer with a 16-bit depth buffer the size of one tile.
+  // Polygons are triangulated and their triangles binned into screen tiles; flush() then
+  // rasterizes each tile in turn (half-space edge functions, stepped incrementally per pixel)
+  // into a tile-sized color and depth buffer, and writes the covered pixels to the target as
+  // spans.  Depth memory is bounded by the tile size rather than the screen size.
+  // Pixels are sampled at their centers with a top-left rule, so triangles sharing an edge
+  // don't overlap or leave gaps.
+  class TileRasterizer
+  {
+  public:
+    TileRasterizer();
+
+    // starts a frame: screen size and tile edge in pixels (tile buffers take 4 * tileSize^2 bytes)
+    void begin(int16_t width, int16_t height, uint tileSize);
+
+    // triangulates a polygon (convex polygons as a fan, others by ear clipping) and bins its
+    // triangles; returns the number of triangles added
+    uint addPolygon(const DepthVertex *verts, uint count, uint16_t color);
+    void addTriangle(const DepthVertex &a, const DepthVertex &b, const DepthVertex &c, uint16_t color);
+
+    // rasterizes every tile into target, then empties the bins; returns the pixels written
+    uint32_t flush(RenderTarget &target);
+
+    uint triangleCount() const { return mTris.size(); }
+    uint tileSize() const { return mTileSize; }
+    size_t tileBytes() const { return (size_t)mTileSize * mTileSize * 2 * sizeof(uint16_t); }
+
+    void compactMemory();
+
+  protected:
+    struct Triangle
+    {
+      int32_t x[3]; // subpixel, counter-clockwise on screen (positive area with y down)
+      int32_t y[3];
+      int16_t xMin, yMin, xMax, yMax; // covered pixel bounds (inclusive), clipped to the screen
+      float zA, zB, zC;               // depth plane: z = zA * px + zB * py + zC at pixel centers
+      uint16_t color;
+    };
+
+    uint32_t rasterizeTile(RenderTarget &target, uint tx, uint ty);
+
+    int16_t mWidth;
+    int16_t mHeight;
+    uint mTileSize;
+    uint mTilesX;
+    uint mTilesY;
+
+    std::vector<Triangle> mTris;
+    std::vector<std::vector<uint32_t>> mBins; // triangle indices per tile, row-major
+    std::vector<uint16_t> mColor;             // one tile
+    std::vector<uint16_t> mDepth;             // one tile
+    std::vector<fixedPoint2> mPoints;         // triangulation scratch
+    std::vector<uint16_t> mIndices;
+  };
+
+  // Triangulates a simple polygon (either winding): convex polygons as a fan, others by ear
+  // clipping.  indices needs room for 3 * (count - 2) entries; returns the triangle count.
+  // Self-intersecting input still yields count - 2 triangles, though not an exact cover.
+  uint triangulatePolygon(uint16_t *indices, const fixedPoint2 *points, uint count);
+}
+
+#endif
@@ -0,0 +1,217 @@
+#include "Transform.h"
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    // dst = a * (b0, b1, b2, 0)
+    inline void mulColumn(vector4 &dst, const matrix4 &a, float b0, float b1, float b2)
+    {
+      dst.x = a.col[0].x * b0 + a.col[1].x * b1 + a.col[2].x * b2;
+      dst.y = a.col[0].y * b0 + a.col[1].y * b1 + a.col[2].y * b2;
+      dst.z = a.col[0].z * b0 + a.col[1].z * b1 + a.col[2].z * b2;
+      dst.w = a.col[0].w * b0 + a.col[1].w * b1 + a.col[2].w * b2;
+    }
+  }
+
+  void affine4x3::identity()
+  {
+    row[0].set(1.0f, 0.0f, 0.0f, 0.0f);
+    row[1].set(0.0f, 1.0f, 0.0f, 0.0f);
+    row[2].set(0.0f, 0.0f, 1.0f, 0.0f);
+  }
+
+  void affine4x3::set(const matrix4 &m)
+  {
+    row[0].set(m.m00, m.m01, m.m02, m.m03);
+    row[1].set(m.m10, m.m11, m.m12, m.m13);
+    row[2].set(m.m20, m.m21, m.m22, m.m23);
+  }
+
+  void affine4x3::get(matrix4 &m) const
+  {
+    m.m00 = row[0].x;
+    m.m01 = row[0].y;
+    m.m02 = row[0].z;
+    m.m03 = row[0].w;
+    m.m10 = row[1].x;
+    m.m11 = row[1].y;
+    m.m12 = row[1].z;
+    m.m13 = row[1].w;
+    m.m20 = row[2].x;
+    m.m21 = row[2].y;
+    m.m22 = row[2].z;
+    m.m23 = row[2].w;
+    m.m30 = 0.0f;
+    m.m31 = 0.0f;
+    m.m32 = 0.0f;
+    m.m33 = 1.0f;
+  }
+
+  void affine4x3::transformPoint(vector3 &dst, const vector3 &src) const
+  {
+    const float x = src.x;
+    const float y = src.y;
+    const float z = src.z;
+    dst.x = row[0].x * x + row[0].y * y + row[0].z * z + row[0].w;
+    dst.y = row[1].x * x + row[1].y * y + row[1].z * z + row[1].w;
+    dst.z = row[2].x * x + row[2].y * y + row[2].z * z + row[2].w;
+  }
+
+  void affine4x3::transformVector(vector3 &dst, const vector3 &src) const
+  {
+    const float x = src.x;
+    const float y = src.y;
+    const float z = src.z;
+    dst.x = row[0].x * x + row[0].y * y + row[0].z * z;
+    dst.y = row[1].x * x + row[1].y * y + row[1].z * z;
+    dst.z = row[2].x * x + row[2].y * y + row[2].z * z;
+  }
+
+  void affine4x3::mul(affine4x3 &dst, const affine4x3 &a, const affine4x3 &b)
+  {
+    affine4x3 r;
+    for (int i = 0; i < 3; ++i)
+    {
+      const vector4 &ar = a.row[i];
+      r.row[i].x = ar.x * b.row[0].x + ar.y * b.row[1].x + ar.z * b.row[2].x;
+      r.row[i].y = ar.x * b.row[0].y + ar.y * b.row[1].y + ar.z * b.row[2].y;
+      r.row[i].z = ar.x * b.row[0].z + ar.y * b.row[1].z + ar.z * b.row[2].z;
+      r.row[i].w = ar.x * b.row[0].w + ar.y * b.row[1].w + ar.z * b.row[2].w + ar.w;
+    }
+    dst = r;
+  }
+
+  void affine4x3::mul(matrix4 &dst, const matrix4 &a, const affine4x3 &b)
+  {
+    // columns of the result: a * (column j of b), where b's implicit bottom row is (0, 0, 0, 1)
+    matrix4 r;
+    mulColumn(r.col[0], a, b.row[0].x, b.row[1].x, b.row[2].x);
+    mulColumn(r.col[1], a, b.row[0].y, b.row[1].y, b.row[2].y);
+    mulColumn(r.col[2], a, b.row[0].z, b.row[1].z, b.row[2].z);
+    mulColumn(r.col[3], a, b.row[0].w, b.row[1].w, b.row[2].w);
+    r.col[3].x += a.col[3].x;
+    r.col[3].y += a.col[3].y;
+    r.col[3].z += a.col[3].z;
+    r.col[3].w += a.col[3].w;
+    dst = r;
+  }
+
+  bool affine4x3::invert(affine4x3 &dst, const affine4x3 &src)
+  {
+    const vector4 &r0 = src.row[0];
+    const vector4 &r1 = src.row[1];
+    const vector4 &r2 = src.row[2];
+
+    // 3x3 inverse by cofactors
+    const float c00 = r1.y * r2.z - r1.z * r2.y;
+    const float c01 = r1.z * r2.x - r1.x * r2.z;
+    const float c02 = r1.x * r2.y - r1.y * r2.x;
+    const float det = r0.x * c00 + r0.y * c01 + r0.z * c02;
+    if (det == 0.0f)
+    {
+      return false;
+    }
+    const float invDet = 1.0f / det;
+
+    affine4x3 r;
+    r.row[0].set(c00 * invDet,
+                 (r0.z * r2.y - r0.y * r2.z) * invDet,
+                 (r0.y * r1.z - r0.z * r1.y) * invDet, 0.0f);
+    r.row[1].set(c01 * invDet,
+                 (r0.x * r2.z - r0.z * r2.x) * invDet,
+                 (r0.z * r1.x - r0.x * r1.z) * invDet, 0.0f);
+    r.row[2].set(c02 * invDet,
+                 (r0.y * r2.x - r0.x * r2.y) * invDet,
+                 (r0.x * r1.y - r0.y * r1.x) * invDet, 0.0f);
+
+    // translation: -(R^-1 * t)
+    const vector3 t(r0.w, r1.w, r2.w);
+    vector3 it;
+    r.transformVector(it, t);
+    r.row[0].w = -it.x;
+    r.row[1].w = -it.y;
+    r.row[2].w = -it.z;
+
+    dst = r;
+    return true;
+  }
+
+  void viewportMatrix(matrix4 &dst, float width, float height)
+  {
+    dst.identity();
+    dst.m00 = 0.5f * width;
+    dst.m11 = -0.5f * height;
+    dst.m03 = 0.5f * width;
+    dst.m13 = 0.5f * height;
+  }
+
+  void foldViewport(matrix4 &mtxVtoS, const matrix4 &mtxVtoC, float width, float height)
+  {
+    matrix4 mtxNDCtoS;
+    viewportMatrix(mtxNDCtoS, width, height);
+    // (x_s = sx * x_ndc + ox = (sx * x_c + ox * w_c) / w_c, so the offset moves before the divide)
+    matrix4::mul(mtxVtoS, mtxNDCtoS, mtxVtoC);
+  }
+
+  void transformPoints(vector4 *dst, const vector3 *src, uint count, const matrix4 &mtx)
+  {
+    const vector4 &c0 = mtx.col[0];
+    const vector4 &c1 = mtx.col[1];
+    const vector4 &c2 = mtx.col[2];
+    const vector4 &c3 = mtx.col[3];
+    for (uint i = 0; i < count; ++i)
+    {
+      const float x = src[i].x;
+      const float y = src[i].y;
+      const float z = src[i].z;
+      vector4 &d = dst[i];
+      d.x = c0.x * x + c1.x * y + c2.x * z + c3.x;
+      d.y = c0.y * x + c1.y * y + c2.y * z + c3.y;
+      d.z = c0.z * x + c1.z * y + c2.z * z + c3.z;
+      d.w = c0.w * x + c1.w * y + c2.w * z + c3.w;
+    }
+  }
+
+  void transformPoints(vector3 *dst, const vector3 *src, uint count, const affine4x3 &mtx)
+  {
+    for (uint i = 0; i < count; ++i)
+    {
+      mtx.transformPoint(dst[i], src[i]);
+    }
+  }
+
+  void perspectiveDivide(vector3 *dst, const vector4 *src, uint count)
+  {
+    for (uint i = 0; i < count; ++i)
+    {
+      const float invw = stevesch::recipf(src[i].w);
+      dst[i].x = src[i].x * invw;
+      dst[i].y = src[i].y * invw;
+      dst[i].z = invw;
+    }
+  }
+
+  void projectPoints(vector3 *dst, const vector3 *src, uint count, const matrix4 &mtx)
+  {
+    const vector4 &c0 = mtx.col[0];
+    const vector4 &c1 = mtx.col[1];
+    const vector4 &c2 = mtx.col[2];
+    const vector4 &c3 = mtx.col[3];
+    for (uint i = 0; i < count; ++i)
+    {
+      const float x = src[i].x;
+      const float y = src[i].y;
+      const float z = src[i].z;
+      // (z isn't needed on screen: 1/w is kept instead)
+      const float invw = stevesch::recipf(c0.w * x + c1.w * y + c2.w * z + c3.w);
+      dst[i].x = (c0.x * x + c1.x * y + c2.x * z + c3.x) * invw;
+      dst[i].y = (c0.y * x + c1.y * y + c2.y * z + c3.y) * invw;
+      dst[i].z = invw;
+    }
+  }
+}
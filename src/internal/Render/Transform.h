@@ -0,0 +1,53 @@
+#ifndef STEVESCH_RENDER_RENDER_STRANSFORM_H_
+#define STEVESCH_RENDER_RENDER_STRANSFORM_H_
+
+#include <stevesch-MathVec.h>
+#include <stdint.h>
+
+namespace stevesch
+{
+  // Affine transform: the top three rows of a matrix4 whose bottom row is (0, 0, 0, 1).
+  // Composing model-view transforms in this form skips the implicit w row (36 multiplies
+  // instead of 64 per concatenation, 9 instead of 16 per point).
+  class affine4x3
+  {
+  public:
+    stevesch::vector4 row[3]; // row[i] = (m_i0, m_i1, m_i2, m_i3); m_i3 is the translation
+
+    affine4x3() {}
+    explicit affine4x3(const stevesch::matrix4 &m) { set(m); }
+
+    void identity();
+    void set(const stevesch::matrix4 &m); // (m's bottom row is ignored)
+    void get(stevesch::matrix4 &m) const;
+    void getTranslation(stevesch::vector3 &v) const { v.set(row[0].w, row[1].w, row[2].w); }
+
+    void transformPoint(stevesch::vector3 &dst, const stevesch::vector3 &src) const;
+    void transformVector(stevesch::vector3 &dst, const stevesch::vector3 &src) const; // (no translation)
+
+    static void mul(affine4x3 &dst, const affine4x3 &a, const affine4x3 &b); // dst = a * b
+    // dst = a * b, e.g. projection * model-view (b is treated as having the bottom row 0 0 0 1)
+    static void mul(stevesch::matrix4 &dst, const stevesch::matrix4 &a, const affine4x3 &b);
+    // general affine inverse (handles scale and shear); returns false if singular
+    static bool invert(affine4x3 &dst, const affine4x3 &src);
+  };
+
+  // NDC [-1, 1] to pixels (y down), as a matrix4
+  void viewportMatrix(stevesch::matrix4 &dst, float width, float height);
+  // mtxVtoS = viewport * mtxVtoC: the viewport folded into the projection, so that x/w and
+  // y/w are in pixels (z and w are unchanged, so near-plane clipping still tests z >= 0)
+  void foldViewport(stevesch::matrix4 &mtxVtoS, const stevesch::matrix4 &mtxVtoC, float width, float height);
+
+  // Batch transforms.  With mtx from foldViewport, each projected vertex costs one 4x4
+  // transform, one reciprocal and two multiplies.
+
+  // dst[i] = mtx * (src[i], 1)
+  void transformPoints(stevesch::vector4 *dst, const stevesch::vector3 *src, uint count, const stevesch::matrix4 &mtx);
+  void transformPoints(stevesch::vector3 *dst, const stevesch::vector3 *src, uint count, const affine4x3 &mtx);
+  // homogeneous to screen: dst[i] = (x/w, y/w, 1/w)
+  void perspectiveDivide(stevesch::vector3 *dst, const stevesch::vector4 *src, uint count);
+  // fused transformPoints and perspectiveDivide (when the homogeneous positions aren't needed)
+  void projectPoints(stevesch::vector3 *dst, const stevesch::vector3 *src, uint count, const stevesch::matrix4 &mtx);
+}
+
+#endif
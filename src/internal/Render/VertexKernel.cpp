@@ -0,0 +1,185 @@
+#include "VertexKernel.h"
+
+#if MESH_VERTEX_KERNEL == MESH_VERTEX_KERNEL_SSE2
+#include <emmintrin.h>
+#elif MESH_VERTEX_KERNEL == MESH_VERTEX_KERNEL_NEON
+#include <arm_neon.h>
+#endif
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+
+namespace stevesch
+{
+  namespace
+  {
+    // divide and classify one homogeneous vertex
+    inline uint32_t finishVertex(vector3 &dstS, const vector4 &h, const ClipRegion &region)
+    {
+      const float invw = stevesch::recipf(h.w);
+      dstS.x = h.x * invw;
+      dstS.y = h.y * invw;
+      dstS.z = invw;
+      return clipOutcode(h, region);
+    }
+  }
+
+  const char *vertexKernelName()
+  {
+#if MESH_VERTEX_KERNEL == MESH_VERTEX_KERNEL_SSE2
+    return "sse2";
+#elif MESH_VERTEX_KERNEL == MESH_VERTEX_KERNEL_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+  }
+
+  void transformVerticesScalar(vector4 *dst, const vector4 *src, uint count, const matrix4 &mtx)
+  {
+    const vector4 &c0 = mtx.col[0];
+    const vector4 &c1 = mtx.col[1];
+    const vector4 &c2 = mtx.col[2];
+    const vector4 &c3 = mtx.col[3];
+    for (uint i = 0; i < count; ++i)
+    {
+      const float x = src[i].x;
+      const float y = src[i].y;
+      const float z = src[i].z;
+      const float w = src[i].w;
+      vector4 &d = dst[i];
+      d.x = c0.x * x + c1.x * y + c2.x * z + c3.x * w;
+      d.y = c0.y * x + c1.y * y + c2.y * z + c3.y * w;
+      d.z = c0.z * x + c1.z * y + c2.z * z + c3.z * w;
+      d.w = c0.w * x + c1.w * y + c2.w * z + c3.w * w;
+    }
+  }
+
+  ClipCodes projectVerticesScalar(vector3 *dstS, vector4 *dstH, uint8_t *outcodes,
+                                  const vector3 *src, uint count, const matrix4 &mtx, const ClipRegion &region)
+  {
+    const vector4 &c0 = mtx.col[0];
+    const vector4 &c1 = mtx.col[1];
+    const vector4 &c2 = mtx.col[2];
+    const vector4 &c3 = mtx.col[3];
+    ClipCodes codes = {0, 0xff};
+    for (uint i = 0; i < count; ++i)
+    {
+      const float x = src[i].x;
+      const float y = src[i].y;
+      const float z = src[i].z;
+      vector4 &h = dstH[i];
+      h.x = c0.x * x + c1.x * y + c2.x * z + c3.x;
+      h.y = c0.y * x + c1.y * y + c2.y * z + c3.y;
+      h.z = c0.z * x + c1.z * y + c2.z * z + c3.z;
+      h.w = c0.w * x + c1.w * y + c2.w * z + c3.w;
+
+      const uint32_t code = finishVertex(dstS[i], h, region);
+      outcodes[i] = (uint8_t)code;
+      codes.any |= code;
+      codes.all &= code;
+    }
+    return codes;
+  }
+
+#if MESH_VERTEX_KERNEL == MESH_VERTEX_KERNEL_SSE2
+  // Array-of-structures: one vertex per register, the matrix columns held in registers.
+  // (A wider AVX2 kernel would want structure-of-arrays positions, which the meshes don't use.)
+  void transformVertices(vector4 *dst, const vector4 *src, uint count, const matrix4 &mtx)
+  {
+    const __m128 c0 = _mm_loadu_ps(&mtx.col[0].x);
+    const __m128 c1 = _mm_loadu_ps(&mtx.col[1].x);
+    const __m128 c2 = _mm_loadu_ps(&mtx.col[2].x);
+    const __m128 c3 = _mm_loadu_ps(&mtx.col[3].x);
+    for (uint i = 0; i < count; ++i)
+    {
+      const __m128 v = _mm_loadu_ps(&src[i].x);
+      __m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+      r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+      r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+      r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+      _mm_storeu_ps(&dst[i].x, r);
+    }
+  }
+
+  ClipCodes projectVertices(vector3 *dstS, vector4 *dstH, uint8_t *outcodes,
+                            const vector3 *src, uint count, const matrix4 &mtx, const ClipRegion &region)
+  {
+    const __m128 c0 = _mm_loadu_ps(&mtx.col[0].x);
+    const __m128 c1 = _mm_loadu_ps(&mtx.col[1].x);
+    const __m128 c2 = _mm_loadu_ps(&mtx.col[2].x);
+    const __m128 c3 = _mm_loadu_ps(&mtx.col[3].x);
+    ClipCodes codes = {0, 0xff};
+    for (uint i = 0; i < count; ++i)
+    {
+      __m128 r = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(src[i].x)));
+      r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(src[i].y)));
+      r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(src[i].z)));
+      _mm_storeu_ps(&dstH[i].x, r);
+
+      const uint32_t code = finishVertex(dstS[i], dstH[i], region);
+      outcodes[i] = (uint8_t)code;
+      codes.any |= code;
+      codes.all &= code;
+    }
+    return codes;
+  }
+
+#elif MESH_VERTEX_KERNEL == MESH_VERTEX_KERNEL_NEON
+  void transformVertices(vector4 *dst, const vector4 *src, uint count, const matrix4 &mtx)
+  {
+    const float32x4_t c0 = vld1q_f32(&mtx.col[0].x);
+    const float32x4_t c1 = vld1q_f32(&mtx.col[1].x);
+    const float32x4_t c2 = vld1q_f32(&mtx.col[2].x);
+    const float32x4_t c3 = vld1q_f32(&mtx.col[3].x);
+    for (uint i = 0; i < count; ++i)
+    {
+      const float x = src[i].x;
+      const float y = src[i].y;
+      const float z = src[i].z;
+      const float w = src[i].w;
+      float32x4_t r = vmulq_n_f32(c0, x);
+      r = vmlaq_n_f32(r, c1, y);
+      r = vmlaq_n_f32(r, c2, z);
+      r = vmlaq_n_f32(r, c3, w);
+      vst1q_f32(&dst[i].x, r);
+    }
+  }
+
+  ClipCodes projectVertices(vector3 *dstS, vector4 *dstH, uint8_t *outcodes,
+                            const vector3 *src, uint count, const matrix4 &mtx, const ClipRegion &region)
+  {
+    const float32x4_t c0 = vld1q_f32(&mtx.col[0].x);
+    const float32x4_t c1 = vld1q_f32(&mtx.col[1].x);
+    const float32x4_t c2 = vld1q_f32(&mtx.col[2].x);
+    const float32x4_t c3 = vld1q_f32(&mtx.col[3].x);
+    ClipCodes codes = {0, 0xff};
+    for (uint i = 0; i < count; ++i)
+    {
+      float32x4_t r = vmlaq_n_f32(c3, c0, src[i].x);
+      r = vmlaq_n_f32(r, c1, src[i].y);
+      r = vmlaq_n_f32(r, c2, src[i].z);
+      vst1q_f32(&dstH[i].x, r);
+
+      const uint32_t code = finishVertex(dstS[i], dstH[i], region);
+      outcodes[i] = (uint8_t)code;
+      codes.any |= code;
+      codes.all &= code;
+    }
+    return codes;
+  }
+
+#else
+  void transformVertices(vector4 *dst, const vector4 *src, uint count, const matrix4 &mtx)
+  {
+    transformVerticesScalar(dst, src, count, mtx);
+  }
+
+  ClipCodes projectVertices(vector3 *dstS, vector4 *dstH, uint8_t *outcodes,
+                            const vector3 *src, uint count, const matrix4 &mtx, const ClipRegion &region)
+  {
+    return projectVerticesScalar(dstS, dstH, outcodes, src, count, mtx, region);
+  }
+#endif
+}
@@ -0,0 +1,53 @@
+#ifndef STEVESCH_RENDER_RENDER_SVERTEXKERNEL_H_
+#define STEVESCH_RENDER_RENDER_SVERTEXKERNEL_H_
+
+#include <stevesch-MathVec.h>
+#include <stdint.h>
+
+#include "LineClip.h"
+
+// Vertex kernel backends, selected at compile time.  Define MESH_VERTEX_KERNEL to force one
+// (e.g. -DMESH_VERTEX_KERNEL=0 for the portable scalar kernel, used on Xtensa).
+#define MESH_VERTEX_KERNEL_SCALAR 0
+#define MESH_VERTEX_KERNEL_SSE2 1
+#define MESH_VERTEX_KERNEL_NEON 2
+
+#ifndef MESH_VERTEX_KERNEL
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define MESH_VERTEX_KERNEL MESH_VERTEX_KERNEL_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MESH_VERTEX_KERNEL MESH_VERTEX_KERNEL_NEON
+#else
+#define MESH_VERTEX_KERNEL MESH_VERTEX_KERNEL_SCALAR
+#endif
+#endif
+
+namespace stevesch
+{
+  // combined outcodes of a batch of vertices
+  struct ClipCodes
+  {
+    uint32_t any; // OR: 0 if every vertex is inside (no clipping needed)
+    uint32_t all; // AND: non-zero if every vertex is outside the same plane (trivially rejected)
+  };
+
+  const char *vertexKernelName();
+
+  // dst[i] = mtx * src[i] (dst may be src)
+  void transformVertices(stevesch::vector4 *dst, const stevesch::vector4 *src, uint count, const stevesch::matrix4 &mtx);
+
+  // positions to homogeneous (dstH = mtx * (src, 1)) and screen (dstS = (x/w, y/w, 1/w))
+  // space, with the clip outcode of each vertex against the near plane and region.
+  // (Screen positions of vertices behind the near plane are meaningless-- clip those edges.)
+  ClipCodes projectVertices(stevesch::vector3 *dstS, stevesch::vector4 *dstH, uint8_t *outcodes,
+                            const stevesch::vector3 *src, uint count, const stevesch::matrix4 &mtx,
+                            const ClipRegion &region);
+
+  // the portable scalar kernel, regardless of MESH_VERTEX_KERNEL (for comparison)
+  void transformVerticesScalar(stevesch::vector4 *dst, const stevesch::vector4 *src, uint count, const stevesch::matrix4 &mtx);
+  ClipCodes projectVerticesScalar(stevesch::vector3 *dstS, stevesch::vector4 *dstH, uint8_t *outcodes,
+                                  const stevesch::vector3 *src, uint count, const stevesch::matrix4 &mtx,
+                                  const ClipRegion &region);
+}
+
+#endif
@@ -27,7 +27,7 @@ namespace stevesch
     stevesch::sizeOfArray(kUnitCubeIndices)
   };
 
-  WireMesh::WireMesh(const WireMesh &src) : mPosition(src.mPosition), mIndex(src.mIndex)
+  WireMesh::WireMesh(const WireMesh &src) : LiveMeshList<WireMesh>(), mPosition(src.mPosition), mIndex(src.mIndex)
   {
   }
 
@@ -73,6 +73,15 @@ namespace stevesch
   void ICACHE_FLASH_ATTR WireMesh::compactMemory()
   {
     mPosition.shrink_to_fit();
+    mIndex.shrink_to_fit();
+  }
+
+  void WireMesh::memoryReport(MeshMemoryReport &report) const
+  {
+    report.clear();
+    report.meshCount = 1;
+    report.addBuffer("positions", mPosition);
+    report.addBuffer("indices", mIndex);
   }
 
   void ICACHE_FLASH_ATTR WireMesh::ring(float fRadiusInner, float fRadiusOuter, float fHeight, uint segments)
@@ -2,6 +2,7 @@
 #define STEVESCH_RENDER_SWIREMESH_H_
 #include <stevesch-vector3.h>
 #include "MeshTypes.h"
+#include "MeshMemory.h"
 #include <stdint.h>
 //#include <c_types.h>
 
@@ -17,7 +18,7 @@ namespace stevesch
 
   extern WireMeshRef kWireMesh_UnitCube;
 
-  class WireMesh
+  class WireMesh : public LiveMeshList<WireMesh>
   {
     positionBuffer_t mPosition;
     indexBuffer_t mIndex;
@@ -37,6 +38,8 @@ namespace stevesch
 
     void compactMemory(); // give back any unused memory
 
+    void memoryReport(MeshMemoryReport &report) const; // per-buffer counts, capacities and bytes
+
     uint positionCount() const { return mPosition.size(); }
     uint indexCount() const { return mIndex.size(); }
     uint lineCount() const { return mIndex.size() / 2; }
@@ -80,7 +83,7 @@ namespace stevesch
 
   inline index_t WireMesh::getIndex(uint nIndex) const
   {
-    SASSERT((nIndex >= 0) && (nIndex < indexCount()));
+    SASSERT(nIndex < indexCount());
     return mIndex[nIndex];
   }
 
@@ -92,7 +95,7 @@ namespace stevesch
 
   inline index_t &WireMesh::refIndex(uint nIndex)
   {
-    SASSERT((nIndex >= 0) && (nIndex < indexCount()));
+    SASSERT(nIndex < indexCount());
     return mIndex[nIndex];
   }
 
@@ -16,9 +16,34 @@
 #include "internal/MeshImport/MeshImport.h"
 #include "internal/MeshImport/Tokenizer.h"
 
+#include "internal/Render/AsyncPresenter.h"
+#include "internal/Render/CommandList.h"
+#include "internal/Render/DirtyRects.h"
+#include "internal/Render/DynamicResolution.h"
+#include "internal/Render/FixedPoint.h"
+#include "internal/Render/FrameBuffer565.h"
+#include "internal/Render/FrameTiming.h"
+#include "internal/Render/IndexedFrameBuffer.h"
+#include "internal/Render/LineClip.h"
+#include "internal/Render/LineRaster.h"
+#include "internal/Render/ParallelRenderTarget.h"
+#include "internal/Render/PolygonFill.h"
+#include "internal/Render/QualityGovernor.h"
+#include "internal/Render/RenderTarget.h"
+#include "internal/Render/StripRenderTarget.h"
+#include "internal/Render/TileRaster.h"
+#include "internal/Render/Transform.h"
+#include "internal/Render/VertexKernel.h"
+
 #include "internal/Scene/SceneObj.h"
 
 #include "internal/FaceMesh.h"
+#include "internal/FaceMeshBVH.h"
+#include "internal/FaceMeshDeformer.h"
+#include "internal/MeshBatch.h"
+#include "internal/MeshLod.h"
+#include "internal/MeshMemory.h"
+#include "internal/MorphTargets.h"
 #include "internal/WireMesh.h"
 
 #endif